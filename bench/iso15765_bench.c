@@ -0,0 +1,638 @@
+/*!
+@file   iso15765_bench.c
+@brief  Microbenchmarks of the frame codecs of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_bench [-m min_ms] [-f filter] [-b baseline] [-r max_regression_%] [-w new_baseline]
+
+Each codec is run over a frame mix of every addressing mode and frame format
+(CF heavy, as a segmented transfer: 2% FF, 5% SF, 3% FC, 90% CF). The engine
+is run over segmented transfers of BENCH_MSG bytes (classic CAN): 'rx' feeds
+the frames one by one to 'iso15765_enqueue' + 'iso15765_process', 'tx' sends
+the message, answers its FlowControl and signals the TX completion. The best
+of several runs is reported in ns/frame and, on Linux when the perf counters
+are accessible, in instructions/frame. With a baseline the exit code is 1 if any codec is slower
+than the baseline by more than the allowed regression.
+
+The engine is benchmarked in the profile the unit is compiled with (see
+I15765_RX_ONLY, I15765_TX_ONLY, I15765_CLASSIC_ONLY and I15765_ADDR_ONLY),
+in the normal addressing mode or in the mode of I15765_ADDR_ONLY.
+
+Baseline file: one "<name> <ns/frame>" per line, '#' starts a comment.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define BENCH_FRAMES	1024	/* Frames of a mix */
+#define BENCH_RUNS	5	/* Runs per codec, the best one is reported */
+#define BENCH_MAX	128	/* Max. benchmarks */
+#define BENCH_MSG	512U	/* Message size of the engine benchmarks */
+
+#ifdef I15765_ADDR_ONLY
+#define BENCH_ENG_MODE	((addr_md)(I15765_ADDR_ONLY))
+#else
+#define BENCH_ENG_MODE	N_ADM_NORMAL
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/* the codecs are 'inline static': the library is compiled in this unit */
+#include "lib_iso15765.c"
+#include "lib_iso15765_bus.c"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+typedef struct
+{
+	uint32_t id;
+	uint8_t dlc;
+	uint8_t dt[64];
+}bench_frame_t;
+
+typedef struct
+{
+	char name[48];
+	double ns;
+	double ins;
+	double base;
+}bench_rslt_t;
+
+static const struct { const char* name; addr_md md; } modes[] = {
+	{ "normal", N_ADM_NORMAL }, { "fixed", N_ADM_FIXED }, { "mixed11", N_ADM_MIXED11 },
+	{ "extended", N_ADM_EXTENDED }, { "mixed29", N_ADM_MIXED29 } };
+
+static n_pdu_t pdus[BENCH_FRAMES];
+static bench_frame_t frames[BENCH_FRAMES];
+static volatile uint32_t sink;
+static bench_rslt_t rslts[BENCH_MAX];
+static uint32_t rslt_cnt;
+static int perf_fd = -1;
+
+static iso15765_t eng;
+static canbus_frame_t eng_frames[BENCH_MSG / 5U + 2U];
+static uint32_t eng_frame_cnt;
+static canbus_frame_t eng_fc;
+static n_req_t eng_req;
+static uint32_t eng_sent;
+static uint32_t eng_done;
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void perf_open(void)
+{
+#ifdef __linux__
+	struct perf_event_attr pe;
+
+	memset(&pe, 0, sizeof(pe));
+	pe.type = PERF_TYPE_HARDWARE;
+	pe.size = sizeof(pe);
+	pe.config = PERF_COUNT_HW_INSTRUCTIONS;
+	pe.disabled = 1;
+	pe.exclude_kernel = 1;
+	pe.exclude_hv = 1;
+	perf_fd = (int)syscall(__NR_perf_event_open, &pe, 0, -1, -1, 0);
+#endif
+}
+
+static void perf_start(void)
+{
+#ifdef __linux__
+	if (perf_fd >= 0)
+	{
+		ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+static uint64_t perf_stop(void)
+{
+	uint64_t cnt = 0;
+#ifdef __linux__
+	if (perf_fd >= 0)
+	{
+		ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(perf_fd, &cnt, sizeof(cnt)) != sizeof(cnt))
+		{
+			cnt = 0;
+		}
+	}
+#endif
+	return cnt;
+}
+
+/*
+ * Build the frame mix of an addressing mode and frame format: the PDUs and
+ * their packed frames
+ */
+static void bench_mix(addr_md mode, cbus_fr_format fmt)
+{
+	uint8_t offs = (mode & 0x01);
+	uint8_t dl = fmt == CBUS_FR_FRM_STD ? 8U : 64U;
+	uint8_t sn = 1;
+
+	srand(15765);
+	for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		n_pdu_t* p = &pdus[i];
+		uint32_t r = (uint32_t)rand() % 100U;
+
+		memset(p, 0, sizeof(n_pdu_t));
+		p->n_ai.n_pr = 6;
+		p->n_ai.n_sa = (uint8_t)(rand() & 0x07);
+		p->n_ai.n_ta = (uint8_t)(rand() & 0x07);
+		p->n_ai.n_ae = (uint8_t)rand();
+		p->n_ai.n_tt = N_TA_T_PHY;
+
+		if (r < 2)
+		{
+			p->n_pci.pt = N_PCI_T_FF;
+			p->n_pci.dl = 500;
+			p->sz = (uint16_t)(dl - 2U - offs);
+			sn = 1;
+		}
+		else if (r < 7)
+		{
+			p->n_pci.pt = N_PCI_T_SF;
+			p->n_pci.dl = (uint16_t)(1U + (uint32_t)rand() % (7U - offs));
+			p->sz = p->n_pci.dl;
+		}
+		else if (r < 10)
+		{
+			p->n_pci.pt = N_PCI_T_FC;
+			p->n_pci.fs = N_OK;
+			p->n_pci.bs = 8;
+			p->n_pci.st = 1;
+			p->sz = 0;
+		}
+		else
+		{
+			p->n_pci.pt = N_PCI_T_CF;
+			p->n_pci.sn = sn;
+			p->sz = (uint16_t)(dl - 1U - offs);
+			sn = (uint8_t)((sn + 1U) & 0x0FU);
+		}
+
+		n_pdu_t tmp;
+		memmove(&tmp, p, sizeof(n_pdu_t));
+		for (uint16_t k = 0; k < p->sz; k++)
+		{
+			tmp.dt[k] = (uint8_t)rand();
+		}
+		memset(frames[i].dt, 0, sizeof(frames[i].dt));
+		n_pdu_pack(mode, &tmp, &frames[i].id, frames[i].dt);
+		uint8_t pci_len = p->n_pci.pt == N_PCI_T_FC ? 3U : p->n_pci.pt == N_PCI_T_FF ? 2U : 1U;
+		frames[i].dlc = (uint8_t)(offs + pci_len + p->sz);
+	}
+}
+
+/* --- Codecs (one pass over the mix) -------------------------------------- */
+
+static uint32_t run_pci_pack(addr_md mode)
+{
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		acc += n_pci_pack(mode, &pdus[i], pdus[i].dt);
+		acc += pdus[i].dt[mode & 0x01];
+	}
+	return acc;
+}
+
+static uint32_t run_pci_unpack(addr_md mode)
+{
+	n_pdu_t p;
+	uint32_t acc = 0;
+
+	memset(&p, 0, sizeof(p));
+	for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		acc += n_pci_unpack(mode, &p, frames[i].dlc, frames[i].dt);
+		acc += p.n_pci.dl + p.n_pci.sn;
+	}
+	return acc;
+}
+
+static uint32_t run_pdu_pack(addr_md mode)
+{
+	uint32_t acc = 0;
+	uint32_t id;
+	uint8_t dt[64] = { 0 };
+
+	for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		acc += n_pdu_pack(mode, &pdus[i], &id, dt);
+		acc += id + dt[0];
+	}
+	return acc;
+}
+
+static uint32_t run_pdu_unpack(addr_md mode)
+{
+	n_pdu_t p;
+	uint32_t acc = 0;
+
+	memset(&p, 0, sizeof(p));
+	for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		acc += n_pdu_unpack(mode, &p, frames[i].id, frames[i].dlc, frames[i].dt);
+		acc += p.n_ai.n_ta + p.dt[0];
+	}
+	return acc;
+}
+
+static uint32_t run_closest_dl(addr_md fmt)
+{
+	uint32_t acc = 0;
+	for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+	{
+		acc += n_get_closest_can_dl((uint8_t)(frames[i].dlc + (i & 0x07U)), (cbus_fr_format)fmt);
+	}
+	return acc;
+}
+
+/* --- Engine (segmented transfers) ---------------------------------------- */
+
+static uint32_t eng_get_ms(void)
+{
+	return 0;
+}
+
+static uint8_t eng_send_frame(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	ISO_15675_UNUSED(id_type);
+	ISO_15675_UNUSED(fr_fmt);
+	eng_sent += id + dlc + dt[0];
+	return N_SEND_OK;
+}
+
+static void eng_indn(n_indn_t* info)
+{
+	eng_done += info->rslt == N_OK ? 1U : 0U;
+}
+
+static void eng_cfm(n_cfm_t* info)
+{
+	eng_done += info->rslt == N_OK ? 1U : 0U;
+}
+
+/*
+ * Initialize the engine handler and pack the frames of a transfer: FF + CFs
+ * of a BENCH_MSG bytes message and the FlowControl (CTS, no blocks, STmin 0)
+ */
+static n_rslt eng_init(addr_md mode)
+{
+	uint8_t offs = (mode & 0x01);
+	uint8_t msg[BENCH_MSG];
+	uint16_t pos = 0;
+	uint8_t sn = 1;
+	n_pdu_t p;
+
+	memset(&eng, 0, sizeof(eng));
+	eng.addr_md = mode;
+	eng.fr_id_type = (mode & CBUS_ID_T_STANDARD) != 0 ? CBUS_ID_T_STANDARD : CBUS_ID_T_EXTENDED;
+	eng.clbs.get_ms = eng_get_ms;
+	eng.clbs.send_frame = eng_send_frame;
+	eng.clbs.indn = eng_indn;
+	eng.clbs.cfm = eng_cfm;
+	if (iso15765_init(&eng) != N_OK)
+	{
+		return N_ERROR;
+	}
+
+	for (uint16_t i = 0; i < BENCH_MSG; i++)
+	{
+		msg[i] = (uint8_t)i;
+	}
+	memset(&p, 0, sizeof(p));
+	p.n_ai.n_pr = 6;
+	p.n_ai.n_sa = 1;
+	p.n_ai.n_ta = 2;
+	p.n_ai.n_ae = 0x33;
+	p.n_ai.n_tt = N_TA_T_PHY;
+	memmove(&eng_req.n_ai, &p.n_ai, sizeof(n_ai_t));
+	eng_req.fr_fmt = CBUS_FR_FRM_STD;
+	eng_req.msg_sz = BENCH_MSG;
+	memmove(eng_req.msg, msg, BENCH_MSG);
+
+	eng_frame_cnt = 0;
+	while (pos < BENCH_MSG)
+	{
+		canbus_frame_t* f = &eng_frames[eng_frame_cnt++];
+
+		if (pos == 0)
+		{
+			p.n_pci.pt = N_PCI_T_FF;
+			p.n_pci.dl = BENCH_MSG;
+			p.sz = (uint16_t)(6U - offs);
+		}
+		else
+		{
+			p.n_pci.pt = N_PCI_T_CF;
+			p.n_pci.sn = sn;
+			p.sz = (uint16_t)(BENCH_MSG - pos < 7U - offs ? BENCH_MSG - pos : 7U - offs);
+			sn = (uint8_t)((sn + 1U) & 0x0FU);
+		}
+		memset(f, 0, sizeof(canbus_frame_t));
+		n_pdu_pack(mode, &p, &f->id, &msg[pos]);
+		f->id_type = eng.fr_id_type;
+		f->fr_format = CBUS_FR_FRM_STD;
+		f->dlc = (uint8_t)(n_get_dt_offset(mode, p.n_pci.pt, p.sz) + p.sz);
+		memmove(f->dt, p.dt, f->dlc);
+		pos = (uint16_t)(pos + p.sz);
+	}
+
+	/* the FlowControl of the receiver (addresses swapped) */
+	p.n_ai.n_sa = 2;
+	p.n_ai.n_ta = 1;
+	p.n_pci.pt = N_PCI_T_FC;
+	p.n_pci.fs = N_CONTINUE;
+	p.n_pci.bs = 0;
+	p.n_pci.st = 0;
+	p.sz = 0;
+	memset(&eng_fc, 0, sizeof(eng_fc));
+	n_pdu_pack(mode, &p, &eng_fc.id, msg);
+	eng_fc.id_type = eng.fr_id_type;
+	eng_fc.fr_format = CBUS_FR_FRM_STD;
+	eng_fc.dlc = (uint8_t)(offs + 3U);
+	memmove(eng_fc.dt, p.dt, eng_fc.dlc);
+	return N_OK;
+}
+
+#ifndef I15765_TX_ONLY
+static uint32_t run_engine_rx(addr_md mode)
+{
+	ISO_15675_UNUSED(mode);
+	for (uint32_t i = 0; i < eng_frame_cnt; i++)
+	{
+		iso15765_enqueue(&eng, &eng_frames[i]);
+		iso15765_process(&eng);
+	}
+	return eng_done;
+}
+#endif
+
+#ifndef I15765_RX_ONLY
+static uint32_t run_engine_tx(addr_md mode)
+{
+	ISO_15675_UNUSED(mode);
+	iso15765_send(&eng, &eng_req);
+	iso15765_process(&eng);
+	iso15765_enqueue(&eng, &eng_fc);
+	iso15765_process(&eng);
+	/* the driver took the frame: the CFs follow back to back */
+	iso15765_tx_complete(&eng);
+	return eng_done;
+}
+#endif
+
+/*
+ * Run a codec until 'min_ms' elapsed, BENCH_RUNS times, and keep the best run
+ */
+static void bench(const char* name, uint32_t (*fn)(addr_md), addr_md arg, uint32_t frames, uint32_t min_ms)
+{
+	bench_rslt_t* r = &rslts[rslt_cnt++];
+	double best = 1e30;
+	double ins = 0;
+
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	for (uint32_t run = 0; run < BENCH_RUNS; run++)
+	{
+		uint64_t n = 0;
+		uint64_t t0 = now_ns();
+		uint64_t t1;
+
+		perf_start();
+		do
+		{
+			sink += fn(arg);
+			n += frames;
+			t1 = now_ns();
+		} while (t1 - t0 < (uint64_t)min_ms * 1000000ULL / BENCH_RUNS);
+		uint64_t cnt = perf_stop();
+
+		double ns = (double)(t1 - t0) / (double)n;
+		if (ns < best)
+		{
+			best = ns;
+			ins = (double)cnt / (double)n;
+		}
+	}
+	r->ns = best;
+	r->ins = ins;
+	r->base = 0;
+}
+
+static void load_baseline(const char* path)
+{
+	FILE* f = fopen(path, "r");
+	char ln[128];
+	char name[48];
+	double ns;
+
+	if (f == NULL)
+	{
+		perror(path);
+		exit(2);
+	}
+	while (fgets(ln, sizeof(ln), f) != NULL)
+	{
+		if (ln[0] == '#' || sscanf(ln, "%47s %lf", name, &ns) != 2)
+		{
+			continue;
+		}
+		for (uint32_t i = 0; i < rslt_cnt; i++)
+		{
+			if (strcmp(rslts[i].name, name) == 0)
+			{
+				rslts[i].base = ns;
+			}
+		}
+	}
+	fclose(f);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(int argc, char** argv)
+{
+	uint32_t min_ms = 200;
+	double max_reg = 15.0;
+	const char* filter = NULL;
+	const char* base = NULL;
+	const char* out = NULL;
+	char name[48];
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:f:b:r:w:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm': min_ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'f': filter = optarg; break;
+		case 'b': base = optarg; break;
+		case 'r': max_reg = strtod(optarg, NULL); break;
+		case 'w': out = optarg; break;
+		default:
+			fprintf(stderr, "usage: %s [-m min_ms] [-f filter] [-b baseline] [-r max_regression_%%] [-w new_baseline]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	perf_open();
+
+	for (uint8_t fmt = 0; fmt < 2U; fmt++)
+	{
+		const char* fn = fmt == 0 ? "classic" : "fd";
+		cbus_fr_format fr_fmt = fmt == 0 ? CBUS_FR_FRM_STD : CBUS_FR_FRM_FD;
+
+		for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+		{
+			bench_mix(modes[m].md, fr_fmt);
+#define BENCH_CODEC(codec, func)	\
+			snprintf(name, sizeof(name), "%s/%s/%s", codec, modes[m].name, fn); \
+			if (filter == NULL || strstr(name, filter) != NULL) { bench(name, func, modes[m].md, BENCH_FRAMES, min_ms); }
+			BENCH_CODEC("pci_pack", run_pci_pack)
+			BENCH_CODEC("pci_unpack", run_pci_unpack)
+			BENCH_CODEC("pdu_pack", run_pdu_pack)
+			BENCH_CODEC("pdu_unpack", run_pdu_unpack)
+#undef BENCH_CODEC
+		}
+		snprintf(name, sizeof(name), "closest_can_dl/%s", fn);
+		if (filter == NULL || strstr(name, filter) != NULL)
+		{
+			bench(name, run_closest_dl, (addr_md)fr_fmt, BENCH_FRAMES, min_ms);
+		}
+	}
+
+	/* the engine, in the profile of this build */
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+	{
+		if (modes[m].md != BENCH_ENG_MODE)
+		{
+			continue;
+		}
+		if (eng_init(modes[m].md) != N_OK)
+		{
+			fprintf(stderr, "engine initialization failed\n");
+			return 2;
+		}
+#ifndef I15765_TX_ONLY
+		snprintf(name, sizeof(name), "engine_rx/%s/classic", modes[m].name);
+		if (filter == NULL || strstr(name, filter) != NULL)
+		{
+			bench(name, run_engine_rx, modes[m].md, eng_frame_cnt, min_ms);
+		}
+#endif
+#ifndef I15765_RX_ONLY
+		snprintf(name, sizeof(name), "engine_tx/%s/classic", modes[m].name);
+		if (filter == NULL || strstr(name, filter) != NULL)
+		{
+			/* the frames sent and the FlowControl */
+			bench(name, run_engine_tx, modes[m].md, eng_frame_cnt + 1U, min_ms);
+		}
+#endif
+	}
+
+	if (base != NULL)
+	{
+		load_baseline(base);
+	}
+
+	int regressed = 0;
+	printf("%-32s %10s %12s %10s %8s\n", "codec", "ns/frame", "instr/frame", "baseline", "delta");
+	for (uint32_t i = 0; i < rslt_cnt; i++)
+	{
+		bench_rslt_t* r = &rslts[i];
+		char ins[16] = "-";
+		char bs[16] = "-";
+		char dt[16] = "";
+
+		if (perf_fd >= 0)
+		{
+			snprintf(ins, sizeof(ins), "%.1f", r->ins);
+		}
+		if (r->base > 0)
+		{
+			double d = (r->ns - r->base) * 100.0 / r->base;
+			snprintf(bs, sizeof(bs), "%.2f", r->base);
+			snprintf(dt, sizeof(dt), "%+.1f%%%s", d, d > max_reg ? " !" : "");
+			regressed |= d > max_reg;
+		}
+		printf("%-32s %10.2f %12s %10s %8s\n", r->name, r->ns, ins, bs, dt);
+	}
+
+	if (out != NULL)
+	{
+		FILE* f = fopen(out, "w");
+		if (f == NULL)
+		{
+			perror(out);
+			return 2;
+		}
+		fprintf(f, "# iso15765_bench baseline (ns/frame). Regenerate on the reference machine with -w\n");
+		for (uint32_t i = 0; i < rslt_cnt; i++)
+		{
+			fprintf(f, "%s %.2f\n", rslts[i].name, rslts[i].ns);
+		}
+		fclose(f);
+	}
+	return regressed;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
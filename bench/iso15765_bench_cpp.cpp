@@ -0,0 +1,339 @@
+/*!
+@file   iso15765_bench_cpp.cpp
+@brief  Per-frame cost of the C++ Channel compared with the C engine
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_bench_cpp [-m min_ms]
+
+The same transfers are run through the C API ('iso15765_enqueue' +
+'iso15765_process', callbacks) and through 'iso15765::Channel' (fixed
+addressing, classic CAN, both compiled with the same optimization):
+
+  rx_sf   a Single Frame of 7 bytes is received
+  rx_seg  a message of BENCH_MSG bytes is received (FF + CFs), one frame per
+          process call, the FlowControl is answered
+  tx_sf   a Single Frame of 7 bytes is sent
+  tx_seg  a message of BENCH_MSG bytes is sent and its FlowControl received
+          (C engine: the CFs follow the TX completion of the driver)
+
+The best of several runs is reported in ns/frame for both APIs.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define BENCH_RUNS	5	/* Runs per benchmark, the best one is reported */
+#define BENCH_MSG	512U	/* Message size of the segmented transfers */
+#define BENCH_SF	7U	/* Message size of the Single Frame transfers */
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include "lib_iso15765.hpp"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+using namespace iso15765;
+using bench_ch = Channel<AddrMode::Fixed, FrameFormat::Classic, BENCH_MSG>;
+
+static const n_ai_t bench_ai = { 6, 0x01, 0x02, 0, N_TA_T_PHY };
+
+static canbus_frame_t seg_frames[BENCH_MSG / 6U + 2U];
+static std::uint32_t seg_cnt;
+static canbus_frame_t sf_frame;
+static canbus_frame_t fc_frame;
+static std::uint8_t msg[BENCH_MSG];
+static volatile std::uint32_t sink;
+
+static iso15765_t eng;
+static n_req_t req_sf;
+static n_req_t req_seg;
+static std::uint32_t done;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static std::uint64_t now_ns()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static canbus_frame_t bench_frame(std::uint32_t id, span<const std::uint8_t> dt)
+{
+	canbus_frame_t fr{};
+	fr.id = id;
+	fr.id_type = CBUS_ID_T_EXTENDED;
+	fr.fr_format = CBUS_FR_FRM_STD;
+	fr.dlc = static_cast<std::uint8_t>(dt.size());
+	std::memcpy(fr.dt, dt.data(), dt.size());
+	return fr;
+}
+
+/* --- C engine ------------------------------------------------------------ */
+
+static std::uint32_t eng_get_ms()
+{
+	return 0;
+}
+
+static std::uint8_t eng_send_frame(cbus_id_type id_type, std::uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, std::uint8_t* dt)
+{
+	ISO_15675_UNUSED(id_type);
+	ISO_15675_UNUSED(fr_fmt);
+	sink = sink + id + dlc + dt[0];
+	return N_SEND_OK;
+}
+
+static void eng_indn(n_indn_t* info)
+{
+	done += info->rslt == N_OK ? 1U : 0U;
+}
+
+static void eng_cfm(n_cfm_t* info)
+{
+	done += info->rslt == N_OK ? 1U : 0U;
+}
+
+static n_rslt eng_init()
+{
+	std::memset(&eng, 0, sizeof(eng));
+	eng.addr_md = N_ADM_FIXED;
+	eng.fr_id_type = CBUS_ID_T_EXTENDED;
+	eng.clbs.get_ms = eng_get_ms;
+	eng.clbs.send_frame = eng_send_frame;
+	eng.clbs.indn = eng_indn;
+	eng.clbs.cfm = eng_cfm;
+
+	req_seg.n_ai = bench_ai;
+	req_seg.fr_fmt = CBUS_FR_FRM_STD;
+	req_seg.msg_sz = BENCH_MSG;
+	std::memcpy(req_seg.msg, msg, BENCH_MSG);
+	req_sf = req_seg;
+	req_sf.msg_sz = BENCH_SF;
+	return iso15765_init(&eng);
+}
+
+static void c_rx_sf()
+{
+	iso15765_enqueue(&eng, &sf_frame);
+	iso15765_process(&eng);
+}
+
+static void c_rx_seg()
+{
+	for (std::uint32_t i = 0; i < seg_cnt; i++)
+	{
+		iso15765_enqueue(&eng, &seg_frames[i]);
+		iso15765_process(&eng);
+	}
+}
+
+static void c_tx_sf()
+{
+	iso15765_send(&eng, &req_sf);
+	iso15765_process(&eng);
+}
+
+static void c_tx_seg()
+{
+	iso15765_send(&eng, &req_seg);
+	iso15765_process(&eng);
+	iso15765_enqueue(&eng, &fc_frame);
+	iso15765_process(&eng);
+	iso15765_tx_complete(&eng);
+}
+
+/* --- C++ Channel --------------------------------------------------------- */
+
+static bench_ch ch([](std::uint32_t id, span<const std::uint8_t> dt) { sink = sink + id + dt.size() + dt[0]; return true; },
+	[] { return std::uint32_t(0); }, n_config_t{});
+
+static void ch_init()
+{
+	ch.on_indication([](const n_ai_t&, n_rslt rslt, span<const std::uint8_t>) { done += rslt == N_OK ? 1U : 0U; });
+	ch.on_confirm([](const n_ai_t&, n_rslt rslt) { done += rslt == N_OK ? 1U : 0U; });
+}
+
+static void cpp_rx_sf()
+{
+	ch.enqueue(sf_frame);
+	ch.process();
+}
+
+static void cpp_rx_seg()
+{
+	for (std::uint32_t i = 0; i < seg_cnt; i++)
+	{
+		ch.enqueue(seg_frames[i]);
+		ch.process();
+	}
+}
+
+static void cpp_tx_sf()
+{
+	ch.send(bench_ai, span<const std::uint8_t>(msg, BENCH_SF));
+	ch.process();
+}
+
+static void cpp_tx_seg()
+{
+	ch.send(bench_ai, span<const std::uint8_t>(msg, BENCH_MSG));
+	ch.process();
+	ch.enqueue(fc_frame);
+	ch.process();
+}
+
+/*
+ * Frames of the transfers: the FF + CFs of the segmented message are the ones
+ * sent by a Channel, the FlowControl is the answer of the receiver
+ */
+static void bench_frames()
+{
+	std::uint8_t dt[8];
+	bench_ch rec([](std::uint32_t id, span<const std::uint8_t> fr) {
+		seg_frames[seg_cnt++] = bench_frame(id, fr);
+		return true; }, [] { return std::uint32_t(0); }, n_config_t{});
+
+	for (std::uint16_t i = 0; i < BENCH_MSG; i++)
+	{
+		msg[i] = static_cast<std::uint8_t>(i);
+	}
+
+	n_ai_t rcv = bench_ch::addr::reverse(bench_ai);
+	std::uint8_t dl = bench_ch::pci::encode_fc(rcv, N_CONTINUE, 0, 0, dt);
+	fc_frame = bench_frame(bench_ch::addr::pack_id(rcv), span<const std::uint8_t>(dt, dl));
+
+	rec.send(bench_ai, span<const std::uint8_t>(msg, BENCH_MSG));
+	rec.process();
+	rec.enqueue(fc_frame);
+	rec.process();
+
+	dl = bench_ch::pci::encode_sf(bench_ai, span<const std::uint8_t>(msg, BENCH_SF), dt);
+	sf_frame = bench_frame(bench_ch::addr::pack_id(bench_ai), span<const std::uint8_t>(dt, dl));
+}
+
+/*
+ * Run a transfer until 'min_ms' elapsed, BENCH_RUNS times, and keep the best run
+ */
+static double bench(void (*fn)(), std::uint32_t frames, std::uint32_t min_ms)
+{
+	double best = 1e30;
+
+	for (std::uint32_t run = 0; run < BENCH_RUNS; run++)
+	{
+		std::uint64_t n = 0;
+		std::uint64_t t0 = now_ns();
+		std::uint64_t t1;
+
+		do
+		{
+			fn();
+			n += frames;
+			t1 = now_ns();
+		} while (t1 - t0 < static_cast<std::uint64_t>(min_ms) * 1000000ULL / BENCH_RUNS);
+
+		double ns = static_cast<double>(t1 - t0) / static_cast<double>(n);
+		best = ns < best ? ns : best;
+	}
+	return best;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(int argc, char** argv)
+{
+	std::uint32_t min_ms = 200;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm': min_ms = static_cast<std::uint32_t>(std::strtoul(optarg, nullptr, 0)); break;
+		default:
+			std::fprintf(stderr, "usage: %s [-m min_ms]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	bench_frames();
+	ch_init();
+	if (eng_init() != N_OK || ch.status() != N_OK || seg_cnt == 0)
+	{
+		std::fprintf(stderr, "initialization failed\n");
+		return 2;
+	}
+
+	static const struct
+	{
+		const char* name;
+		void (*c)();
+		void (*cpp)();
+		std::uint32_t frames;
+	} runs[] = {
+		{ "rx_sf", c_rx_sf, cpp_rx_sf, 1 },
+		{ "rx_seg", c_rx_seg, cpp_rx_seg, seg_cnt + 1U },
+		{ "tx_sf", c_tx_sf, cpp_tx_sf, 1 },
+		{ "tx_seg", c_tx_seg, cpp_tx_seg, seg_cnt + 1U },
+	};
+
+	std::printf("%-10s %12s %12s %8s\n", "transfer", "c ns/frame", "c++ ns/frame", "c/c++");
+	for (const auto& r : runs)
+	{
+		std::uint32_t c_done = done;
+		double c_ns = bench(r.c, r.frames, min_ms);
+		c_done = done - c_done;
+
+		std::uint32_t cpp_done = done;
+		double cpp_ns = bench(r.cpp, r.frames, min_ms);
+		cpp_done = done - cpp_done;
+
+		/* a transfer which does not complete is not measured */
+		if (c_done == 0 || cpp_done == 0)
+		{
+			std::fprintf(stderr, "%s: transfer not completed\n", r.name);
+			return 1;
+		}
+		std::printf("%-10s %12.2f %12.2f %8.2f\n", r.name, c_ns, cpp_ns, c_ns / cpp_ns);
+	}
+	return 0;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
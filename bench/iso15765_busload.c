@@ -0,0 +1,297 @@
+/*!
+@file   iso15765_busload.c
+@brief  Protocol efficiency of many ISO15765-2 nodes on a simulated CAN bus
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_busload [-n nodes] [-s msg_size] [-f | -x] [-b nbr] [-d dbr] [-m mailboxes]
+	[-t ms] [-l loss_ppm] [-c corrupt_ppm] [-p stmin] [-B bs] [-P poll_us] [-r seed]
+
+The nodes are paired (0-1, 2-3, ...) and every node sends messages to its
+partner back to back (fixed addressing, 29 bits IDs) for the given virtual
+time. The goodput, the bus load, the transfer time of the messages and the
+counters of the bus (arbitration, back-pressure, faults) are reported. '-f'
+selects CAN FD frames and '-x' CAN XL frames (built with I15765_CANXL).
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define BL_MAX_NODES	64	/* Max. nodes */
+#define BL_MAX_MBX	16	/* Max. TX mailboxes per node */
+#define BL_EVTQ_ELMS	16	/* Events per node */
+#define BL_RX_POOL	4	/* Reception buffers per node */
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lib_iso15765_sim.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+typedef struct
+{
+	iso15765_t ih;
+	n_evtq_t evtq;
+	n_evt_t evt[BL_EVTQ_ELMS];
+	n_rxbuf_t rx[BL_RX_POOL];
+	canbus_frame_t mbx[BL_MAX_MBX];
+	n_req_t req;
+	uint64_t t_send;
+}bl_node_t;
+
+static bl_node_t bl[BL_MAX_NODES];
+static n_sim_node_t nodes[BL_MAX_NODES];
+static iso15765_sim_t sim;
+
+static uint32_t msg_sz = 64;
+static uint64_t sent, ok, failed, bad, errors, rx_bytes;
+static uint64_t t_sum, t_max;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * The events of a node are drained after its process: the receptions are
+ * verified and the next message is sent when the previous one is completed
+ */
+static void bl_poll(void* ctx, uint8_t idx)
+{
+	bl_node_t* n = &bl[idx];
+	n_evt_t evt;
+
+	ISO_15675_UNUSED(ctx);
+	while (iso15765_evtq_pop(&n->evtq, &evt) == N_OK)
+	{
+		switch (evt.tp)
+		{
+		case N_INDN:
+			if (evt.n_ai.n_sa != n->req.n_ai.n_ta)
+			{
+				/* a timeout of the transmission is reported on the outbound stream */
+				failed++;
+				break;
+			}
+			if (evt.rslt != N_OK || evt.msg_sz != msg_sz)
+			{
+				failed++;
+				break;
+			}
+			for (uint32_t i = 0; i < evt.msg_sz; i++)
+			{
+				if (evt.msg[i] != (uint8_t)(evt.n_ai.n_sa + i))
+				{
+					bad++;
+					break;
+				}
+			}
+			rx_bytes += evt.msg_sz;
+			break;
+		case N_CONF:
+			if (evt.rslt == N_OK)
+			{
+				uint64_t t = sim.now_ns - n->t_send;
+				ok++;
+				t_sum += t;
+				t_max = t > t_max ? t : t_max;
+			}
+			else
+			{
+				failed++;
+			}
+			break;
+		case N_ERR_INDN:
+			/* e.g. a wrong SN after a lost CF */
+			errors++;
+			break;
+		default:
+			break;
+		}
+		if (evt.tp == N_INDN && evt.msg != NULL)
+		{
+			iso15765_rx_release(&n->ih, evt.msg);
+		}
+	}
+
+	if (n->ih.out.sts == N_S_IDLE && iso15765_send(&n->ih, &n->req) == N_OK)
+	{
+		n->t_send = sim.now_ns;
+		sent++;
+	}
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(int argc, char** argv)
+{
+	uint32_t cnt = 16;
+	uint32_t mbx = 3;
+	uint32_t ms = 1000;
+	uint32_t stmin = 0;
+	uint32_t bs = 8;
+	uint32_t poll_us = 1000;
+	uint8_t fd = 0;			/* 0: classic, 1: CAN FD, 2: CAN XL */
+	int opt;
+
+	sim.bus.nbr = 500000U;
+	while ((opt = getopt(argc, argv, "n:s:fxb:d:m:t:l:c:p:B:P:r:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': cnt = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 's': msg_sz = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'f': fd = 1; break;
+#ifdef I15765_CANXL
+		case 'x': fd = 2; break;
+#endif
+		case 'b': sim.bus.nbr = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'd': sim.bus.dbr = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'm': mbx = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 't': ms = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'l': sim.loss_ppm = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'c': sim.corrupt_ppm = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'p': stmin = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'B': bs = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'P': poll_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'r': sim.seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n nodes] [-s msg_size] [-f | -x] [-b nbr] [-d dbr] [-m mailboxes] [-t ms]"
+				" [-l loss_ppm] [-c corrupt_ppm] [-p stmin] [-B bs] [-P poll_us] [-r seed]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (cnt < 2 || cnt > BL_MAX_NODES || (cnt & 1U) != 0 || mbx == 0 || mbx > BL_MAX_MBX
+		|| msg_sz == 0 || msg_sz > I15765_MSG_SIZE || stmin > 0xFF || bs > 0xFF || poll_us == 0)
+	{
+		fprintf(stderr, "invalid arguments (2-%u nodes in pairs, 1-%u mailboxes, 1-%u bytes)\n",
+			BL_MAX_NODES, BL_MAX_MBX, I15765_MSG_SIZE);
+		return 2;
+	}
+	if (fd != 0 && sim.bus.dbr == 0)
+	{
+		sim.bus.dbr = 2000000U;
+	}
+
+	for (uint32_t i = 0; i < cnt; i++)
+	{
+		bl_node_t* n = &bl[i];
+		uint8_t sa = (uint8_t)(i + 1U);
+		uint8_t ta = (uint8_t)((i ^ 1U) + 1U);
+
+		n->ih.addr_md = N_ADM_FIXED;
+		n->ih.fr_id_type = CBUS_ID_T_EXTENDED;
+		n->ih.config.stmin = (uint8_t)stmin;
+		n->ih.config.bs = (uint8_t)bs;
+		n->ih.config.wf = 0;
+		n->ih.config.n_bs = 1000;
+		n->ih.config.n_cr = 1000;
+		iso15765_evtq_init(&n->evtq, n->evt, BL_EVTQ_ELMS);
+		n->ih.evtq = &n->evtq;
+		n->ih.rx_pool = n->rx;
+		n->ih.rx_pool_elms = BL_RX_POOL;
+
+		n->req.n_ai.n_pr = 0x06;
+		n->req.n_ai.n_sa = sa;
+		n->req.n_ai.n_ta = ta;
+		n->req.n_ai.n_tt = N_TA_T_PHY;
+		n->req.fr_fmt = fd == 0 ? CBUS_FR_FRM_STD : fd == 1 ? CBUS_FR_FRM_FD : CBUS_FR_FRM_XL;
+		n->req.msg_sz = (uint16_t)msg_sz;
+		for (uint32_t k = 0; k < msg_sz; k++)
+		{
+			n->req.msg[k] = (uint8_t)(sa + k);
+		}
+
+		nodes[i].ih = &n->ih;
+		nodes[i].mbx = n->mbx;
+		nodes[i].mbx_elms = (uint8_t)mbx;
+		nodes[i].acc_id = (0xDAU << 16) | ((uint32_t)sa << 8);
+		nodes[i].acc_mask = 0x00FFFF00U;
+	}
+
+	sim.nodes = nodes;
+	sim.node_cnt = (uint8_t)cnt;
+	sim.poll_ns = poll_us * 1000U;
+	sim.on_poll = bl_poll;
+	if (iso15765_sim_init(&sim) != N_OK)
+	{
+		fprintf(stderr, "simulator initialization failed\n");
+		return 1;
+	}
+	for (uint32_t i = 0; i < cnt; i++)
+	{
+		if (iso15765_init(&bl[i].ih) != N_OK)
+		{
+			fprintf(stderr, "node %u initialization failed\n", i);
+			return 1;
+		}
+	}
+
+	iso15765_sim_run(&sim, (uint64_t)ms * 1000000U);
+
+	uint64_t tx_busy = 0;
+	uint64_t arb_lost = 0;
+	uint64_t rx_dropped = 0;
+	for (uint32_t i = 0; i < cnt; i++)
+	{
+		tx_busy += nodes[i].tx_busy;
+		arb_lost += nodes[i].arb_lost;
+		rx_dropped += nodes[i].rx_dropped;
+	}
+
+	double secs = (double)sim.now_ns / 1e9;
+	double busy = (double)sim.busy_ns / 1e9;
+	uint32_t load = iso15765_sim_load(&sim);
+
+	printf("nodes=%u size=%u fmt=%s nbr=%u dbr=%u mbx=%u stmin=%u bs=%u poll=%uus loss=%uppm corrupt=%uppm t=%.3fs\n",
+		cnt, msg_sz, fd == 0 ? "classic" : fd == 1 ? "fd" : "xl", sim.bus.nbr, sim.bus.dbr, mbx, stmin, bs, poll_us,
+		sim.loss_ppm, sim.corrupt_ppm, secs);
+	printf("messages: sent=%llu confirmed=%llu failed=%llu bad_payload=%llu errors=%llu\n",
+		(unsigned long long)sent, (unsigned long long)ok, (unsigned long long)failed,
+		(unsigned long long)bad, (unsigned long long)errors);
+	printf("goodput: %.1f kbit/s, bus load %u.%02u%%, %.1f kbit/s of bus time\n",
+		(double)rx_bytes * 8.0 / secs / 1000.0, load / 100U, load % 100U,
+		busy > 0 ? (double)rx_bytes * 8.0 / busy / 1000.0 : 0.0);
+	printf("transfer time: avg %.3f ms, max %.3f ms\n",
+		ok != 0 ? (double)t_sum / (double)ok / 1e6 : 0.0, (double)t_max / 1e6);
+	printf("bus: frames=%u lost=%u corrupted=%u arb_lost=%llu tx_busy=%llu rx_dropped=%llu\n",
+		sim.frames, sim.lost, sim.corrupted, (unsigned long long)arb_lost,
+		(unsigned long long)tx_busy, (unsigned long long)rx_dropped);
+	return 0;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
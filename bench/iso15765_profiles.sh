@@ -0,0 +1,79 @@
+#!/bin/sh
+# ---------------------------------------------------------------------------
+# @file   iso15765_profiles.sh
+# @brief  Code size and per-frame cost of the build profiles of the engine
+#
+# GNU Affero General Public License v3.0
+# Copyright (c) 2024 Ioannis D. (devcoons)
+#
+# Usage: bench/iso15765_profiles.sh [min_ms]
+#
+# Every profile (see I15765_RX_ONLY, I15765_TX_ONLY, I15765_CLASSIC_ONLY and
+# I15765_ADDR_ONLY in lib_iso15765.h) is compiled twice: 'lib_iso15765.c'
+# with SIZE_CC/SIZE_CFLAGS for the code size (e.g. the compiler of the target:
+# SIZE_CC=arm-none-eabi-gcc SIZE_CFLAGS="-Os -mcpu=cortex-m0 -mthumb") and
+# 'iso15765_bench' with CC for the engine benchmarks (per frame, normal
+# addressing mode, classic CAN). METRIC=instr reports instructions/frame
+# instead of ns/frame (Linux perf counters), which is not affected by the
+# load of the machine. The deltas are relative to the full profile.
+# ---------------------------------------------------------------------------
+
+set -e
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+CC=${CC:-cc}
+SIZE_CC=${SIZE_CC:-$CC}
+SIZE_CFLAGS=${SIZE_CFLAGS:--Os}
+SIZE=${SIZE:-size}
+MIN_MS=${1:-200}
+METRIC=${METRIC:-ns}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+NORMAL="-DI15765_ADDR_ONLY=0x14"
+
+profiles() {
+	echo "full|"
+	echo "classic|-DI15765_CLASSIC_ONLY"
+	echo "normal|$NORMAL"
+	echo "classic+normal|-DI15765_CLASSIC_ONLY $NORMAL"
+	echo "rx|-DI15765_RX_ONLY"
+	echo "rx+classic+normal|-DI15765_RX_ONLY -DI15765_CLASSIC_ONLY $NORMAL"
+	echo "tx|-DI15765_TX_ONLY"
+	echo "tx+classic+normal|-DI15765_TX_ONLY -DI15765_CLASSIC_ONLY $NORMAL"
+}
+
+# delta (%) of $1 against $2
+delta() {
+	awk -v v="$1" -v b="$2" 'BEGIN { if (v == "-" || b == "-" || b == 0) print "-"; else printf "%+.1f%%", (v - b) * 100 / b }'
+}
+
+case "$METRIC" in
+	ns) COL=2 ;;
+	instr) COL=3 ;;
+	*) echo "METRIC must be ns or instr" >&2; exit 2 ;;
+esac
+
+printf "%-20s %8s %8s %12s %8s %12s %8s\n" "profile" "text" "delta" "rx $METRIC/fr" "delta" "tx $METRIC/fr" "delta"
+
+profiles | while IFS='|' read -r name flags; do
+	# shellcheck disable=SC2086
+	$SIZE_CC $SIZE_CFLAGS $flags -I"$ROOT/src" -I"$ROOT/lib" -c "$ROOT/src/lib_iso15765.c" -o "$TMP/lib.o"
+	text=$($SIZE "$TMP/lib.o" | awk 'NR == 2 { print $1 }')
+
+	# shellcheck disable=SC2086
+	$CC -O2 $flags -I"$ROOT/src" -I"$ROOT/lib" "$ROOT/bench/iso15765_bench.c" "$ROOT"/lib/*.c -o "$TMP/bench"
+	"$TMP/bench" -f engine -m "$MIN_MS" > "$TMP/out"
+	rx=$(awk -v c=$COL '$1 ~ /^engine_rx/ { print $c }' "$TMP/out")
+	tx=$(awk -v c=$COL '$1 ~ /^engine_tx/ { print $c }' "$TMP/out")
+	rx=${rx:--}
+	tx=${tx:--}
+
+	if [ "$name" = "full" ]; then
+		echo "$text $rx $tx" > "$TMP/full"
+	fi
+	read -r b_text b_rx b_tx < "$TMP/full"
+
+	printf "%-20s %8s %8s %12s %8s %12s %8s\n" "$name" "$text" "$(delta "$text" "$b_text")" \
+		"$rx" "$(delta "$rx" "$b_rx")" "$tx" "$(delta "$tx" "$b_tx")"
+done
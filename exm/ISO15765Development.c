@@ -16,8 +16,8 @@
 * Declaration | Static Functions
 ******************************************************************************/
 
-static uint8_t send_frame1(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, uint8_t dlc, uint8_t* dt);
-static uint8_t send_frame2(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, uint8_t dlc, uint8_t* dt);
+static uint8_t send_frame1(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt);
+static uint8_t send_frame2(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt);
 static void indn1(n_indn_t* info);
 static void indn2(n_indn_t* info);
 static void on_error(n_rslt err_type);
@@ -116,7 +116,7 @@ static void print_frame(uint8_t instance, uint8_t tp_mode, cbus_id_type mode, ui
     }
 }
 
-static uint8_t send_frame1(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, uint8_t dlc, uint8_t* dt) {
+static uint8_t send_frame1(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt) {
     print_frame(1, handler2.addr_md, id_type, id, fr_fmt, dlc, dt);
     canbus_frame_t frame = { .id = id, .dlc = dlc, .id_type = id_type, .fr_format= fr_fmt };
     memmove(frame.dt, dt, dlc);
@@ -124,7 +124,7 @@ static uint8_t send_frame1(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_
     return 0;
 }
 
-static uint8_t send_frame2(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, uint8_t dlc, uint8_t* dt) {     
+static uint8_t send_frame2(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt) {     
     print_frame(2, handler1.addr_md, id_type, id, fr_fmt, dlc, dt);
     canbus_frame_t frame = { .id = id, .dlc = dlc, .id_type = id_type, .fr_format = fr_fmt };
     memmove(frame.dt, dt, dlc);
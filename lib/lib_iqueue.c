@@ -48,6 +48,34 @@ a separate license is required. Contact:
 * Definition  | Static Functions
 ******************************************************************************/
 
+/*
+ * Advance a counter. Power of two queues use the full range of the counter,
+ * the rest wrap at twice the number of elements (to tell full from empty).
+ */
+static inline uint32_t iqueue_advance(iqueue_t* _queue, uint32_t _cnt)
+{
+	_cnt = _cnt + 1U;
+	return (_queue->mask != 0U || _cnt != _queue->wrap) ? _cnt : 0U;
+}
+
+static inline uint32_t iqueue_count(iqueue_t* _queue)
+{
+	uint32_t head = _queue->head;
+	uint32_t tail = _queue->tail;
+
+	if (_queue->mask != 0U || head >= tail)
+	{
+		return head - tail;
+	}
+	return head + _queue->wrap - tail;
+}
+
+static inline void* iqueue_slot(iqueue_t* _queue, uint32_t _cnt)
+{
+	uint32_t idx = _queue->mask != 0U ? (_cnt & _queue->mask)
+		: (_cnt >= _queue->max_elements ? _cnt - _queue->max_elements : _cnt);
+	return (void*)((uint8_t*)_queue->storage + (idx * _queue->element_size));
+}
 
 /******************************************************************************
 * Definition  | Public Functions
@@ -55,13 +83,15 @@ a separate license is required. Contact:
 
 i_status iqueue_init(iqueue_t* _queue, uint32_t _max_elements, size_t _element_size, void* _storage)
 {
-    if ((_queue != NULL) && (_storage != NULL))
+    if ((_queue != NULL) && (_storage != NULL) && (_max_elements != 0U))
     {
         (void)memset(_storage, 0, _element_size * _max_elements);
 		_queue->element_size = _element_size;
 		_queue->max_elements = _max_elements;
-		_queue->first = (uintptr_t)NULL;
-		_queue->next = (uintptr_t)_storage;
+		_queue->mask = (_max_elements > 1U && (_max_elements & (_max_elements - 1U)) == 0U) ? _max_elements - 1U : 0U;
+		_queue->wrap = _max_elements * 2U;
+		_queue->head = 0;
+		_queue->tail = 0;
 		_queue->storage = _storage;
         return I_OK;
     }
@@ -73,16 +103,18 @@ i_status iqueue_init(iqueue_t* _queue, uint32_t _max_elements, size_t _element_s
 
 void* iqueue_get_next_enqueue(iqueue_t* _queue)
 {
-	return (_queue != NULL) ? (void *)(_queue->next) : NULL;
+	if (_queue == NULL || iqueue_count(_queue) >= _queue->max_elements)
+	{
+		return NULL;
+	}
+	return iqueue_slot(_queue, _queue->head);
 }
 
 i_status iqueue_advance_next(iqueue_t* _queue)
 {
-	if (_queue->first != _queue->next)
+	if (iqueue_count(_queue) < _queue->max_elements)
 	{
-		uintptr_t storage_end = (uintptr_t)(_queue->storage) + (_queue->element_size * _queue->max_elements);
-		_queue->first = (_queue->first == 0U) ? _queue->next : _queue->first;
-		_queue->next = ((_queue->next + _queue->element_size) == storage_end) ? (uintptr_t)_queue->storage : (_queue->next + _queue->element_size);
+		_queue->head = iqueue_advance(_queue, _queue->head);
 		return I_OK;
 	}
 	else
@@ -93,9 +125,9 @@ i_status iqueue_advance_next(iqueue_t* _queue)
 
 i_status iqueue_enqueue(iqueue_t* _queue, void* _element)
 {
-	if (_queue->first != _queue->next)
+	if (iqueue_count(_queue) < _queue->max_elements)
 	{
-		(void)memmove((void*)_queue->next, (void*)_element, _queue->element_size);
+		(void)memmove(iqueue_slot(_queue, _queue->head), _element, _queue->element_size);
 		return iqueue_advance_next(_queue);
 	}
 	return I_FULL;
@@ -115,21 +147,39 @@ i_status iqueue_dequeue(iqueue_t* _queue, void* _element)
 	}
 }
 
-void* iqueue_dequeue_fast(iqueue_t* _queue)
+/*
+ * Oldest element without removing it. '_pos' receives the read counter to
+ * pass to 'iqueue_next' once the element has been copied.
+ */
+void* iqueue_peek(iqueue_t* _queue, uint32_t* _pos)
 {
-	if (_queue == NULL) {
+	uint32_t tail = _queue->tail;
+
+	if (_queue->head == tail)
+	{
 		return NULL;
 	}
+	*_pos = tail;
+	return iqueue_slot(_queue, tail);
+}
 
-	if (_queue->first != 0U) {
-		void* ret_ptr = (void*)_queue->first;
-
-		uintptr_t storage_end = (uintptr_t)_queue->storage + (_queue->element_size * _queue->max_elements);
-		uintptr_t next_first = _queue->first + _queue->element_size;
+/*
+ * Value of a counter after one more element
+ */
+uint32_t iqueue_next(iqueue_t* _queue, uint32_t _cnt)
+{
+	return iqueue_advance(_queue, _cnt);
+}
 
-		_queue->first = (next_first == storage_end) ? (uintptr_t)_queue->storage : next_first;
-		_queue->first = (_queue->first == _queue->next) ? 0U : _queue->first;
+void* iqueue_dequeue_fast(iqueue_t* _queue)
+{
+	if (_queue == NULL) {
+		return NULL;
+	}
 
+	if (_queue->head != _queue->tail) {
+		void* ret_ptr = iqueue_slot(_queue, _queue->tail);
+		_queue->tail = iqueue_advance(_queue, _queue->tail);
 		return ret_ptr;
 	}
 
@@ -139,11 +189,7 @@ void* iqueue_dequeue_fast(iqueue_t* _queue)
 
 i_status iqueue_size(iqueue_t* _queue, size_t* _size)
 {
-	*_size = _queue->first == 0
-		? 0
-		: _queue->first < _queue->next
-		? (_queue->next - _queue->first) / _queue->element_size
-		: _queue->max_elements - ((_queue->first - _queue->next) / _queue->element_size);
+	*_size = iqueue_count(_queue);
 
 	return I_OK;
 }
@@ -88,8 +88,10 @@ typedef enum
 typedef struct
 {
 	void* storage;
-	uintptr_t first;
-	uintptr_t next;
+	volatile uint32_t head;		/* Free-running write counter (producer only) */
+	volatile uint32_t tail;		/* Free-running read counter (consumer only) */
+	uint32_t mask;			/* max_elements - 1 if it is a power of two, else 0 */
+	uint32_t wrap;			/* Wrap-around of the counters if not a power of two */
 	size_t element_size;
 	uint32_t max_elements;
 }
@@ -106,6 +108,8 @@ i_status iqueue_size(iqueue_t* _queue, size_t* _size);
 i_status iqueue_advance_next(iqueue_t* _queue);
 void* iqueue_get_next_enqueue(iqueue_t* _queue);
 void* iqueue_dequeue_fast(iqueue_t* _queue);
+void* iqueue_peek(iqueue_t* _queue, uint32_t* _pos);
+uint32_t iqueue_next(iqueue_t* _queue, uint32_t _cnt);
 
 /******************************************************************************
 * EOF - NO CODE AFTER THIS LINE
@@ -31,11 +31,44 @@ a separate license is required. Contact:
 * Preprocessor Definitions & Macros
 ******************************************************************************/
 
+/* Addressing mode and frame format of a handler. They are constants in the
+ * single mode and classic CAN builds, which lets the compiler drop the code
+ * of the other modes and formats */
+#ifdef I15765_ADDR_ONLY
+#define N_ADM(ih)	((addr_md)(I15765_ADDR_ONLY))
+#else
+#define N_ADM(ih)	((ih)->addr_md)
+#endif
+
+#ifdef I15765_CLASSIC_ONLY
+#define N_FMT(fmt)	CBUS_FR_FRM_STD
+#define N_TX_DL(ih)	8U
+#else
+#define N_FMT(fmt)	(fmt)
+#define N_TX_DL(ih)	((ih)->out.tx_dl)
+#endif
+
+/* Digest of the message of a stream: started with the first payload (SF/FF)
+ * and continued with the payload of every CF, while it is in the cache */
+#ifdef I15765_DIGEST
+#define N_DIGEST_START(ih, strm, dt, sz)	((strm)->crc = iso15765_digest((ih)->digest, 0, (dt), (sz)))
+#define N_DIGEST_NEXT(ih, strm, dt, sz)		((strm)->crc = iso15765_digest((ih)->digest, (strm)->crc, (dt), (sz)))
+#else
+#define N_DIGEST_START(ih, strm, dt, sz)	((void)0)
+#define N_DIGEST_NEXT(ih, strm, dt, sz)		((void)0)
+#endif
+
 /******************************************************************************
 * Includes
 ******************************************************************************/
 
+#include <stddef.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 #include "lib_iso15765.h"
+#include "lib_iso15765_bus.h"
+#include "lib_iso15765_crc.h"
 
 /******************************************************************************
 * Enumerations, structures & Variables
@@ -79,12 +112,17 @@ static void cfg_cfm(n_chg_param_cfm_t* info)
 	ISO_15675_UNUSED(info);
 }
 
+static void on_error(n_rslt rslt)
+{
+	ISO_15675_UNUSED(rslt);
+}
+
 /*
  * Helper function to check if time interval has passed from a given time.
  */
 inline static n_rslt has_interval_passed(uint32_t current_time, uint32_t last_time, uint32_t interval)
 {
-    if ((interval == 0U) || (interval >= UINT32_MAX))
+    if (interval >= UINT32_MAX)
     {
         return N_ERROR;
     }
@@ -93,22 +131,80 @@ inline static n_rslt has_interval_passed(uint32_t current_time, uint32_t last_ti
 	return (elapsed_time >= interval) ? N_OK : N_INV;
 }
 
+/*
+ * Separation time (ms) of a STmin parameter. The time-source has a resolution
+ * of 1ms, so 100-900us are rounded up. Reserved values are handled as the
+ * longest STmin (ref: iso15765-2 9.6.5.4)
+ */
+inline static uint8_t n_stmin_ms(uint8_t st)
+{
+	if (st <= 0x7FU)
+	{
+		return st;
+	}
+	return (st >= 0xF1U && st <= 0xF9U) ? 1U : 0x7FU;
+}
+
+/*
+ * Map the return value of the 'send_frame' callback to a result. N_TX_BUSY:
+ * the frame was not taken and has to be sent again.
+ */
+inline static n_rslt send_rslt(iso15765_t* ih, uint8_t rslt)
+{
+	if (rslt == N_SEND_OK)
+	{
+		ih->tx_frames++;
+		return N_OK;
+	}
+	return rslt == N_SEND_BUSY ? N_TX_BUSY : N_ERROR;
+}
+
+#ifdef I15765_FRAME_TS
+/*
+ * Current time in the time-base of the frame timestamps
+ */
+inline static uint64_t ts_now(iso15765_t* ih)
+{
+	return ih->clbs.get_ts != NULL ? ih->clbs.get_ts() : (uint64_t)ih->clbs.get_ms() * ih->ts_per_ms;
+}
+#endif
+
+/*
+ * Arrival time (ms) of the frame in process. Without timestamps it is the
+ * time of the processing.
+ */
+inline static uint32_t rx_time_ms(iso15765_t* ih)
+{
+#ifdef I15765_FRAME_TS
+	return ih->rx_ms;
+#else
+	return ih->clbs.get_ms();
+#endif
+}
+
 /*
  * Helper function to find the closest can_dl
  */
-inline static uint8_t n_get_closest_can_dl(uint8_t size, cbus_fr_format tmt)
+inline static cbus_dl_t n_get_closest_can_dl(uint16_t size, cbus_fr_format tmt)
 {
-	uint8_t rval = 0;
+	cbus_dl_t rval = 0;
 
 	if (tmt == CBUS_FR_FRM_STD)
 	{
-		rval = (size <= 0x08U) ? size : 0x08U;
+		rval = (size <= 0x08U) ? (cbus_dl_t)size : 0x08U;
+	}
+#ifdef I15765_CANXL
+	else if (tmt == CBUS_FR_FRM_XL)
+	{
+		/* any CAN DL from 1 to 2048: no padding */
+		rval = (size <= I15765_MAX_DL) ? (cbus_dl_t)size : I15765_MAX_DL;
 	}
+#endif
 	else
 	{
 		if (size <= 8)
 		{
-			rval = size;
+			rval = (cbus_dl_t)size;
 		}
 		else if (size <= 12)
 		{
@@ -180,6 +276,34 @@ inline static uint8_t n_get_dt_offset(addr_md address, pci_type pci, uint16_t da
 	return offset;
 }
 
+/*
+ * Helper function to find the max. message size which fits in a Single Frame
+ */
+inline static uint16_t n_sf_max(addr_md address, cbus_dl_t tx_dl)
+{
+#ifdef I15765_CANXL
+	uint16_t sf_max = (uint16_t)((tx_dl <= 8U ? 7U : tx_dl - 2U) - (address & 0x01));
+	/* the SF_DL of the escape sequence is a single byte */
+	return sf_max > 0xFFU ? 0xFFU : sf_max;
+#else
+	return (uint16_t)((tx_dl <= 8U ? 7U : tx_dl - 2U) - (address & 0x01));
+#endif
+}
+
+/*
+ * Helper function to find the max. CAN DL of a frame format
+ */
+inline static cbus_dl_t n_fmt_dl(cbus_fr_format fr_fmt)
+{
+#ifdef I15765_CANXL
+	if (fr_fmt == CBUS_FR_FRM_XL)
+	{
+		return I15765_MAX_DL;
+	}
+#endif
+	return fr_fmt == CBUS_FR_FRM_STD ? 8U : 64U;
+}
+
 /*
  * Helper function to find which PCI_Type the outbound stream has to use
  */
@@ -189,28 +313,7 @@ inline static pci_type n_out_frame_type(iso15765_t* instance)
 
 	if (instance->out.cf_cnt == 0)
 	{
-		if ((instance->addr_md & 0x01) == 1)
-		{
-			if (instance->out.fr_fmt == CBUS_FR_FRM_STD)
-			{
-				result = instance->out.msg_sz <= 6 ? N_PCI_T_SF : N_PCI_T_FF;
-			}
-			else
-			{
-				result = instance->out.msg_sz <= 61 ? N_PCI_T_SF : N_PCI_T_FF;
-			}
-		}
-		else
-		{
-			if (instance->out.fr_fmt == CBUS_FR_FRM_STD)
-			{
-				result = instance->out.msg_sz <= 7 ? N_PCI_T_SF : N_PCI_T_FF;
-			}
-			else
-			{
-				result = instance->out.msg_sz <= 62 ? N_PCI_T_SF : N_PCI_T_FF;
-			}
-		}
+		result = instance->out.msg_sz <= n_sf_max(N_ADM(instance), N_TX_DL(instance)) ? N_PCI_T_SF : N_PCI_T_FF;
 	}
 	return result;
 }
@@ -270,7 +373,7 @@ inline static n_rslt n_pci_pack(addr_md mode, n_pdu_t* n_pdu, const uint8_t* dt)
 /*
  * Convert the PCI from the CANBus Frame
  */
-inline static n_rslt n_pci_unpack(addr_md mode, n_pdu_t* n_pdu, uint8_t dlc, uint8_t* dt)
+inline static n_rslt n_pci_unpack(addr_md mode, n_pdu_t* n_pdu, cbus_dl_t dlc, uint8_t* dt)
 {
     n_rslt result = N_ERROR;
 
@@ -293,14 +396,14 @@ inline static n_rslt n_pci_unpack(addr_md mode, n_pdu_t* n_pdu, uint8_t dlc, uin
                 // Direct assignment, the operation depends on 'dt' content
                 n_pdu->n_pci.sn = (uint8_t)(dt[offs] & 0x0FU);
                 n_pdu->sz = dlc - (1U + offs);
-                result = N_OK;
+                result = dlc < (1U + offs) ? N_ERROR : N_OK;
                 break;
 
             case N_PCI_T_FF:
                 // Combine two bytes into a larger value, clearly intentional
                 n_pdu->n_pci.dl = ((uint16_t)(dt[offs] & 0x0FU) << 8U) | dt[1U + offs];
                 n_pdu->sz = dlc - (2U + offs);
-                result = N_OK;
+                result = dlc < (2U + offs) ? N_ERROR : N_OK;
                 break;
 
             case N_PCI_T_FC:
@@ -310,7 +413,7 @@ inline static n_rslt n_pci_unpack(addr_md mode, n_pdu_t* n_pdu, uint8_t dlc, uin
                 n_pdu->n_pci.st = dt[2U + offs] <= 0x7F ? dt[2U + offs] :
 								  ((dt[2U + offs]>= 0xF1 && dt[2U + offs]<=0xF9) ? 1 : 127);
                 n_pdu->sz = dlc - (3U + offs); // Adjust for correct data length calculation
-                result = N_OK;
+                result = dlc < (3U + offs) ? N_ERROR : N_OK;
                 break;
 
             default:
@@ -476,7 +579,7 @@ inline static n_rslt n_pdu_pack(addr_md mode, n_pdu_t* n_pdu, uint32_t* id, uint
 /*
  * Convert PDU from CANBus frame
  */
-inline static n_rslt n_pdu_unpack(addr_md mode, n_pdu_t* n_pdu, uint32_t id, uint8_t dlc, uint8_t* dt)
+inline static n_rslt n_pdu_unpack(addr_md mode, n_pdu_t* n_pdu, uint32_t id, cbus_dl_t dlc, uint8_t* dt)
 {
 	if (n_pdu == NULL || dt == NULL)
 	{
@@ -527,13 +630,150 @@ inline static n_rslt n_pdu_unpack(addr_md mode, n_pdu_t* n_pdu, uint32_t id, uin
 	return N_ERROR;
 }
 
+/*
+ * Write an event record in the event queue. The payload is referenced from the
+ * stream buffer. If the queue is full the event is dropped and counted.
+ */
+inline static n_rslt evtq_push(n_evtq_t* q, signal_tp tp, cbus_fr_format fr_fmt, const n_ai_t* n_ai, const uint8_t* msg, uint16_t msg_sz, n_rslt sgn_rslt, uint64_t ts, uint32_t crc)
+{
+	uint16_t head = q->head;
+
+	if ((uint16_t)(head - q->tail) > q->mask)
+	{
+		q->lost++;
+		return N_OVFLW;
+	}
+
+	n_evt_t* evt = &q->buf[head & q->mask];
+	evt->tp = (uint8_t)tp;
+	evt->rslt = (uint16_t)sgn_rslt;
+	evt->fr_fmt = (uint8_t)fr_fmt;
+	evt->msg = msg;
+	evt->msg_sz = msg_sz;
+#ifdef I15765_FRAME_TS
+	evt->ts = ts;
+#else
+	ISO_15675_UNUSED(ts);
+#endif
+#ifdef I15765_DIGEST
+	evt->crc = crc;
+#else
+	ISO_15675_UNUSED(crc);
+#endif
+	if (n_ai != NULL)
+	{
+		memmove(&evt->n_ai, n_ai, sizeof(n_ai_t));
+	}
+	else
+	{
+		memset(&evt->n_ai, 0, sizeof(n_ai_t));
+	}
+	/* publish the record only after it is completely written */
+	I15765_MEMORY_BARRIER();
+	q->head = (uint16_t)(head + 1U);
+	return N_OK;
+}
+
+/*
+ * Select the buffer of a new reception: the unfinished buffer of the previous
+ * reception or a free buffer of the pool (if assigned)
+ */
+inline static n_rslt rx_acquire(iso15765_t* ih)
+{
+	if (ih->rx_pool == NULL || ih->rx_cur != NULL)
+	{
+		return N_OK;
+	}
+
+	for (uint8_t i = 0; i < ih->rx_pool_elms; i++)
+	{
+		if (ih->rx_pool[i].lent == 0)
+		{
+			ih->rx_cur = &ih->rx_pool[i];
+			return N_OK;
+		}
+	}
+	ih->rx_starved++;
+	return N_BUFFER_OVFLW;
+}
+
+/*
+ * Message buffer of the reception in progress
+ */
+inline static uint8_t* rx_msg(iso15765_t* ih)
+{
+	return ih->rx_cur != NULL ? ih->rx_cur->msg : ih->in.msg;
+}
+
+/*
+ * Report an error to the upper layer, either through the event queue or the
+ * 'on_error' callback.
+ */
+inline static void report_error(iso15765_t* ih, n_rslt err)
+{
+	if (ih->evtq != NULL)
+	{
+		evtq_push(ih->evtq, N_ERR_INDN, (cbus_fr_format)0, NULL, NULL, 0, err, 0, 0);
+		return;
+	}
+	ih->clbs.on_error(err);
+}
+
 /*
  * Given the correct parameters, the service informs the upper-layer/user about
- * an event by using the appropriate callbacks. The function does not support
- * the N_CHG_P_CONF signal type.
+ * an event by using the appropriate callbacks or the event queue (if assigned).
+ * The function does not support the N_CHG_P_CONF signal type.
  */
-inline static void signaling(signal_tp tp, n_iostream_t* strm, void(*cb)(void*), uint16_t msg_sz, n_rslt sgn_rslt)
+inline static void signaling(iso15765_t* ih, signal_tp tp, n_iostream_t* strm, void(*cb)(void*), uint16_t msg_sz, n_rslt sgn_rslt)
 {
+	uint8_t* msg = strm->msg;
+	n_rxbuf_t* loan = NULL;
+#ifdef I15765_FRAME_TS
+	uint64_t ts = strm == &ih->in ? ih->rx_ts : 0;
+#else
+	uint64_t ts = 0;
+#endif
+#ifdef I15765_DIGEST
+	uint32_t crc = strm->crc;
+#else
+	uint32_t crc = 0;
+#endif
+
+	/* a completed reception hands the buffer over to the application */
+	if (strm == &ih->in && ih->rx_cur != NULL)
+	{
+		msg = ih->rx_cur->msg;
+		if (tp == N_INDN)
+		{
+			loan = ih->rx_cur;
+			loan->msg_sz = msg_sz;
+			loan->lent = 1;
+			ih->rx_cur = NULL;
+		}
+	}
+
+	if (ih->evtq != NULL)
+	{
+		if (tp == N_INDN)
+		{
+			strm->sts = N_S_IDLE;
+		}
+		else if (tp == N_FF_INDN)
+		{
+			strm->sts = (uint8_t)((uint32_t)strm->sts | (uint32_t)N_S_RX_BUSY);
+		}
+		if (evtq_push(ih->evtq, tp, strm->fr_fmt, &strm->pdu.n_ai, msg, msg_sz, sgn_rslt, ts, crc) != N_OK && loan != NULL)
+		{
+			loan->lent = 0;
+		}
+		return;
+	}
+
+	if (cb == NULL && loan != NULL)
+	{
+		loan->lent = 0;
+	}
+
 	if (cb != NULL)
 	{
 		switch (tp)
@@ -544,7 +784,17 @@ inline static void signaling(signal_tp tp, n_iostream_t* strm, void(*cb)(void*),
 			sgn_indn.fr_fmt = strm->fr_fmt;
 			memmove(&sgn_indn.n_ai, &strm->pdu.n_ai, sizeof(n_ai_t));
 			memmove(&sgn_indn.n_pci, &strm->pdu.n_pci, sizeof(n_pci_t));
-			memmove(&sgn_indn.msg, strm->msg, msg_sz);
+			sgn_indn.buf = loan != NULL ? loan->msg : NULL;
+#ifdef I15765_FRAME_TS
+			sgn_indn.ts = ts;
+#endif
+#ifdef I15765_DIGEST
+			sgn_indn.crc = crc;
+#endif
+			if (loan == NULL)
+			{
+				memmove(&sgn_indn.msg, msg, msg_sz);
+			}
 			strm->sts = N_S_IDLE;
 			cb(&sgn_indn);
 			break;
@@ -558,6 +808,9 @@ inline static void signaling(signal_tp tp, n_iostream_t* strm, void(*cb)(void*),
 			break;
 		case N_CONF:
 			sgn_conf.rslt = sgn_rslt;
+#ifdef I15765_DIGEST
+			sgn_conf.crc = crc;
+#endif
 			memmove(&sgn_conf.n_ai, &strm->pdu.n_ai, sizeof(n_ai_t));
 			memmove(&sgn_conf.n_pci, &strm->pdu.n_pci, sizeof(n_pci_t));
 			cb(&sgn_conf);
@@ -570,16 +823,51 @@ inline static void signaling(signal_tp tp, n_iostream_t* strm, void(*cb)(void*),
 }
 
 /*
- * Check if any timeout should be occured.
+ * Complete the token of a submitted request (visible to the submitting thread)
+ */
+inline static void token_complete(n_token_t* tok, n_rslt rslt)
+{
+	if (tok == NULL)
+	{
+		return;
+	}
+	tok->rslt = rslt;
+#ifdef I15765_ATOMIC_STORE
+	I15765_ATOMIC_STORE(&tok->sts, (uint32_t)N_TOK_DONE);
+#else
+	I15765_MEMORY_BARRIER();
+	tok->sts = N_TOK_DONE;
+#endif
+}
+
+/*
+ * The transmission in progress is completed or terminated
+ */
+inline static void tx_token_done(iso15765_t* ih, n_rslt rslt)
+{
+#ifdef I15765_DIGEST
+	/* published with the status of the token */
+	if (ih->tx_tok != NULL)
+	{
+		ih->tx_tok->crc = ih->out.crc;
+	}
+#endif
+	token_complete(ih->tx_tok, rslt);
+	ih->tx_tok = NULL;
+}
+
+#ifndef I15765_RX_ONLY
+/*
+ * Check if any timeout should be occured at the given time (ms).
  */
-inline static n_rslt process_timeouts(iso15765_t* ih)
+inline static n_rslt process_timeouts(iso15765_t* ih, uint32_t now)
 {
 	if (ih->out.sts != N_S_TX_WAIT_FC || ih->out.last_upd.n_bs == 0 || ih->config.n_bs == 0)
 	{
 		return N_OK;
 	}
 
-	n_rslt timeout = has_interval_passed(ih->clbs.get_ms(),ih->out.last_upd.n_bs,ih->config.n_bs);
+	n_rslt timeout = has_interval_passed(now, ih->out.last_upd.n_bs, ih->config.n_bs);
 
 	if(timeout == N_INV)
 	{
@@ -589,175 +877,480 @@ inline static n_rslt process_timeouts(iso15765_t* ih)
 
 	/* if timeout occures then reset the counters and report to the upper layer */
 	ih->out.cf_cnt = 0x0;
-	signaling(N_INDN, &ih->out, (void*)ih->clbs.indn, ih->out.msg_sz, N_TIMEOUT_Bs);
-	ih->clbs.on_error(N_TIMEOUT_Bs);
+	signaling(ih, N_INDN, &ih->out, (void*)ih->clbs.indn, ih->out.msg_sz, N_TIMEOUT_Bs);
+	report_error(ih, N_TIMEOUT_Bs);
+	tx_token_done(ih, N_TIMEOUT_Bs);
 	return N_TIMEOUT_Bs;
 }
 
+#endif
+
 /*
- * Sends a Flow Control Frame upon request from the reception procedure
+ * Tokens of a frame in the unit of the bus-load limiter
  */
-static n_rslt send_N_PCI_T_FC(iso15765_t* ih)
+static uint32_t rate_cost(iso15765_t* ih, cbus_fr_format fr_fmt, cbus_dl_t dlc)
 {
-	uint32_t id;
+	n_rate_t* rl = ih->rate;
+	uint32_t cost = 1U;
 
-	ih->out.sts |= N_S_TX_BUSY;
-	ih->fl_pdu.n_pci.pt = N_PCI_T_FC;
-	ih->fl_pdu.n_pci.bs = ih->config.bs;
-	ih->fl_pdu.n_pci.st = ih->config.stmin;
-	ih->fl_pdu.n_ai.n_ae = ih->in.pdu.n_ai.n_ae;
-	ih->fl_pdu.n_ai.n_sa = ih->in.pdu.n_ai.n_ta;
-	ih->fl_pdu.n_ai.n_ta = ih->in.pdu.n_ai.n_sa;
-	ih->fl_pdu.n_ai.n_pr = ih->in.pdu.n_ai.n_pr;
-	ih->fl_pdu.n_ai.n_tt = ih->in.pdu.n_ai.n_tt;
-	ih->in.cfg_bs = ih->config.bs;
-
-	if (n_pdu_pack(ih->addr_md, &ih->fl_pdu, &id, ih->out.msg) != N_OK)
-	{
-		ih->out.sts = (ih->out.sts & (~N_S_TX_BUSY));
-		return N_ERROR;
+	if (rl->unit == N_RATE_BITS)
+	{
+		n_frame_bits_t bits = iso15765_frame_bits(ih->fr_id_type, fr_fmt, dlc);
+		cost = bits.nom_bits;
+		/* data phase bits are weighted by the bitrate switch ratio */
+		if (ih->bus != NULL && ih->bus->dbr > ih->bus->nbr)
+		{
+			cost += (uint32_t)(((uint64_t)bits.dat_bits * ih->bus->nbr + ih->bus->dbr - 1U) / ih->bus->dbr);
+		}
+		else
+		{
+			cost += bits.dat_bits;
+		}
 	}
-
-	ih->clbs.send_frame(ih->fr_id_type, id, ih->in.fr_fmt, n_get_dt_offset(ih->addr_md, N_PCI_T_FC, ih->fl_pdu.sz), ih->fl_pdu.dt);
-	ih->out.sts = (ih->out.sts & (~N_S_TX_BUSY));
-	return N_OK;
+	/* a frame is never more expensive than a full bucket */
+	return cost > rl->burst ? rl->burst : cost;
 }
 
 /*
- * Helper function to set some basic stream parameters value
+ * Take the tokens of a frame from the bus-load limiter (if any). Returns
+ * N_TX_BUSY if the frame has to be deferred.
  */
-inline static void set_stream_data(n_iostream_t* ist, uint8_t cf, uint8_t wf, stream_sts sts)
+static n_rslt rate_take(iso15765_t* ih, cbus_fr_format fr_fmt, cbus_dl_t dlc)
 {
-	ist->cf_cnt = cf;
-	ist->wf_cnt = wf;
-	ist->sts = sts;
+	n_rate_t* rl = ih->rate;
+
+	if (rl == NULL)
+	{
+		return N_OK;
+	}
+
+	/* refill the bucket, keeping the fraction of the tokens for the next time */
+	uint32_t now = ih->clbs.get_ms();
+	if (rl->sync == 0)
+	{
+		rl->sync = 1;
+		rl->last_ms = now;
+	}
+	uint64_t acc = (uint64_t)rl->rate * (uint32_t)(now - rl->last_ms) + rl->rem;
+	uint64_t tokens = rl->tokens + acc / 1000U;
+	rl->last_ms = now;
+	rl->rem = (uint32_t)(acc % 1000U);
+	if (tokens >= rl->burst)
+	{
+		tokens = rl->burst;
+		rl->rem = 0;
+	}
+	rl->tokens = (uint32_t)tokens;
+
+	uint32_t cost = rate_cost(ih, fr_fmt, dlc);
+
+	if (rl->tokens < cost)
+	{
+		rl->denied++;
+		return N_TX_BUSY;
+	}
+	rl->tokens -= cost;
+	return N_OK;
 }
 
 /*
- * Check if current Wait Flow status counter reached the max WFS
+ * Give back the tokens of a frame which was not taken by the driver
  */
-inline static n_rslt check_max_wf_capacity(iso15765_t* ih)
+static void rate_refund(iso15765_t* ih, cbus_fr_format fr_fmt, cbus_dl_t dlc)
 {
-	if (ih->out.wf_cnt < ih->config.wf)
+	n_rate_t* rl = ih->rate;
+
+	if (rl == NULL)
 	{
-		return N_OK;
+		return;
 	}
 
-	ih->clbs.on_error(N_WFT_OVRN);
-	set_stream_data(&ih->out, 0, 0, N_S_IDLE);
-	return N_WFT_OVRN;
+	uint32_t cost = rate_cost(ih, fr_fmt, dlc);
+	rl->tokens = rl->burst - rl->tokens > cost ? rl->tokens + cost : rl->burst;
 }
 
+#ifndef I15765_TX_ONLY
 /*
- * Process inbound First Frame reception and report to the upper layer using the
- * indication callback function.
+ * Keep the FlowControl answering the frame of the reception being processed.
+ * Its address information is taken now: the following frames overwrite 'in.pdu'
  */
-static n_rslt process_in_ff(iso15765_t* ih)
+static void set_N_PCI_T_FC(iso15765_t* ih, flow_sts fs, uint8_t bs, uint8_t stmin)
 {
-	if (ih->in.msg_sz > I15765_MSG_SIZE)
+	ih->fc.fr_fmt = ih->in.fr_fmt;
+	ih->fc.n_ai.n_ae = ih->in.pdu.n_ai.n_ae;
+	ih->fc.n_ai.n_sa = ih->in.pdu.n_ai.n_ta;
+	ih->fc.n_ai.n_ta = ih->in.pdu.n_ai.n_sa;
+	ih->fc.n_ai.n_pr = ih->in.pdu.n_ai.n_pr;
+	ih->fc.n_ai.n_tt = ih->in.pdu.n_ai.n_tt;
+	ih->fc.fs = (uint8_t)fs;
+	ih->fc.bs = bs;
+	ih->fc.st = stmin;
+}
+
+/*
+ * Sends the kept Flow Control Frame. If it is deferred it stays pending and the
+ * process sends it again, unchanged
+ */
+static n_rslt send_N_PCI_T_FC(iso15765_t* ih)
+{
+	uint32_t id;
+
+	/* deferred by the bus-load limiter: kept pending and retried by the process */
+	if (rate_take(ih, N_FMT(ih->fc.fr_fmt), (uint8_t)((N_ADM(ih) & 0x01) + 3U)) != N_OK)
 	{
-		ih->clbs.on_error(N_INV_REQ_SZ);
-		return N_INV_REQ_SZ;
+		ih->in.fc_pend = N_FC_DEFERRED;
+		return N_TX_BUSY;
 	}
-	/* If reception is in progress: Terminate the current reception, report an
-	* N_USData.indication, with <N_Result> set to N_UNEXP_PDU, to the upper layer, and
-	* process the FF N_PDU as the start of a new reception.*/
-	if ((ih->in.sts & N_S_RX_BUSY) != 0)
+	/* the outbound stream may be in the middle of a transmission (full-duplex),
+	* so its status is restored instead of clearing the busy flag */
+	stream_sts out_sts = ih->out.sts;
+
+	ih->out.sts |= N_S_TX_BUSY;
+	ih->fl_pdu.n_pci.pt = N_PCI_T_FC;
+	ih->fl_pdu.n_pci.fs = ih->fc.fs;
+	ih->fl_pdu.n_pci.bs = ih->fc.bs;
+	ih->fl_pdu.n_pci.st = ih->fc.st;
+	ih->fl_pdu.sz = 0;
+	memmove(&ih->fl_pdu.n_ai, &ih->fc.n_ai, sizeof(n_ai_t));
+	ih->in.cfg_bs = ih->fc.bs;
+	ih->in.fc_pend = N_FC_NONE;
+
+	if (n_pdu_pack(N_ADM(ih), &ih->fl_pdu, &id, ih->out.msg) != N_OK)
 	{
-		ih->clbs.on_error(N_UNE_PDU);
-		signaling(N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_sz, N_UNE_PDU);
+		ih->out.sts = out_sts;
+		return N_ERROR;
 	}
 
-	/* Copy all data, init the CFrames reception parameters and send a FC */
-	memmove(ih->in.msg, ih->in.pdu.dt, ih->in.pdu.sz);
-	ih->in.msg_sz = ih->in.pdu.n_pci.dl;
-	ih->in.msg_pos = ih->in.pdu.sz;
-	ih->in.cf_cnt = 0;
-	ih->in.wf_cnt = 0;
-	signaling(N_FF_INDN, &ih->in, (void*)ih->clbs.ff_indn, ih->in.msg_sz, N_OK);
-	send_N_PCI_T_FC(ih);
-	return N_OK;
+	n_rslt rslt = send_rslt(ih, ih->clbs.send_frame(ih->fr_id_type, id, N_FMT(ih->fc.fr_fmt), n_get_dt_offset(N_ADM(ih), N_PCI_T_FC, ih->fl_pdu.sz), ih->fl_pdu.dt));
+	ih->out.sts = out_sts;
+	/* the TX buffer of the driver is full: retried by the process as well */
+	if (rslt == N_TX_BUSY)
+	{
+		rate_refund(ih, N_FMT(ih->fc.fr_fmt), (uint8_t)((N_ADM(ih) & 0x01) + 3U));
+		ih->in.fc_pend = N_FC_DEFERRED;
+	}
+	return rslt == N_TX_BUSY ? N_TX_BUSY : N_OK;
 }
 
+#endif
+
 /*
- * Process inbound Single Frame reception and report to the upper layer using the
- * indication callback function.
+ * Check if the address information of a peer matches a received PDU. N_AE is
+ * part of the address only in the extended and mixed modes.
  */
-static n_rslt process_in_sf(iso15765_t* ih)
+inline static uint8_t peer_match(addr_md md, const n_ai_t* peer, const n_ai_t* n_ai)
 {
-	/* If reception is in progress: Terminate the current reception, report an
-	* N_USData.indication, with <N_Result> set to N_UNEXP_PDU, to the upper layer, and
-	* process the SF N_PDU as the start of a new reception.*/
-	if ((ih->in.sts & N_S_RX_BUSY) != 0)
+	if (peer->n_sa != n_ai->n_sa || peer->n_ta != n_ai->n_ta)
 	{
-		ih->clbs.on_error(N_UNE_PDU);
-		signaling(N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_sz, N_UNE_PDU);
+		return 0;
 	}
-	memmove(&ih->in.msg[0], ih->in.pdu.dt, ih->in.pdu.n_pci.dl);
-	ih->in.sts = N_S_IDLE;
-	signaling(N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.pdu.n_pci.dl, N_OK);
-	return N_OK;
+	if (md == N_ADM_EXTENDED || md == N_ADM_MIXED11 || md == N_ADM_MIXED29)
+	{
+		return peer->n_ae == n_ai->n_ae ? 1 : 0;
+	}
+	return 1;
 }
 
+#ifndef I15765_TX_ONLY
 /*
- * Process inbound Consecutive Frames. Perform all the required checks according
- * to (ref: iso15765-2 p.26) and if everything is ok copy all the data to the
- * inbound stream buffer and update the reception parameters (CF_cnt,timeouts etc)
+ * Keep the FlowControl of the reception in progress with the configured
+ * parameters, overridden by the parameters changed for its peer (if any)
  */
-static n_rslt process_in_cf(iso15765_t* ih)
+inline static void set_cfg_FC(iso15765_t* ih)
 {
-	n_rslt rslt = N_OK;
+	uint8_t bs = ih->config.bs;
+	uint8_t stmin = ih->config.stmin;
 
-	/* According to (ref: iso15765-2 p.26) if we are not in progress of
-	* reception we should ignore it */
-	if ((ih->in.sts & N_S_RX_BUSY) == 0)
+	for (uint8_t i = 0; ih->peers != NULL && i < ih->peer_elms; i++)
 	{
-		rslt = N_UNE_CF;
-		goto in_cf_error;
+		n_peer_param_t* p = &ih->peers[i];
+
+		if (p->used != 0 && peer_match(N_ADM(ih), &p->n_ai, &ih->in.pdu.n_ai))
+		{
+			bs = (p->used & (1U << N_BS)) != 0 ? p->bs : bs;
+			stmin = (p->used & (1U << N_ST_MIN)) != 0 ? p->stmin : stmin;
+			break;
+		}
 	}
+	set_N_PCI_T_FC(ih, N_CONTINUE, bs, stmin);
+}
 
-	/* Increase the CF counter and check if the reception sequence is ok */
+/*
+ * A FlowControl is due for the reception. Either send it with the configured
+ * parameters or hold it (gateway operation) until it is released.
+ */
+inline static void request_N_PCI_T_FC(iso15765_t* ih)
+{
+	set_cfg_FC(ih);
+	if (ih->fc_hold != 0)
+	{
+		ih->in.fc_pend = N_FC_HELD;
+		return;
+	}
+	send_N_PCI_T_FC(ih);
+}
+
+#endif
+
+/*
+ * Apply a N_ChangeParameter request. The parameters are not changed during a
+ * reception which is affected by them (ref: iso15765-2 N_RX_ON)
+ */
+static n_rslt change_param(iso15765_t* ih, const n_chg_param_req_t* req)
+{
+	switch (req->param)
+	{
+	case N_ST_MIN:
+		/* 0x00-0x7F: ms, 0xF1-0xF9: 100-900 us. The rest is reserved */
+		if (req->pval > 0x7FU && (req->pval < 0xF1U || req->pval > 0xF9U))
+		{
+			return N_WRG_VALUE;
+		}
+		break;
+	case N_BS:
+		break;
+	default:
+		return N_WRG_PARAM;
+	}
+
+	if (req->scope != N_CHG_SESSION && req->scope != N_CHG_PEER)
+	{
+		return N_WRG_PARAM;
+	}
+
+	if ((ih->in.sts & N_S_RX_BUSY) != 0
+		&& (req->scope == N_CHG_SESSION || peer_match(N_ADM(ih), &req->n_ai, &ih->in.pdu.n_ai)))
+	{
+		return N_RX_BUSY;
+	}
+
+	if (req->scope == N_CHG_SESSION)
+	{
+		if (req->param == N_BS)
+		{
+			ih->config.bs = req->pval;
+		}
+		else
+		{
+			ih->config.stmin = req->pval;
+		}
+		return N_OK;
+	}
+
+	/* the entry of the peer, or else a free one */
+	n_peer_param_t* entry = NULL;
+	for (uint8_t i = 0; ih->peers != NULL && i < ih->peer_elms; i++)
+	{
+		n_peer_param_t* p = &ih->peers[i];
+
+		if (p->used != 0 && peer_match(N_ADM(ih), &p->n_ai, &req->n_ai))
+		{
+			entry = p;
+			break;
+		}
+		if (p->used == 0 && entry == NULL)
+		{
+			entry = p;
+		}
+	}
+	if (entry == NULL)
+	{
+		return N_OVFLW;
+	}
+
+	memmove(&entry->n_ai, &req->n_ai, sizeof(n_ai_t));
+	if (req->param == N_BS)
+	{
+		entry->bs = req->pval;
+	}
+	else
+	{
+		entry->stmin = req->pval;
+	}
+	entry->used |= (uint8_t)(1U << req->param);
+	return N_OK;
+}
+
+/*
+ * Helper function to set some basic stream parameters value
+ */
+inline static void set_stream_data(n_iostream_t* ist, uint8_t cf, uint8_t wf, stream_sts sts)
+{
+	ist->cf_cnt = cf;
+	ist->wf_cnt = wf;
+	ist->sts = sts;
+}
+
+#ifndef I15765_RX_ONLY
+/*
+ * Check if current Wait Flow status counter reached the max WFS
+ */
+inline static n_rslt check_max_wf_capacity(iso15765_t* ih)
+{
+	if (ih->out.wf_cnt < ih->config.wf)
+	{
+		return N_OK;
+	}
+
+	report_error(ih, N_WFT_OVRN);
+	set_stream_data(&ih->out, 0, 0, N_S_IDLE);
+	tx_token_done(ih, N_WFT_OVRN);
+	return N_WFT_OVRN;
+}
+
+#endif
+
+#ifndef I15765_TX_ONLY
+/*
+ * Process inbound First Frame reception and report to the upper layer using the
+ * indication callback function.
+ */
+static n_rslt process_in_ff(iso15765_t* ih)
+{
+	/* the message must fit in the buffer and exceed the payload of the FF */
+	if (ih->in.pdu.n_pci.dl > I15765_MSG_SIZE || ih->in.pdu.n_pci.dl <= ih->in.pdu.sz)
+	{
+		report_error(ih, N_INV_REQ_SZ);
+		return N_INV_REQ_SZ;
+	}
+	/* If reception is in progress: Terminate the current reception, report an
+	* N_USData.indication, with <N_Result> set to N_UNEXP_PDU, to the upper layer, and
+	* process the FF N_PDU as the start of a new reception.*/
+	if ((ih->in.sts & N_S_RX_BUSY) != 0)
+	{
+		report_error(ih, N_UNE_PDU);
+		signaling(ih, N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_sz, N_UNE_PDU);
+	}
+
+	/* all the buffers are lent to the application: refuse the message */
+	if (rx_acquire(ih) != N_OK)
+	{
+		set_N_PCI_T_FC(ih, N_OVERFLOW, 0, 0);
+		send_N_PCI_T_FC(ih);
+		report_error(ih, N_BUFFER_OVFLW);
+		return N_BUFFER_OVFLW;
+	}
+
+	/* Copy all data, init the CFrames reception parameters and send a FC */
+	memmove(rx_msg(ih), ih->in.pdu.dt, ih->in.pdu.sz);
+	N_DIGEST_START(ih, &ih->in, ih->in.pdu.dt, ih->in.pdu.sz);
+	ih->in.msg_sz = ih->in.pdu.n_pci.dl;
+	ih->in.msg_pos = ih->in.pdu.sz;
+	ih->in.cf_cnt = 0;
+	ih->in.wf_cnt = 0;
+	signaling(ih, N_FF_INDN, &ih->in, (void*)ih->clbs.ff_indn, ih->in.msg_sz, N_OK);
+	request_N_PCI_T_FC(ih);
+	return N_OK;
+}
+
+/*
+ * Process inbound Single Frame reception and report to the upper layer using the
+ * indication callback function.
+ */
+static n_rslt process_in_sf(iso15765_t* ih)
+{
+	/* If reception is in progress: Terminate the current reception, report an
+	* N_USData.indication, with <N_Result> set to N_UNEXP_PDU, to the upper layer, and
+	* process the SF N_PDU as the start of a new reception.*/
+	if ((ih->in.sts & N_S_RX_BUSY) != 0)
+	{
+		report_error(ih, N_UNE_PDU);
+		signaling(ih, N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_sz, N_UNE_PDU);
+	}
+	if (rx_acquire(ih) != N_OK)
+	{
+		report_error(ih, N_BUFFER_OVFLW);
+		return N_BUFFER_OVFLW;
+	}
+	memmove(rx_msg(ih), ih->in.pdu.dt, ih->in.pdu.n_pci.dl);
+	N_DIGEST_START(ih, &ih->in, ih->in.pdu.dt, ih->in.pdu.n_pci.dl);
+	ih->in.sts = N_S_IDLE;
+	signaling(ih, N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.pdu.n_pci.dl, N_OK);
+	return N_OK;
+}
+
+/*
+ * Process inbound Consecutive Frames. Perform all the required checks according
+ * to (ref: iso15765-2 p.26) and if everything is ok copy all the data to the
+ * inbound stream buffer and update the reception parameters (CF_cnt,timeouts etc)
+ */
+static n_rslt process_in_cf(iso15765_t* ih)
+{
+	n_rslt rslt = N_OK;
+
+	/* According to (ref: iso15765-2 p.26) if we are not in progress of
+	* reception we should ignore it */
+	if ((ih->in.sts & N_S_RX_BUSY) == 0)
+	{
+		rslt = N_UNE_CF;
+		goto in_cf_error;
+	}
+
+	/* a CF of another peer does not belong to the reception either: it is
+	* ignored. The FlowControl record keeps the address of the peer */
+	n_ai_t peer = ih->fc.n_ai;
+
+	peer.n_sa = ih->fc.n_ai.n_ta;
+	peer.n_ta = ih->fc.n_ai.n_sa;
+	if (peer_match(N_ADM(ih), &peer, &ih->in.pdu.n_ai) == 0)
+	{
+		return N_UNE_CF;
+	}
+
+	/* Increase the CF counter and check if the reception sequence is ok */
 	ih->in.cf_cnt = ih->in.cf_cnt + 1 > 0xFF ? 0 : ih->in.cf_cnt + 1;
 	ih->in.sn_glb = (ih->in.sn_glb + 1) & 0x0F;
 	if (ih->in.sn_glb != ih->in.pdu.n_pci.sn)
 	{
-		rslt = N_INV_SEQ_NUM;
-		goto in_cf_error;
+		/* the interrupted reception is indicated with the received part */
+		report_error(ih, N_INV_SEQ_NUM);
+		signaling(ih, N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_pos, N_INV_SEQ_NUM);
+		ih->in.sts = N_S_IDLE;
+		return N_INV_SEQ_NUM;
 	}
 	
 	/* As long as everything is ok the we copy the frame data to the inbound
 	* stream buffer. Afterwards check if the message size is completed and
 	* signal the user and afterwards reset the inboud stream */
-	memmove(&ih->in.msg[ih->in.msg_pos], ih->in.pdu.dt, ih->in.pdu.sz);
-	ih->in.msg_pos += ih->in.pdu.sz;
+	/* the padding of the last CF is not copied */
+	uint16_t sz = ih->in.msg_sz - ih->in.msg_pos;
+
+	sz = ih->in.pdu.sz < sz ? ih->in.pdu.sz : sz;
+	memmove(&rx_msg(ih)[ih->in.msg_pos], ih->in.pdu.dt, sz);
+	N_DIGEST_NEXT(ih, &ih->in, ih->in.pdu.dt, sz);
+	ih->in.msg_pos += sz;
 
 	if (ih->in.msg_pos >= ih->in.msg_sz)
 	{
-		signaling(N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_sz, N_OK);
-		memset(&ih->in, 0, sizeof(n_iostream_t));
-		ih->in.last_upd.n_cr = 0;
+		signaling(ih, N_INDN, &ih->in, (void*)ih->clbs.indn, ih->in.msg_sz, N_OK);
+		/* reset the stream but keep the message buffer, since it is referenced
+		* by the event queue records until the next reception starts */
+		memset(&ih->in, 0, offsetof(n_iostream_t, msg));
 		//	ih->in.sts = N_S_IDLE;
 		return N_OK;
 	}
-	/* if we reach the max CF counter, then we send a FC frame */
-	if(ih->config.bs != 0)
+	/* if we reach the max CF counter (advertised in the last FC), then we send a FC frame */
+	if(ih->in.cfg_bs != 0)
 	{
-		if (ih->in.cf_cnt == ih->config.bs)
+		if (ih->in.cf_cnt == ih->in.cfg_bs)
 		{
 			ih->in.cf_cnt = 0;
-			send_N_PCI_T_FC(ih);
+			request_N_PCI_T_FC(ih);
 		}
 	}
 	/* Update the Cr timer */
-	ih->in.last_upd.n_cr = ih->clbs.get_ms();
+	ih->in.last_upd.n_cr = rx_time_ms(ih);
 	return rslt;
 
 in_cf_error:
-	ih->clbs.on_error(rslt);
+	report_error(ih, rslt);
 	ih->in.sts = N_S_IDLE;
 	return rslt;
 }
 
+#endif
+
+#ifndef I15765_RX_ONLY
 /*
  * Process inbound Flow Control Frames. Outcome depends on the stream status
  * (if it is busy etc) as well as the Flow Control Status.
@@ -773,6 +1366,13 @@ static n_rslt process_in_fc(iso15765_t* ih)
 		return rslt;
 	}
 
+	/* A FlowControl which arrived after the N_Bs timeout is not accepted,
+	* even if it was queued before the timeout was checked */
+	if (process_timeouts(ih, rx_time_ms(ih)) != N_OK)
+	{
+		return N_TIMEOUT_Bs;
+	}
+
 	switch (ih->in.pdu.n_pci.fs)
 	{
 	case N_WAIT:
@@ -783,7 +1383,7 @@ static n_rslt process_in_fc(iso15765_t* ih)
 		{
 			return N_OK;			
 		}
-		ih->out.last_upd.n_bs = ih->clbs.get_ms();
+		ih->out.last_upd.n_bs = rx_time_ms(ih);
 		rslt = N_WFT_OVRN;
 		break;
 	case N_OVERFLOW:
@@ -794,7 +1394,7 @@ static n_rslt process_in_fc(iso15765_t* ih)
 		* to the outbound stream, reset the counters of CFs(1) and WFs(0)
 		* and change the outbound stream status to Ready */
 		ih->out.cfg_bs = ih->in.pdu.n_pci.bs;
-		ih->out.stmin = ih->in.pdu.n_pci.st;
+		ih->out.stmin = n_stmin_ms(ih->in.pdu.n_pci.st);
 		set_stream_data(&ih->out, 1, 0, N_S_TX_READY);
 		return N_OK;
 	default:
@@ -807,11 +1407,14 @@ static n_rslt process_in_fc(iso15765_t* ih)
 	* and change the outbound stream status to Idle. Use on_error
 	* callback to inform the upper layer */
 	set_stream_data(&ih->out, 0, 0, N_S_IDLE);
-	ih->clbs.on_error(rslt);
+	report_error(ih, rslt);
+	tx_token_done(ih, rslt);
 	ih->in.sts = N_S_IDLE;
 	return rslt;
 }
 
+#endif
+
 /*
  * Inbound stream process. The function receives a canbus frame dequeued by
  * the 'iso15765_process' and performs any needed operation to identify and
@@ -819,20 +1422,47 @@ static n_rslt process_in_fc(iso15765_t* ih)
  */
 inline static n_rslt iso15765_process_in(iso15765_t* ih, canbus_frame_t* frame)
 {
+#ifdef I15765_FRAME_TS
+	/* Queueing latency of the frame. A timestamp ahead of the clock counts as 0 */
+	uint64_t now = ts_now(ih);
+	uint64_t lat = (frame->ts != 0 && frame->ts < now) ? now - frame->ts : 0;
+
+	ih->rx_ts = frame->ts;
+	ih->rx_ms = ih->clbs.get_ms() - (uint32_t)(lat / ih->ts_per_ms);
+	ih->lat_sum += lat;
+	ih->lat_cnt++;
+	if (lat > ih->lat_max)
+	{
+		ih->lat_max = lat;
+	}
+#endif
 	/* Converting the canbus frame to PDU format and process it by its PCI Type */
 	ih->in.fr_fmt = frame->fr_format;
-	if (n_pdu_unpack(ih->addr_md, &ih->in.pdu, frame->id, (uint8_t)frame->dlc, frame->dt) == N_OK)
+	if (n_pdu_unpack(N_ADM(ih), &ih->in.pdu, frame->id, (cbus_dl_t)frame->dlc, frame->dt) == N_OK)
 	{
 		switch (ih->in.pdu.n_pci.pt)
 		{
 		case N_PCI_T_FC:
+#ifdef I15765_RX_ONLY
+			/* no transmission is waiting for a FlowControl */
+			return N_UNE_PDU;
+#else
 			return process_in_fc(ih);
+#endif
+#ifndef I15765_TX_ONLY
 		case N_PCI_T_CF:
 			return process_in_cf(ih);
 		case N_PCI_T_SF:
 			return process_in_sf(ih);
 		case N_PCI_T_FF:
 			return process_in_ff(ih);
+#else
+		case N_PCI_T_CF:
+		case N_PCI_T_SF:
+		case N_PCI_T_FF:
+			/* no reception in a transmission only build */
+			return N_UNE_PDU;
+#endif
 		default:
 			break;
 		}
@@ -840,10 +1470,32 @@ inline static n_rslt iso15765_process_in(iso15765_t* ih, canbus_frame_t* frame)
 
 	/* According to (ref: iso15765-2 p.26) if PDU is not valid
 	* we should ignore it */
-	ih->clbs.on_error(N_INV_PDU);
+	report_error(ih, N_INV_PDU);
 	return N_INV_PDU;
 }
 
+/*
+ * Take the handler for 'iso15765_process', 'iso15765_process_budget' or
+ * 'iso15765_tx_complete'. With atomics, a completion signaled from another
+ * core and the process contend for it; the one which fails leaves the work to
+ * the other (or to the next call).
+ */
+inline static uint8_t proc_take(iso15765_t* ih)
+{
+#ifdef I15765_ATOMIC_CAS
+	uint32_t idle = 0;
+	return I15765_ATOMIC_CAS(&ih->proc_busy, &idle, 1U) ? 1 : 0;
+#else
+	if (ih->proc_busy != 0)
+	{
+		return 0;
+	}
+	ih->proc_busy = 1;
+	return 1;
+#endif
+}
+
+#ifndef I15765_RX_ONLY
 /*
  * Procces the outbound stream.
  */
@@ -856,8 +1508,10 @@ static n_rslt iso15765_process_out(iso15765_t* ih)
 	}
 
 	uint32_t id;
+	cbus_dl_t dlc;
 	n_rslt rslt = N_ERROR;
 	n_rslt timeout = N_ERROR;
+	stream_sts sts;
 	
 	/* Find the PCI type of the pending outbound stream */
 	ih->out.pdu.n_pci.pt = n_out_frame_type(ih);
@@ -865,16 +1519,33 @@ static n_rslt iso15765_process_out(iso15765_t* ih)
 	switch (ih->out.pdu.n_pci.pt)
 	{
 	case N_PCI_T_SF:
+		/* wait until the whole message is available (streamed transmission) */
+		if (ih->out.msg_avl < ih->out.msg_sz)
+		{
+			return N_OK;
+		}
 		/* Copy all the data of the SF to the outbound stream, pack and send the canbus frame */
 		ih->out.pdu.n_pci.dl = ih->out.msg_sz;
 		ih->out.pdu.sz = ih->out.msg_sz;
+		dlc = n_get_closest_can_dl(ih->out.pdu.sz + n_get_dt_offset(N_ADM(ih), N_PCI_T_SF, ih->out.pdu.sz), N_FMT(ih->out.fr_fmt));
+
+		if (rate_take(ih, N_FMT(ih->out.fr_fmt), dlc) != N_OK)
+		{
+			return N_OK;
+		}
 
-		if (n_pdu_pack(ih->addr_md, &ih->out.pdu, &id, ih->out.msg) != N_OK)
+		if (n_pdu_pack(N_ADM(ih), &ih->out.pdu, &id, ih->out.msg) != N_OK)
 		{
 			goto iso15765_process_out_cfm;
 		}
 			
-		rslt = ih->clbs.send_frame(ih->fr_id_type, id, ih->out.fr_fmt, n_get_closest_can_dl(ih->out.pdu.sz + n_get_dt_offset(ih->addr_md, N_PCI_T_SF, ih->out.pdu.sz), ih->out.fr_fmt), ih->out.pdu.dt) == 0 ? N_OK : N_ERROR;
+		rslt = send_rslt(ih, ih->clbs.send_frame(ih->fr_id_type, id, N_FMT(ih->out.fr_fmt), dlc, ih->out.pdu.dt));
+		if (rslt == N_TX_BUSY)
+		{
+			rate_refund(ih, N_FMT(ih->out.fr_fmt), dlc);
+			return N_TX_BUSY;
+		}
+		N_DIGEST_START(ih, &ih->out, ih->out.msg, ih->out.msg_sz);
 		goto iso15765_process_out_cfm;
 		break;
 
@@ -883,9 +1554,14 @@ static n_rslt iso15765_process_out(iso15765_t* ih)
 		* for a multi-frame reception */
 		ih->out.pdu.n_pci.dl = ih->out.msg_sz;
 		ih->out.wf_cnt = 0;
-		ih->out.pdu.sz = ih->out.fr_fmt == CBUS_FR_FRM_STD ? ((ih->addr_md & 0x01) == 0 ? 6 : 5) : ((ih->addr_md & 0x01) == 0 ? 62 : 61);
+		ih->out.pdu.sz = N_TX_DL(ih) - 2 - (N_ADM(ih) & 0x01);
+		/* wait until the payload of the FF is available (streamed transmission) */
+		if (ih->out.msg_avl < ih->out.pdu.sz || rate_take(ih, N_FMT(ih->out.fr_fmt), N_TX_DL(ih)) != N_OK)
+		{
+			return N_OK;
+		}
 		ih->out.msg_pos = ih->out.pdu.sz;
-		if (n_pdu_pack(ih->addr_md, &ih->out.pdu, &id, ih->out.msg) != N_OK)
+		if (n_pdu_pack(N_ADM(ih), &ih->out.pdu, &id, ih->out.msg) != N_OK)
 		{
 			goto iso15765_process_out_cfm;
 		}
@@ -893,8 +1569,19 @@ static n_rslt iso15765_process_out(iso15765_t* ih)
 
 		/* after this frame we expect a Flow Control then assign the correct flag before the
 		* transmission to avoid any issues and start the timer */
+		sts = ih->out.sts;
 		ih->out.sts = N_S_TX_WAIT_FC;
-		rslt = ih->clbs.send_frame(ih->fr_id_type, id, ih->out.fr_fmt, ih->out.fr_fmt == CBUS_FR_FRM_STD ? 8 : 64, ih->out.pdu.dt) == 0 ? N_OK : N_ERROR;
+		rslt = send_rslt(ih, ih->clbs.send_frame(ih->fr_id_type, id, N_FMT(ih->out.fr_fmt), N_TX_DL(ih), ih->out.pdu.dt));
+		if (rslt == N_TX_BUSY)
+		{
+			/* the FF was not taken by the driver: the transmission starts again */
+			ih->out.sts = sts;
+			ih->out.msg_pos = 0;
+			ih->out.cf_cnt = 0;
+			rate_refund(ih, N_FMT(ih->out.fr_fmt), N_TX_DL(ih));
+			return N_TX_BUSY;
+		}
+		N_DIGEST_START(ih, &ih->out, ih->out.msg, ih->out.pdu.sz);
 		ih->out.last_upd.n_bs = ih->clbs.get_ms();
 		return (rslt == 0) ? N_OK : N_ERROR;
 
@@ -910,25 +1597,35 @@ static n_rslt iso15765_process_out(iso15765_t* ih)
 			return N_ERROR;
 		}
 			
-		/* Increase the sequence number of the frame and the CF counter of the stream
-		* and then pack the PDU to a CANBus frame */
-		ih->out.pdu.n_pci.sn = ih->out.sn_glb;
-		ih->out.sn_glb = (ih->out.sn_glb + 1) & 0x0F;
+		uint16_t max_payload = N_TX_DL(ih) - 1 - (N_ADM(ih) & 0x01);
+		ih->out.pdu.sz = ih->out.msg_sz - ih->out.msg_pos;
+		ih->out.pdu.sz = ih->out.pdu.sz >= max_payload ? max_payload : ih->out.pdu.sz;
 
-		if (ih->out.fr_fmt == CBUS_FR_FRM_STD)
+		/* wait until the payload of the CF is available (streamed transmission) */
+		if (ih->out.msg_avl < ih->out.msg_pos + ih->out.pdu.sz)
 		{
-			uint8_t max_payload = (ih->addr_md & 0x01) == 0 ? 7 : 6;
-			ih->out.pdu.sz = ih->out.msg_sz - ih->out.msg_pos;
-			ih->out.pdu.sz = ih->out.pdu.sz >= max_payload ? max_payload : ih->out.pdu.sz;
+			return N_OK;
 		}
-		else
+
+		uint8_t of1 = (N_ADM(ih) & 0x01) == 0 ? 1 : 2;
+		dlc = n_get_closest_can_dl(ih->out.pdu.sz + of1, N_FMT(ih->out.fr_fmt));
+		if (rate_take(ih, N_FMT(ih->out.fr_fmt), dlc) != N_OK)
 		{
-			uint8_t max_payload = (ih->addr_md & 0x01) == 0 ? 63 : 62;
-			ih->out.pdu.sz = ih->out.msg_sz - ih->out.msg_pos;
-			ih->out.pdu.sz = ih->out.pdu.sz >= max_payload ? max_payload : ih->out.pdu.sz;
+			return N_OK;
 		}
 
-		if (n_pdu_pack(ih->addr_md, &ih->out.pdu, &id, &ih->out.msg[ih->out.msg_pos]) != N_OK)
+		/* Keep the state of the stream, in case that the driver does not take the frame */
+		sts = ih->out.sts;
+		uint8_t sn_glb = ih->out.sn_glb;
+		uint8_t cf_cnt = ih->out.cf_cnt;
+		uint16_t msg_pos = ih->out.msg_pos;
+
+		/* Increase the sequence number of the frame and the CF counter of the stream
+		* and then pack the PDU to a CANBus frame */
+		ih->out.pdu.n_pci.sn = ih->out.sn_glb;
+		ih->out.sn_glb = (ih->out.sn_glb + 1) & 0x0F;
+
+		if (n_pdu_pack(N_ADM(ih), &ih->out.pdu, &id, &ih->out.msg[ih->out.msg_pos]) != N_OK)
 		{
 			goto iso15765_process_out_cfm;
 		}
@@ -943,10 +1640,21 @@ static n_rslt iso15765_process_out(iso15765_t* ih)
 			ih->out.sts = N_S_TX_WAIT_FC;
 			ih->out.last_upd.n_bs = ih->clbs.get_ms();
 		}
-		ih->out.cf_cnt = ih->out.cf_cnt == 0xFF ? 0 : ih->out.cf_cnt + 1;
+		/* 0 is the start of a transmission (and a block size of 0 would match it) */
+		ih->out.cf_cnt = ih->out.cf_cnt == 0xFF ? 1 : ih->out.cf_cnt + 1;
 		/* send the canbus frame! */
-		uint8_t of1 = (ih->addr_md & 0x01) == 0 ? 1 : 2;
-		rslt = ih->clbs.send_frame(ih->fr_id_type, id, ih->out.fr_fmt, n_get_closest_can_dl(ih->out.pdu.sz + of1, ih->out.fr_fmt), ih->out.pdu.dt) == 0 ? N_OK : N_ERROR;
+		rslt = send_rslt(ih, ih->clbs.send_frame(ih->fr_id_type, id, N_FMT(ih->out.fr_fmt), dlc, ih->out.pdu.dt));
+		if (rslt == N_TX_BUSY)
+		{
+			/* the same CF (SN and payload) is sent again later */
+			ih->out.sts = sts;
+			ih->out.sn_glb = sn_glb;
+			ih->out.cf_cnt = cf_cnt;
+			ih->out.msg_pos = msg_pos;
+			rate_refund(ih, N_FMT(ih->out.fr_fmt), dlc);
+			return N_TX_BUSY;
+		}
+		N_DIGEST_NEXT(ih, &ih->out, &ih->out.msg[msg_pos], ih->out.pdu.sz);
 		ih->out.last_upd.n_cs = ih->clbs.get_ms();
 		if (ih->out.msg_pos >= ih->out.msg_sz)
 		{
@@ -964,58 +1672,476 @@ iso15765_process_out_cfm:
 	ih->out.sts = N_S_IDLE;
 	ih->out.cf_cnt = 0;
 	ih->out.wf_cnt = 0;
-	signaling(N_CONF, &ih->out, (void*)ih->clbs.cfm, 0, rslt);
+	signaling(ih, N_CONF, &ih->out, (void*)ih->clbs.cfm, 0, rslt);
+	tx_token_done(ih, rslt);
 	return rslt;
 }
 
-/******************************************************************************
-* Definition  | Public Functions
-******************************************************************************/
-
 /*
- * Initialize and check if the configuration parameters of the ISO15765 handler are
- * correct. Not assigned callback which are not assigned will be automatically assigned
- * to the static UNUSED functions. If no error occurs, the system can start the service.
+ * Process the outbound stream after a TX completion. Without a separation time
+ * (STmin 0) the CFs are sent back to back until the driver reports a full TX
+ * buffer (N_SEND_BUSY), the block ends or the message is completed.
+ * 'iso15765_process' itself sends one frame per call.
  */
-n_rslt iso15765_init(iso15765_t* instance)
+static n_rslt process_out_burst(iso15765_t* ih)
 {
-	if (instance == NULL)
-	{
-		return N_NULL;
-	}
+	n_rslt rslt;
+	uint16_t msg_pos;
 
-	/* check if parameters have correct values */
-	if ((instance->fr_id_type != CBUS_ID_T_STANDARD && instance->fr_id_type != CBUS_ID_T_EXTENDED)
-		|| (instance->fr_id_type & instance->addr_md) == 0)
+	do
 	{
-		return N_WRG_VALUE;
-	}
+		msg_pos = ih->out.msg_pos;
+		rslt = iso15765_process_out(ih);
+	} while (rslt == N_OK && ih->out.stmin == 0 && ih->out.msg_pos != msg_pos
+		&& (ih->out.sts == N_S_TX_BUSY || ih->out.sts == N_S_TX_READY));
+	return rslt;
+}
 
-	/* check if must-have functions are assigned */
-	if (instance->clbs.send_frame == NULL || instance->clbs.get_ms == NULL)
-	{
-		return N_MISSING_CLB;
-	}
+/*
+ * End of 'iso15765_process' / 'iso15765_tx_complete'. A TX completion which
+ * arrives after the last check of 'tx_kick' but before 'proc_busy' is cleared
+ * returns N_TX_BUSY and would be lost, so 'proc_busy' is cleared first and
+ * 'tx_kick' is checked again.
+ */
+static n_rslt proc_release(iso15765_t* ih)
+{
+	n_rslt rslt = N_OK;
 
-	/* if optional functions are not assigned then use the defaults */
-	if (instance->clbs.indn == NULL)
+	for (;;)
 	{
-		instance->clbs.indn = indn;
+		while (ih->tx_kick != 0)
+		{
+			ih->tx_kick = 0;
+			rslt |= process_out_burst(ih);
+		}
+		ih->proc_busy = 0;
+		I15765_MEMORY_BARRIER();
+		/* else the completion which took the stream sends the frames */
+		if (ih->tx_kick == 0 || proc_take(ih) == 0)
+		{
+			return rslt;
+		}
 	}
+}
 
-	if (instance->clbs.ff_indn == NULL)
+/*
+ * Helper function to check if a transmission request can be accepted
+ */
+static n_rslt check_send_request(iso15765_t* instance, cbus_fr_format fr_fmt, const n_ai_t* n_ai, uint16_t msg_sz)
+{
+	if (instance->init_sts != N_OK)
 	{
-		instance->clbs.ff_indn = ff_indn;
+		return N_ERROR;
 	}
 
-	if (instance->clbs.cfm == NULL)
+	/* Make sure that the requested size is fitting in our outbound buffer */
+	if (msg_sz > I15765_MSG_SIZE)
 	{
-		instance->clbs.cfm = cfm;
+		return N_BUFFER_OVFLW;
 	}
-
-	if (instance->clbs.cfg_cfm == NULL)
+	/* or there is not actual message to be sent */
+	if (msg_sz == 0)
 	{
-		instance->clbs.cfg_cfm = cfg_cfm;
+		return N_INV_REQ_SZ;
+	}
+	/* check if frame type is correct */
+#if defined(I15765_CLASSIC_ONLY)
+	if (fr_fmt != CBUS_FR_FRM_STD)
+#elif defined(I15765_CANXL)
+	if (fr_fmt != CBUS_FR_FRM_STD && fr_fmt != CBUS_FR_FRM_FD && fr_fmt != CBUS_FR_FRM_XL)
+#else
+	if (fr_fmt != CBUS_FR_FRM_STD && fr_fmt != CBUS_FR_FRM_FD)
+#endif
+	{
+		return N_INV;
+	}
+	/* check if Target Address Type is correct */
+	if (n_ai->n_tt != N_TA_T_PHY && n_ai->n_tt != N_TA_T_FUNC)
+	{
+		return N_INV;
+	}
+	return N_OK;
+}
+
+/*
+ * Helper function to prepare the outbound stream for a new transmission
+ */
+inline static void start_send(iso15765_t* instance, cbus_fr_format fr_fmt, const n_ai_t* n_ai, uint16_t msg_sz)
+{
+	instance->out.fr_fmt = fr_fmt;
+	instance->out.tx_dl = n_fmt_dl(fr_fmt);
+#ifdef I15765_CANXL
+	/* no padding in CAN XL frames: a message which does not fit in a SF is
+	* segmented with frames smaller than the message, so the FF never takes
+	* the whole message */
+	if (fr_fmt == CBUS_FR_FRM_XL && msg_sz > n_sf_max(N_ADM(instance), I15765_MAX_DL) && msg_sz < I15765_MAX_DL)
+	{
+		instance->out.tx_dl = (cbus_dl_t)msg_sz;
+	}
+#endif
+	/* pick the frame format and CAN DL with the lowest bus time (CAN FD requests) */
+	if (instance->bus != NULL && N_FMT(fr_fmt) == CBUS_FR_FRM_FD)
+	{
+		iso15765_best_layout(instance->bus, N_ADM(instance), instance->fr_id_type, msg_sz, &instance->out.fr_fmt, &instance->out.tx_dl);
+	}
+	instance->out.msg_sz = msg_sz;
+	instance->out.msg_pos = 0;
+#ifdef I15765_DIGEST
+	instance->out.crc = 0;
+#endif
+	memmove(&instance->out.pdu.n_ai, n_ai, sizeof(n_ai_t));
+	instance->out.sn_glb = 1;
+	instance->out.cf_cnt = 0;
+	instance->out.wf_cnt = 0;
+	instance->out.sts = N_S_TX_BUSY;
+	instance->tx_tok = NULL;
+}
+
+/*
+ * Helper function to copy a request to the outbound stream and start it
+ */
+static void start_send_req(iso15765_t* instance, n_req_t* frame, uint8_t prio, n_token_t* tok)
+{
+	memmove(instance->out.msg, frame->msg, frame->msg_sz);
+	instance->out.msg_avl = frame->msg_sz;
+	instance->out.prio = prio;
+	start_send(instance, frame->fr_fmt, &frame->n_ai, frame->msg_sz);
+	instance->tx_tok = tok;
+}
+
+/*
+ * Insert a request in the TX queue. Requests are kept sorted by priority and
+ * in FIFO order within the same priority.
+ */
+static n_rslt txq_insert(n_txq_t* q, n_req_t* frame, uint8_t prio, n_token_t* tok)
+{
+	if (q->cnt >= q->elms)
+	{
+		return N_BUFFER_OVFLW;
+	}
+
+	uint8_t pos = q->cnt;
+	while (pos > 0 && q->buf[pos - 1U].prio > prio)
+	{
+		q->buf[pos] = q->buf[pos - 1U];
+		pos--;
+	}
+	q->buf[pos].req = frame;
+	q->buf[pos].prio = prio;
+	q->buf[pos].tok = tok;
+	q->cnt++;
+	return N_OK;
+}
+
+/*
+ * Remove the first (highest priority) request of the TX queue
+ */
+static n_txq_elm_t txq_pop(n_txq_t* q)
+{
+	n_txq_elm_t elm = q->buf[0];
+
+	q->cnt--;
+	memmove(&q->buf[0], &q->buf[1], q->cnt * sizeof(n_txq_elm_t));
+	return elm;
+}
+
+/*
+ * Send a queued Single Frame between the CFs of the transmission in progress
+ * and confirm it to the upper layer. The flow control pdu is used as scratch,
+ * it is only needed while a FC is being sent.
+ */
+static n_rslt send_preempt_sf(iso15765_t* ih, n_req_t* req, n_token_t* tok)
+{
+	uint32_t id;
+	n_rslt rslt = N_ERROR;
+
+	ih->fl_pdu.n_pci.pt = N_PCI_T_SF;
+	ih->fl_pdu.n_pci.dl = req->msg_sz;
+	ih->fl_pdu.sz = req->msg_sz;
+	memmove(&ih->fl_pdu.n_ai, &req->n_ai, sizeof(n_ai_t));
+
+	if (n_pdu_pack(N_ADM(ih), &ih->fl_pdu, &id, req->msg) == N_OK)
+	{
+		rslt = send_rslt(ih, ih->clbs.send_frame(ih->fr_id_type, id, N_FMT(req->fr_fmt), n_get_closest_can_dl(ih->fl_pdu.sz + n_get_dt_offset(N_ADM(ih), N_PCI_T_SF, ih->fl_pdu.sz), N_FMT(req->fr_fmt)), ih->fl_pdu.dt));
+	}
+
+	/* the request stays in the queue */
+	if (rslt == N_TX_BUSY)
+	{
+		return N_TX_BUSY;
+	}
+
+#ifdef I15765_DIGEST
+	uint32_t crc = iso15765_digest(ih->digest, 0, req->msg, req->msg_sz);
+
+	if (tok != NULL)
+	{
+		tok->crc = crc;
+	}
+#else
+	uint32_t crc = 0;
+#endif
+	if (ih->evtq != NULL)
+	{
+		evtq_push(ih->evtq, N_CONF, req->fr_fmt, &req->n_ai, NULL, 0, rslt, 0, crc);
+	}
+	else
+	{
+		sgn_conf.rslt = rslt;
+#ifdef I15765_DIGEST
+		sgn_conf.crc = crc;
+#endif
+		memmove(&sgn_conf.n_ai, &req->n_ai, sizeof(n_ai_t));
+		memmove(&sgn_conf.n_pci, &ih->fl_pdu.n_pci, sizeof(n_pci_t));
+		ih->clbs.cfm(&sgn_conf);
+	}
+	token_complete(tok, rslt);
+	return rslt;
+}
+
+/*
+ * Process the TX queue: start the next request when the outbound stream is
+ * idle, or send a higher priority Single Frame to another target while the
+ * transfer in progress waits (STmin gap or FlowControl).
+ */
+static n_rslt process_txq(iso15765_t* ih)
+{
+	n_txq_t* q = ih->txq;
+
+	if (q->cnt == 0)
+	{
+		return N_OK;
+	}
+
+	if (ih->out.sts == N_S_IDLE)
+	{
+		n_txq_elm_t elm = txq_pop(q);
+		start_send_req(ih, elm.req, elm.prio, elm.tok);
+		return N_OK;
+	}
+
+	n_req_t* req = q->buf[0].req;
+
+	/* only between the CFs of a segmented transfer (FF already sent) */
+	if (q->buf[0].prio >= ih->out.prio || ih->out.msg_pos == 0
+		|| req->msg_sz > n_sf_max(N_ADM(ih), n_fmt_dl(N_FMT(req->fr_fmt))))
+	{
+		return N_OK;
+	}
+
+	/* a SF to the same target would interrupt the reception of the transfer */
+	if (req->n_ai.n_ta == ih->out.pdu.n_ai.n_ta && req->n_ai.n_sa == ih->out.pdu.n_ai.n_sa
+		&& req->n_ai.n_tt == ih->out.pdu.n_ai.n_tt && req->n_ai.n_ae == ih->out.pdu.n_ai.n_ae)
+	{
+		return N_OK;
+	}
+
+	if (ih->out.sts == N_S_TX_READY
+		&& has_interval_passed(ih->clbs.get_ms(), ih->out.last_upd.n_cs, ih->out.stmin) != N_INV)
+	{
+		return N_OK;
+	}
+
+	if (ih->out.sts != N_S_TX_READY && ih->out.sts != N_S_TX_WAIT_FC)
+	{
+		return N_OK;
+	}
+
+	cbus_dl_t dlc = n_get_closest_can_dl(req->msg_sz + n_get_dt_offset(N_ADM(ih), N_PCI_T_SF, req->msg_sz), N_FMT(req->fr_fmt));
+	if (rate_take(ih, N_FMT(req->fr_fmt), dlc) != N_OK)
+	{
+		return N_OK;
+	}
+
+	n_rslt rslt = send_preempt_sf(ih, req, q->buf[0].tok);
+	if (rslt == N_TX_BUSY)
+	{
+		rate_refund(ih, N_FMT(req->fr_fmt), dlc);
+		return N_OK;
+	}
+	txq_pop(q);
+	q->preempted++;
+	return rslt;
+}
+
+#ifdef I15765_ATOMIC_CAS
+/*
+ * Take the submitted requests: they are moved to the TX queue (if assigned) or
+ * started when the outbound stream is idle. Single consumer.
+ */
+static void process_subq(iso15765_t* ih)
+{
+	n_subq_t* q = ih->subq;
+
+	for (;;)
+	{
+		n_subq_elm_t* elm = &q->buf[q->tail & q->mask];
+
+		/* the slot is not written yet (empty queue or producer in progress) */
+		if (I15765_ATOMIC_LOAD(&elm->seq) != q->tail + 1U)
+		{
+			return;
+		}
+
+		if (ih->txq != NULL)
+		{
+			if (txq_insert(ih->txq, elm->req, elm->prio, elm->tok) != N_OK)
+			{
+				return;
+			}
+		}
+		else if (ih->out.sts == N_S_IDLE)
+		{
+			start_send_req(ih, elm->req, elm->prio, elm->tok);
+		}
+		else
+		{
+			return;
+		}
+
+		/* release the slot for the next round of the producers */
+		I15765_ATOMIC_STORE(&elm->seq, q->tail + q->mask + 1U);
+		q->tail++;
+	}
+}
+#endif
+#endif
+
+/*
+ * Copy a slot of the reception queue to a frame
+ */
+static inline void inq_copy(canbus_frame_t* frame, const n_inq_slot_t* slot)
+{
+#ifdef I15765_CLASSIC_ONLY
+	frame->fr_format = CBUS_FR_FRM_STD;
+	frame->id = slot->id;
+	frame->id_type = slot->id_type;
+	frame->dlc = slot->dlc;
+	memmove(frame->dt, slot->dt, sizeof(slot->dt));
+#elif defined(I15765_CANXL)
+	/* only the used part of the (large) slot is read */
+	uint16_t dlc = slot->dlc > I15765_MAX_DL ? I15765_MAX_DL : slot->dlc;
+	memmove(frame, slot, offsetof(canbus_frame_t, dt) + dlc);
+#else
+	memmove(frame, slot, sizeof(canbus_frame_t));
+#endif
+#ifdef I15765_FRAME_TS
+	frame->ts = slot->ts;
+#endif
+}
+
+/*
+ * Take the next frame of the reception queue. Returns 0 if the queue is empty.
+ * The frame is copied before its slot is returned to the producer. With the
+ * DROP_OLDEST policy the producer may take the oldest slot over at any time:
+ * the slot is returned with a CAS and a copy that lost the race is discarded.
+ */
+static inline uint8_t inq_pop(iso15765_t* ih, canbus_frame_t* frame)
+{
+	uint32_t pos = 0;
+
+	for (;;)
+	{
+		const n_inq_slot_t* slot = (const n_inq_slot_t*)iqueue_peek(&ih->inqueue, &pos);
+
+		if (slot == NULL)
+		{
+			return 0;
+		}
+		inq_copy(frame, slot);
+#ifdef I15765_ATOMIC_CAS
+		if (ih->inq_policy == N_INQ_DROP_OLDEST)
+		{
+			if (I15765_ATOMIC_CAS(&ih->inqueue.tail, &pos, iqueue_next(&ih->inqueue, pos)))
+			{
+				return 1;
+			}
+			continue;
+		}
+#endif
+		I15765_MEMORY_BARRIER();
+		ih->inqueue.tail = iqueue_next(&ih->inqueue, pos);
+		return 1;
+	}
+}
+
+/*
+ * Time-source of the time budget of 'iso15765_process_budget'
+ */
+static inline uint32_t budget_now_us(iso15765_t* ih)
+{
+	return ih->clbs.get_us != NULL ? ih->clbs.get_us() : ih->clbs.get_ms() * 1000U;
+}
+
+/*
+ * The work budget of the call is not exhausted
+ */
+static inline uint8_t budget_left(iso15765_t* ih, const n_budget_t* budget, uint32_t t0, uint32_t frames)
+{
+	return (budget->max_frames == 0 || frames < budget->max_frames)
+		&& (budget->max_us == 0 || budget_now_us(ih) - t0 < budget->max_us);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Initialize and check if the configuration parameters of the ISO15765 handler are
+ * correct. Not assigned callback which are not assigned will be automatically assigned
+ * to the static UNUSED functions. If no error occurs, the system can start the service.
+ */
+n_rslt iso15765_init(iso15765_t* instance)
+{
+	if (instance == NULL)
+	{
+		return N_NULL;
+	}
+
+	/* check if parameters have correct values */
+	if ((instance->fr_id_type != CBUS_ID_T_STANDARD && instance->fr_id_type != CBUS_ID_T_EXTENDED)
+		|| (instance->fr_id_type & instance->addr_md) == 0)
+	{
+		return N_WRG_VALUE;
+	}
+#ifdef I15765_ADDR_ONLY
+	/* the codecs are compiled for a single addressing mode */
+	if (instance->addr_md != (addr_md)(I15765_ADDR_ONLY))
+	{
+		return N_WRG_VALUE;
+	}
+#endif
+
+	/* check if must-have functions are assigned */
+	if (instance->clbs.send_frame == NULL || instance->clbs.get_ms == NULL)
+	{
+		return N_MISSING_CLB;
+	}
+
+	/* if optional functions are not assigned then use the defaults */
+	if (instance->clbs.indn == NULL)
+	{
+		instance->clbs.indn = indn;
+	}
+
+	if (instance->clbs.ff_indn == NULL)
+	{
+		instance->clbs.ff_indn = ff_indn;
+	}
+
+	if (instance->clbs.cfm == NULL)
+	{
+		instance->clbs.cfm = cfm;
+	}
+
+	if (instance->clbs.cfg_cfm == NULL)
+	{
+		instance->clbs.cfg_cfm = cfg_cfm;
+	}
+
+	if (instance->clbs.on_error == NULL)
+	{
+		instance->clbs.on_error = on_error;
 	}
 
 	/* clear the in/out streams */
@@ -1023,117 +2149,573 @@ n_rslt iso15765_init(iso15765_t* instance)
 	memset(&instance->out, 0, sizeof(n_iostream_t));
 	memset(&instance->fl_pdu, 0, sizeof(n_pdu_t));
 	/* init the incoming canbus frame queue(buffer) */
+	if (instance->inq_storage == NULL)
+	{
+#if I15765_QUEUE_ELMS > 0
+		instance->inq_storage = instance->inq_buf;
+		instance->inq_elms = I15765_QUEUE_ELMS;
+#else
+		return N_NULL;
+#endif
+	}
+	if (instance->inq_elms == 0 || instance->inq_policy > N_INQ_REJECT)
+	{
+		return N_WRG_VALUE;
+	}
+#ifndef I15765_ATOMIC_CAS
+	/* the producer and the consumer both move the tail with DROP_OLDEST */
+	if (instance->inq_policy == N_INQ_DROP_OLDEST)
+	{
+		return N_WRG_VALUE;
+	}
+#endif
 	if (iqueue_init(&instance->inqueue,
-		I15765_QUEUE_ELMS,
-		sizeof(canbus_frame_t),
-		instance->inq_buf) != I_OK)
+		instance->inq_elms,
+		sizeof(n_inq_slot_t),
+		instance->inq_storage) != I_OK)
 		{
 			return N_INV;
 		}
+	instance->inq_dropped = 0;
+	instance->inq_rejected = 0;
+	instance->tx_frames = 0;
+	/* all the reception buffers are available */
+	if (instance->rx_pool != NULL && instance->rx_pool_elms == 0)
+	{
+		return N_WRG_VALUE;
+	}
+	/* the events reference the received messages: every message needs its
+	* own buffer until the application releases it */
+	if (instance->evtq != NULL && instance->rx_pool == NULL)
+	{
+		return N_WRG_VALUE;
+	}
+	for (uint8_t i = 0; instance->rx_pool != NULL && i < instance->rx_pool_elms; i++)
+	{
+		instance->rx_pool[i].lent = 0;
+	}
+	instance->rx_cur = NULL;
+	instance->rx_starved = 0;
+	instance->proc_busy = 0;
+	instance->tx_kick = 0;
+	/* no parameters are changed per peer */
+	if (instance->peers != NULL && instance->peer_elms == 0)
+	{
+		return N_WRG_VALUE;
+	}
+	for (uint8_t i = 0; instance->peers != NULL && i < instance->peer_elms; i++)
+	{
+		instance->peers[i].used = 0;
+	}
+#ifdef I15765_FRAME_TS
+	if (instance->ts_per_ms == 0)
+	{
+		instance->ts_per_ms = 1000000U;
+	}
+	instance->rx_ts = 0;
+	instance->rx_ms = 0;
+	instance->lat_max = 0;
+	instance->lat_sum = 0;
+	instance->lat_cnt = 0;
+#endif
+
+	instance->init_sts = N_OK;
+	return instance->init_sts;
+}
+
+/*
+ * Enqueues an incoming frame from the lower level (CANBus) to a buffer. The service
+ * will process the frames during the call of the 'iso15765_process' function. Usually
+ * this function should be called when a canbus frame is received.
+ */
+n_rslt iso15765_enqueue(iso15765_t* instance, canbus_frame_t* frame)
+{
+	if (instance == NULL || frame == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (instance->init_sts != N_OK)
+	{
+		return N_ERROR;
+	}
+
+	if (frame->fr_format == CBUS_FR_FRM_STD)
+	{
+		if (frame->dlc == 0 || frame->dlc > 8)
+		{
+			return N_ERROR;
+		}
+	}
+#ifndef I15765_CLASSIC_ONLY
+	else if (frame->fr_format == CBUS_FR_FRM_FD)
+	{
+		if (frame->dlc == 0 ||
+			(frame->dlc > 8 && frame->dlc != 12 && frame->dlc != 16 &&
+			frame->dlc != 20 && frame->dlc != 24 && frame->dlc != 32 &&
+			frame->dlc != 48 && frame->dlc != 64))
+		{
+			return N_ERROR;
+		}
+	}
+#endif
+#ifdef I15765_CANXL
+	else if (frame->fr_format == CBUS_FR_FRM_XL)
+	{
+		if (frame->dlc == 0 || frame->dlc > I15765_MAX_DL)
+		{
+			return N_ERROR;
+		}
+	}
+#endif
+	else 
+	{
+		return N_ERROR;
+	}
+
+	n_inq_slot_t* slot = (n_inq_slot_t*)iqueue_get_next_enqueue(&instance->inqueue);
+
+	if (slot == NULL)
+	{
+		switch (instance->inq_policy)
+		{
+#ifdef I15765_ATOMIC_CAS
+		case N_INQ_DROP_OLDEST:
+		{
+			/* the producer takes the oldest slot over. The tail is only moved
+			* with a CAS (and only while the queue is still full): if the
+			* consumer was copying that slot, its own CAS fails and the copy is
+			* discarded. If the consumer won, a slot is free */
+			uint32_t pos = I15765_ATOMIC_LOAD(&instance->inqueue.tail);
+			if (iqueue_get_next_enqueue(&instance->inqueue) == NULL
+				&& I15765_ATOMIC_CAS(&instance->inqueue.tail, &pos, iqueue_next(&instance->inqueue, pos)))
+			{
+				instance->inq_dropped++;
+			}
+			slot = (n_inq_slot_t*)iqueue_get_next_enqueue(&instance->inqueue);
+			if (slot == NULL)
+			{
+				instance->inq_dropped++;
+				return N_BUFFER_OVFLW;
+			}
+			break;
+		}
+#endif
+		case N_INQ_REJECT:
+			instance->inq_rejected++;
+			return N_RX_BUSY;
+		default:
+			instance->inq_dropped++;
+			return N_BUFFER_OVFLW;
+		}
+	}
+
+#ifdef I15765_CLASSIC_ONLY
+	/* store only the classic part of the frame */
+	slot->id = frame->id;
+	slot->id_type = (uint8_t)frame->id_type;
+	slot->dlc = (uint8_t)frame->dlc;
+	slot->rsv[0] = 0;
+	slot->rsv[1] = 0;
+	memmove(slot->dt, frame->dt, frame->dlc);
+#elif defined(I15765_CANXL)
+	/* only the used part of the (large) slot is written */
+	memmove(slot, frame, offsetof(canbus_frame_t, dt) + frame->dlc);
+#else
+	memmove(slot, frame, sizeof(canbus_frame_t));
+#endif
+#ifdef I15765_FRAME_TS
+	/* frames without a driver timestamp are stamped on arrival in the queue */
+	slot->ts = frame->ts != 0 ? frame->ts : ts_now(instance);
+#endif
+	iqueue_advance_next(&instance->inqueue);
+	return N_OK;
+}
+
+/*
+ * Decode a CANBus frame to a PDU with the codecs of the engine (address
+ * information, PCI and payload). It does not affect any handler and can be
+ * used to analyze recorded traffic.
+ */
+n_rslt iso15765_frame_decode(addr_md address, const canbus_frame_t* frame, n_pdu_t* pdu)
+{
+	if (frame == NULL || pdu == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (frame->dlc == 0 || frame->dlc > sizeof(frame->dt))
+	{
+		return N_INV_PDU;
+	}
+
+	/* N_AE is not part of every addressing mode */
+	memset(&pdu->n_ai, 0, sizeof(n_ai_t));
+	return n_pdu_unpack(address, pdu, frame->id, (cbus_dl_t)frame->dlc, (uint8_t*)frame->dt) == N_OK
+		? N_OK : N_INV_PDU;
+}
+
+/*
+ * Request to send a message. Depending on the message a call to 'iso15765_process'
+ * may be required. The service can send one message per time as long as the
+ * communication is syncronous
+ */
+n_rslt iso15765_send(iso15765_t* instance, n_req_t* frame)
+{
+	return iso15765_send_prio(instance, frame, I15765_PRIO_DEFAULT);
+}
+
+/*
+ * Request to send a message with a priority (0: highest). If a TX queue is
+ * assigned and a transmission is in progress, the request is queued and will
+ * be started by 'iso15765_process'. Otherwise behaves as 'iso15765_send'.
+ */
+n_rslt iso15765_send_prio(iso15765_t* instance, n_req_t* frame, uint8_t prio)
+{
+	if (instance == NULL || frame == NULL)
+	{
+		return N_NULL;
+	}
+
+#ifdef I15765_RX_ONLY
+	ISO_15675_UNUSED(prio);
+	return N_INV;
+#else
+	n_rslt rslt = check_send_request(instance, frame->fr_fmt, &frame->n_ai, frame->msg_sz);
+	if (rslt != N_OK)
+	{
+		return rslt;
+	}
+
+	if (instance->out.sts == N_S_IDLE && (instance->txq == NULL || instance->txq->cnt == 0))
+	{
+		start_send_req(instance, frame, prio, NULL);
+		return N_OK;
+	}
+
+	if (instance->txq == NULL)
+	{
+		return N_TX_BUSY;
+	}
+
+	return txq_insert(instance->txq, frame, prio, NULL);
+#endif
+}
+
+/*
+ * Initialize a TX queue using the caller provided storage. The queue has to be
+ * assigned to the 'txq' of the handler.
+ */
+n_rslt iso15765_txq_init(n_txq_t* queue, n_txq_elm_t* storage, uint8_t elms)
+{
+	if (queue == NULL || storage == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (elms == 0)
+	{
+		return N_WRG_VALUE;
+	}
+
+	memset(storage, 0, elms * sizeof(n_txq_elm_t));
+	queue->buf = storage;
+	queue->elms = elms;
+	queue->cnt = 0;
+	queue->preempted = 0;
+	return N_OK;
+}
+
+#ifdef I15765_ATOMIC_CAS
+/*
+ * Initialize a submission queue using the caller provided storage. The number
+ * of elements must be a power of two. The queue has to be assigned to the
+ * 'subq' of the handler.
+ */
+n_rslt iso15765_subq_init(n_subq_t* queue, n_subq_elm_t* storage, uint32_t elms)
+{
+	if (queue == NULL || storage == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (elms == 0 || (elms & (elms - 1U)) != 0)
+	{
+		return N_WRG_VALUE;
+	}
+
+	memset(storage, 0, elms * sizeof(n_subq_elm_t));
+	for (uint32_t i = 0; i < elms; i++)
+	{
+		storage[i].seq = i;
+	}
+	queue->buf = storage;
+	queue->mask = elms - 1U;
+	queue->tail = 0;
+	I15765_ATOMIC_STORE(&queue->head, 0U);
+	return N_OK;
+}
+
+/*
+ * Submit a request from any thread (lock-free, many producers). The request is
+ * started by 'iso15765_process'. The request and the token must stay valid until
+ * the token is completed; the token can be NULL (no completion tracking).
+ */
+n_rslt iso15765_submit(iso15765_t* instance, n_req_t* frame, uint8_t prio, n_token_t* tok)
+{
+	if (instance == NULL || frame == NULL)
+	{
+		return N_NULL;
+	}
+
+#ifdef I15765_RX_ONLY
+	ISO_15675_UNUSED(prio);
+	ISO_15675_UNUSED(tok);
+	return N_INV;
+#else
+	if (instance->subq == NULL)
+	{
+		return N_INV;
+	}
+
+	n_rslt rslt = check_send_request(instance, frame->fr_fmt, &frame->n_ai, frame->msg_sz);
+	if (rslt != N_OK)
+	{
+		return rslt;
+	}
+
+	n_subq_t* q = instance->subq;
+	uint32_t pos = I15765_ATOMIC_LOAD(&q->head);
+	n_subq_elm_t* elm;
+
+	/* claim a slot: its sequence equals the position while it is free */
+	for (;;)
+	{
+		elm = &q->buf[pos & q->mask];
+		int32_t dif = (int32_t)(I15765_ATOMIC_LOAD(&elm->seq) - pos);
+
+		if (dif == 0)
+		{
+			if (I15765_ATOMIC_CAS(&q->head, &pos, pos + 1U))
+			{
+				break;
+			}
+		}
+		else if (dif < 0)
+		{
+			return N_BUFFER_OVFLW;
+		}
+		pos = I15765_ATOMIC_LOAD(&q->head);
+	}
 
-	ISO_15675_UNUSED(sgn_chg_cfm);
+	if (tok != NULL)
+	{
+		tok->rslt = N_OK;
+		tok->sts = N_TOK_PENDING;
+	}
+	elm->req = frame;
+	elm->prio = prio;
+	elm->tok = tok;
+	/* publish the slot to the consumer */
+	I15765_ATOMIC_STORE(&elm->seq, pos + 1U);
+	return N_OK;
+#endif
+}
 
-	instance->init_sts = N_OK;
-	return instance->init_sts;
+/*
+ * Check the completion of a submitted request. Returns N_TX_BUSY while it is
+ * pending, else the result of the transmission.
+ */
+n_rslt iso15765_token_poll(n_token_t* tok)
+{
+	if (tok == NULL)
+	{
+		return N_NULL;
+	}
+
+	switch (I15765_ATOMIC_LOAD(&tok->sts))
+	{
+	case N_TOK_PENDING:
+		return N_TX_BUSY;
+	case N_TOK_DONE:
+		return tok->rslt;
+	default:
+		return N_IDLE;
+	}
 }
+#endif
 
 /*
- * Enqueues an incoming frame from the lower level (CANBus) to a buffer. The service
- * will process the frames during the call of the 'iso15765_process' function. Usually
- * this function should be called when a canbus frame is received.
+ * Request to send a message of which the data are not yet available (streamed
+ * transmission, e.g. cut-through forwarding). The data are appended afterwards
+ * using 'iso15765_send_push' and the frames are sent as soon as their payload
+ * is available.
  */
-n_rslt iso15765_enqueue(iso15765_t* instance, canbus_frame_t* frame)
+n_rslt iso15765_send_begin(iso15765_t* instance, cbus_fr_format fr_fmt, const n_ai_t* n_ai, uint16_t msg_sz)
 {
-	if (instance == NULL || frame == NULL)
+	if (instance == NULL || n_ai == NULL)
 	{
 		return N_NULL;
 	}
 
-	if (instance->init_sts != N_OK)
+#ifdef I15765_RX_ONLY
+	ISO_15675_UNUSED(fr_fmt);
+	ISO_15675_UNUSED(msg_sz);
+	return N_INV;
+#else
+	if (instance->out.sts != N_S_IDLE)
 	{
-		return N_ERROR;
+		return N_TX_BUSY;
 	}
 
-	if (frame->fr_format == CBUS_FR_FRM_STD)
+	n_rslt rslt = check_send_request(instance, fr_fmt, n_ai, msg_sz);
+	if (rslt != N_OK)
 	{
-		if (frame->dlc == 0 || frame->dlc > 8)
-		{
-			return N_ERROR;
-		}
+		return rslt;
 	}
-	else if (frame->fr_format == CBUS_FR_FRM_FD)
+
+	instance->out.msg_avl = 0;
+	instance->out.prio = I15765_PRIO_DEFAULT;
+	start_send(instance, fr_fmt, n_ai, msg_sz);
+	return N_OK;
+#endif
+}
+
+/*
+ * Append data to a streamed transmission started with 'iso15765_send_begin'
+ */
+n_rslt iso15765_send_push(iso15765_t* instance, const uint8_t* dt, uint16_t sz)
+{
+	if (instance == NULL || dt == NULL)
 	{
-		if (frame->dlc == 0 ||
-			(frame->dlc > 8 && frame->dlc != 12 && frame->dlc != 16 &&
-			frame->dlc != 20 && frame->dlc != 24 && frame->dlc != 32 &&
-			frame->dlc != 48 && frame->dlc != 64))
-		{
-			return N_ERROR;
-		}
+		return N_NULL;
 	}
-	else 
+
+	if (instance->out.sts == N_S_IDLE)
 	{
-		return N_ERROR;
+		return N_INV;
 	}
 
+	if (sz > instance->out.msg_sz - instance->out.msg_avl)
+	{
+		return N_BUFFER_OVFLW;
+	}
 
-	return iqueue_enqueue(&instance->inqueue, frame) == I_OK
-		? N_OK : N_BUFFER_OVFLW;
+	memmove(&instance->out.msg[instance->out.msg_avl], dt, sz);
+	instance->out.msg_avl += sz;
+	return N_OK;
 }
 
 /*
- * Request to send a message. Depending on the message a call to 'iso15765_process'
- * may be required. The service can send one message per time as long as the
- * communication is syncronous
+ * Abort the transmission in progress (if any) and confirm it with N_ERROR
  */
-n_rslt iso15765_send(iso15765_t* instance, n_req_t* frame)
+n_rslt iso15765_send_abort(iso15765_t* instance)
 {
 	if (instance == NULL)
 	{
 		return N_NULL;
 	}
 
-	if (instance->init_sts != N_OK)
+	if (instance->out.sts == N_S_IDLE)
 	{
-		return N_ERROR;
+		return N_IDLE;
 	}
 
-	/* Make sure that there is no transmission in progress */
-	if (instance->out.sts != N_S_IDLE)
+	set_stream_data(&instance->out, 0, 0, N_S_IDLE);
+	signaling(instance, N_CONF, &instance->out, (void*)instance->clbs.cfm, 0, N_ERROR);
+	tx_token_done(instance, N_ERROR);
+	return N_OK;
+}
+
+/*
+ * Send the held FlowControl of the reception (see 'fc_hold') using the given
+ * BlockSize and SeparationTime.
+ */
+n_rslt iso15765_fc_release(iso15765_t* instance, uint8_t bs, uint8_t stmin)
+{
+	if (instance == NULL)
 	{
-		return N_TX_BUSY;
+		return N_NULL;
 	}
-	/* and the requested size is fitting in our outbound buffer */
-	if (frame->msg_sz > I15765_MSG_SIZE)
+
+#ifdef I15765_TX_ONLY
+	ISO_15675_UNUSED(bs);
+	ISO_15675_UNUSED(stmin);
+	return N_IDLE;
+#else
+	if (instance->in.fc_pend == N_FC_NONE)
 	{
-		return N_BUFFER_OVFLW;
+		return N_IDLE;
 	}
-	/* or there is not actual message to be sent */
-	if (frame->msg_sz == 0)
+	/* a deferred FlowControl was already released, it is sent unchanged */
+	if (instance->in.fc_pend == N_FC_HELD)
 	{
-		return N_INV_REQ_SZ;
+		instance->fc.bs = bs;
+		instance->fc.st = stmin;
 	}
-	/* check if frame type is correct */
-	if (frame->fr_fmt != CBUS_FR_FRM_STD && frame->fr_fmt != CBUS_FR_FRM_FD)
+	return send_N_PCI_T_FC(instance);
+#endif
+}
+
+/*
+ * N_ChangeParameter.request: change the BlockSize or the SeparationTimeMin of
+ * the FlowControl frames of the handler (N_CHG_SESSION) or of the receptions
+ * from a peer (N_CHG_PEER) at runtime. The N_ChangeParameter.confirm is fired
+ * through 'cfg_cfm' or the event queue before the function returns.
+ */
+n_rslt iso15765_change_param(iso15765_t* instance, n_chg_param_req_t* req)
+{
+	if (instance == NULL || req == NULL)
 	{
-		return N_INV;
+		return N_NULL;
 	}
-	/* check if Target Address Type is correct */
-	if (frame->n_ai.n_tt != N_TA_T_PHY && frame->n_ai.n_tt != N_TA_T_FUNC)
+
+	if (instance->init_sts != N_OK)
 	{
-		return N_INV;
+		return N_ERROR;
 	}
 
-	/* copy all the info and data to the outbound buffer */
-	instance->out.fr_fmt = frame->fr_fmt;
-	instance->out.msg_sz = frame->msg_sz;
-	memmove(instance->out.msg, frame->msg, frame->msg_sz);
-	memmove(&instance->out.pdu.n_ai, &frame->n_ai, sizeof(n_ai_t));
-	instance->out.sn_glb = 1;
-	instance->out.cf_cnt = 0;
-	instance->out.wf_cnt = 0;
-	instance->out.sts = N_S_TX_BUSY;
+	n_rslt rslt = change_param(instance, req);
+
+	if (instance->evtq != NULL)
+	{
+		evtq_push(instance->evtq, N_CHG_P_CONF, (cbus_fr_format)0, &req->n_ai, NULL, 0, rslt, 0, 0);
+		return rslt;
+	}
+	memmove(&sgn_chg_cfm.n_ai, &req->n_ai, sizeof(n_ai_t));
+	memmove(&sgn_chg_cfm.n_pci, &req->n_pci, sizeof(n_pci_t));
+	sgn_chg_cfm.param = req->param;
+	sgn_chg_cfm.pval = req->pval;
+	sgn_chg_cfm.rslt = rslt;
+	instance->clbs.cfg_cfm(&sgn_chg_cfm);
+	return rslt;
+}
+
+/*
+ * Initialize a bus-load limiter. The bucket starts full. The limiter has to be
+ * assigned to the 'rate' of the handler (it can be shared by several handlers
+ * of the same thread to cap their total bus load).
+ */
+n_rslt iso15765_rate_init(n_rate_t* limiter, n_rate_unit unit, uint32_t rate, uint32_t burst)
+{
+	if (limiter == NULL)
+	{
+		return N_NULL;
+	}
+
+	if ((unit != N_RATE_FRAMES && unit != N_RATE_BITS) || rate == 0 || burst == 0)
+	{
+		return N_WRG_VALUE;
+	}
 
+	limiter->unit = unit;
+	limiter->rate = rate;
+	limiter->burst = burst;
+	limiter->tokens = burst;
+	limiter->rem = 0;
+	limiter->last_ms = 0;
+	limiter->sync = 0;
+	limiter->denied = 0;
 	return N_OK;
 }
 
@@ -1154,21 +2736,316 @@ n_rslt iso15765_process(iso15765_t* instance)
 		return N_ERROR;
 	}
 
-	/* First check if a timeout is occured. Only for the inbound stream */
-	n_rslt rslt = process_timeouts(instance);
+	n_rslt rslt = N_OK;
 	canbus_frame_t frame;
 
+	/* TX completions signaled from now on are handled at the end. If one holds
+	* the outbound stream (on another core), the call is skipped */
+	if (proc_take(instance) == 0)
+	{
+		return N_TX_BUSY;
+	}
+
 	/* Dequeue all the incoming frames and process them */
-	while (iqueue_dequeue(&instance->inqueue, &frame) != I_EMPTY)
+	while (inq_pop(instance, &frame) != 0)
 	{
 		rslt |= iso15765_process_in(instance, &frame);
 	}
 
-	/* Process the outbound stream */
+#ifndef I15765_RX_ONLY
+	/* Check if a timeout is occured, after the queued frames were taken into account */
+	rslt |= process_timeouts(instance, instance->clbs.get_ms());
+#endif
+
+#ifndef I15765_TX_ONLY
+	/* Retry a FlowControl which was deferred by the bus-load limiter or the driver */
+	if (instance->in.fc_pend == N_FC_DEFERRED)
+	{
+		send_N_PCI_T_FC(instance);
+	}
+#endif
+
+#ifndef I15765_RX_ONLY
+#ifdef I15765_ATOMIC_CAS
+	/* Take the requests submitted by other threads */
+	if (instance->subq != NULL)
+	{
+		process_subq(instance);
+	}
+#endif
+
+	/* Process the outbound stream, one frame per call */
 	rslt |= iso15765_process_out(instance);
+
+	/* and the pending requests */
+	if (instance->txq != NULL)
+	{
+		rslt |= process_txq(instance);
+	}
+
+	/* a TX completion during the process: the TX buffer has room again */
+	rslt |= proc_release(instance);
+#else
+	instance->proc_busy = 0;
+#endif
+	return rslt;
+}
+
+/*
+ * Budgeted variant of 'iso15765_process' for cooperative schedulers running
+ * many handlers: a call processes at most 'max_frames' frames and returns
+ * after 'max_us'. The received frames and the frames of the outbound stream
+ * are interleaved one by one, so a burst of received frames does not delay
+ * the CFs of the handler. The submitted requests are taken once per call and
+ * the timeouts of the outbound stream are checked only once the reception
+ * queue is drained (the awaited FlowControl may still be queued). The work
+ * left is reported in the budget: call again while 'rx_left' or 'tx_left'.
+ */
+n_rslt iso15765_process_budget(iso15765_t* instance, n_budget_t* budget)
+{
+	if (instance == NULL || budget == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (instance->init_sts != N_OK)
+	{
+		return N_ERROR;
+	}
+
+	n_rslt rslt = N_OK;
+	canbus_frame_t frame;
+	uint32_t t0 = budget->max_us != 0 ? budget_now_us(instance) : 0;
+	uint32_t frames = 0;
+	uint8_t rx_more = 1;
+	uint8_t tx_more = 1;
+	size_t rx_left = 0;
+
+	budget->rx_frames = 0;
+	budget->tx_frames = 0;
+
+	/* a TX completion (on another core) holds the outbound stream: the call is
+	* skipped and all the work is left */
+	if (proc_take(instance) == 0)
+	{
+		iqueue_size(&instance->inqueue, &rx_left);
+		budget->rx_left = (uint16_t)rx_left;
+		budget->tx_left = 1;
+		return N_TX_BUSY;
+	}
+
+#if !defined(I15765_RX_ONLY) && defined(I15765_ATOMIC_CAS)
+	/* Take the requests submitted by other threads */
+	if (instance->subq != NULL)
+	{
+		process_subq(instance);
+	}
+#endif
+
+	while ((rx_more != 0 || tx_more != 0) && budget_left(instance, budget, t0, frames))
+	{
+		/* one received frame */
+		rx_more = inq_pop(instance, &frame);
+		if (rx_more != 0)
+		{
+			rslt |= iso15765_process_in(instance, &frame);
+			budget->rx_frames++;
+			frames++;
+		}
+
+#ifndef I15765_RX_ONLY
+		if (budget->max_frames != 0 && frames >= budget->max_frames)
+		{
+			break;
+		}
+
+		/* one frame of the outbound stream, then the next pending request.
+		* Only the frames taken by the driver are counted */
+		uint16_t msg_pos = instance->out.msg_pos;
+		stream_sts sts = instance->out.sts;
+		uint32_t sent = instance->tx_frames;
+
+		instance->tx_kick = 0;
+		rslt |= iso15765_process_out(instance);
+		tx_more = instance->out.msg_pos != msg_pos || instance->out.sts != sts;
+
+		if (instance->txq != NULL)
+		{
+			uint8_t cnt = instance->txq->cnt;
+
+			rslt |= process_txq(instance);
+			tx_more |= instance->txq->cnt != cnt;
+		}
+		sent = instance->tx_frames - sent;
+		budget->tx_frames = (uint16_t)(budget->tx_frames + sent);
+		frames += sent;
+		/* a TX completion during the process: the TX buffer has room again */
+		tx_more |= instance->tx_kick;
+#else
+		tx_more = 0;
+#endif
+	}
+
+	iqueue_size(&instance->inqueue, &rx_left);
+	budget->rx_left = (uint16_t)rx_left;
+
+#ifndef I15765_RX_ONLY
+	/* Check if a timeout is occured on every call, also when the budget left
+	* frames in the queue (a stream would not time out under a sustained load) */
+	rslt |= process_timeouts(instance, instance->clbs.get_ms());
+#endif
+
+#ifndef I15765_TX_ONLY
+	/* Retry a FlowControl which was deferred by the bus-load limiter or the driver */
+	if (instance->in.fc_pend == N_FC_DEFERRED)
+	{
+		send_N_PCI_T_FC(instance);
+	}
+#endif
+
+#ifndef I15765_RX_ONLY
+	/* a TX completion after the last check of 'tx_kick' would be lost: 'proc_busy'
+	* is cleared first, then 'tx_kick' is checked again within the budget */
+	for (;;)
+	{
+		instance->proc_busy = 0;
+		I15765_MEMORY_BARRIER();
+		if (instance->tx_kick == 0 || budget_left(instance, budget, t0, frames) == 0
+			|| proc_take(instance) == 0)
+		{
+			break;
+		}
+		instance->tx_kick = 0;
+
+		uint32_t sent = instance->tx_frames;
+		rslt |= iso15765_process_out(instance);
+		sent = instance->tx_frames - sent;
+		budget->tx_frames = (uint16_t)(budget->tx_frames + sent);
+		frames += sent;
+	}
+	/* a completion left for the next call is reported as work left */
+	budget->tx_left = instance->out.sts == N_S_TX_BUSY || instance->out.sts == N_S_TX_READY
+		|| (instance->txq != NULL && instance->txq->cnt != 0) || instance->tx_kick != 0;
+#else
+	instance->proc_busy = 0;
+	budget->tx_left = 0;
+#endif
 	return rslt;
 }
 
+/*
+ * TX-done notification of the driver (e.g. the TX complete interrupt of the
+ * controller). The outbound stream continues at once, so with STmin 0 the TX
+ * buffer is refilled without waiting for the next 'iso15765_process'. If it
+ * interrupts 'iso15765_process' (or itself, from 'send_frame'), the frames are
+ * sent when the running call ends (N_TX_BUSY). It must not interrupt the
+ * send/abort services of the handler.
+ */
+n_rslt iso15765_tx_complete(iso15765_t* instance)
+{
+	if (instance == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (instance->init_sts != N_OK)
+	{
+		return N_ERROR;
+	}
+
+#ifdef I15765_RX_ONLY
+	/* only FlowControls are sent, which never wait for the TX buffer */
+	return N_OK;
+#else
+	/* the kick is signaled before the stream is taken: a running process
+	* which ends meanwhile checks it again after clearing 'proc_busy' */
+	instance->tx_kick = 1;
+	I15765_MEMORY_BARRIER();
+	if (proc_take(instance) == 0)
+	{
+		return N_TX_BUSY;
+	}
+	return proc_release(instance);
+#endif
+}
+
+/*
+ * Return a reception buffer lent with an indication ('n_indn_t.buf' or the
+ * 'msg' of the event) to the pool. May be called from another thread.
+ */
+n_rslt iso15765_rx_release(iso15765_t* instance, const uint8_t* msg)
+{
+	if (instance == NULL || msg == NULL)
+	{
+		return N_NULL;
+	}
+
+	for (uint8_t i = 0; instance->rx_pool != NULL && i < instance->rx_pool_elms; i++)
+	{
+		n_rxbuf_t* b = &instance->rx_pool[i];
+		if (b->msg == msg && b->lent != 0)
+		{
+			/* the application accesses to the buffer are completed */
+			I15765_MEMORY_BARRIER();
+			b->lent = 0;
+			return N_OK;
+		}
+	}
+	return N_WRG_VALUE;
+}
+
+/*
+ * Initialize an event queue using the caller provided storage. The number of
+ * elements must be a power of two. The queue has to be assigned to the 'evtq'
+ * of the handler before calling 'iso15765_init'.
+ */
+n_rslt iso15765_evtq_init(n_evtq_t* queue, n_evt_t* storage, uint16_t elms)
+{
+	if (queue == NULL || storage == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (elms == 0 || (elms & (elms - 1U)) != 0)
+	{
+		return N_WRG_VALUE;
+	}
+
+	memset(storage, 0, elms * sizeof(n_evt_t));
+	queue->buf = storage;
+	queue->mask = (uint16_t)(elms - 1U);
+	queue->head = 0;
+	queue->tail = 0;
+	queue->lost = 0;
+	return N_OK;
+}
+
+/*
+ * Dequeue the oldest event of the queue. This function can be called from a
+ * different thread than the one calling 'iso15765_process' (one consumer only).
+ * Returns N_IDLE if there are no pending events.
+ */
+n_rslt iso15765_evtq_pop(n_evtq_t* queue, n_evt_t* evt)
+{
+	if (queue == NULL || evt == NULL)
+	{
+		return N_NULL;
+	}
+
+	uint16_t tail = queue->tail;
+
+	if (tail == queue->head)
+	{
+		return N_IDLE;
+	}
+
+	I15765_MEMORY_BARRIER();
+	memmove(evt, &queue->buf[tail & queue->mask], sizeof(n_evt_t));
+	I15765_MEMORY_BARRIER();
+	queue->tail = (uint16_t)(tail + 1U);
+	return N_OK;
+}
+
 /******************************************************************************
 * EOF - NO CODE AFTER THIS LINE
 ******************************************************************************/
@@ -33,10 +33,58 @@ a separate license is required. Contact:
 #ifndef DEVCOONS_ISO15765_2_H_
 #define DEVCOONS_ISO15765_2_H_
 
+#ifndef I15765_MSG_SIZE
 #define I15765_MSG_SIZE		516	/* Max. size of the TP up to 4095 bytes */
+#endif
+
+#ifndef I15765_QUEUE_ELMS
+#define I15765_QUEUE_ELMS	64	/* No. of max incoming frames that the internal
+					 * reception buffer can hold. 0: no internal buffer,
+					 * the storage is always provided by the caller */
+#endif
+
+/* #define I15765_CLASSIC_ONLY */	/* Classic CAN only: the reception buffer holds
+					 * compact 16 bytes frames and CAN FD is rejected */
+
+/* #define I15765_CANXL */		/* CAN XL frames (up to 2048 bytes) as a third frame format.
+					 * The frame buffers grow to 2048 bytes and the CAN DL of the
+					 * 'send_frame' callback to 16 bits ('cbus_dl_t') */
+
+/* #define I15765_FRAME_TS */		/* The frames carry their arrival time, which is used by
+					 * the protocol timers and the latency statistics */
+
+/* #define I15765_DIGEST */		/* CRC-32/CRC-32C of every message ('digest' of the handler),
+					 * updated while its frames are copied and reported with the
+					 * indications and confirmations */
+
+/* #define I15765_CRC_SMALL */		/* The software CRCs use a 1 KB table per polynomial instead
+					 * of the 8 KB slice-by-8 tables */
+
+/* #define I15765_RX_ONLY */		/* Reception only: the TX state machine is not compiled,
+					 * the transmission services return N_INV */
 
-#define I15765_QUEUE_ELMS	64	/* No. of max incoming frames that the
-					 * reception buffer can hold */
+/* #define I15765_TX_ONLY */		/* Transmission only: the RX state machine is not compiled,
+					 * the received SF/FF/CF are ignored */
+
+/* #define I15765_ADDR_ONLY 0x14 */	/* Single addressing mode (the value of an 'addr_md'): the
+					 * codecs are specialized and other modes are rejected */
+
+#if defined(I15765_RX_ONLY) && defined(I15765_TX_ONLY)
+#error "I15765_RX_ONLY and I15765_TX_ONLY cannot be used together"
+#endif
+
+#if defined(I15765_CANXL) && defined(I15765_CLASSIC_ONLY)
+#error "I15765_CANXL and I15765_CLASSIC_ONLY cannot be used together"
+#endif
+
+#ifdef I15765_CANXL
+#define I15765_MAX_DL		2048	/* Max. CAN DL of a frame (CAN XL) */
+#else
+#define I15765_MAX_DL		64	/* Max. CAN DL of a frame (CAN FD) */
+#endif
+
+#define I15765_PRIO_DEFAULT	0x80	/* Priority of the requests of 'iso15765_send' when
+					 * a TX queue is assigned (0: highest) */
 
 /* Alignment is required for Microcontrollers */
 #if defined(__clang__)
@@ -47,6 +95,32 @@ a separate license is required. Contact:
 	#define ALIGNMENT __declspec(align(4))
 #endif
 
+/* Memory barrier used by the lock-free event queue. Can be overridden by the
+ * user for compilers/targets which are not covered below */
+#ifndef I15765_MEMORY_BARRIER
+	#if defined(__clang__) || defined(__GNUC__) || defined(__GNUG__)
+		#define I15765_MEMORY_BARRIER() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+	#elif defined(_MSC_VER)
+		#define I15765_MEMORY_BARRIER() _ReadWriteBarrier()
+	#else
+		#define I15765_MEMORY_BARRIER()
+	#endif
+#endif
+
+/* Atomic operations used by the multi-producer submission queue. The queue is
+ * not available if the compiler is not covered below (or I15765_NO_ATOMICS) */
+#if !defined(I15765_NO_ATOMICS) && !defined(I15765_ATOMIC_CAS)
+	#if defined(__clang__) || defined(__GNUC__) || defined(__GNUG__)
+		#define I15765_ATOMIC_LOAD(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+		#define I15765_ATOMIC_STORE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+		#define I15765_ATOMIC_CAS(p, e, d)	__atomic_compare_exchange_n((p), (e), (d), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+	#elif defined(_MSC_VER)
+		#define I15765_ATOMIC_LOAD(p)		(*(p))
+		#define I15765_ATOMIC_STORE(p, v)	do { _ReadWriteBarrier(); *(p) = (v); } while (0)
+		#define I15765_ATOMIC_CAS(p, e, d)	(_InterlockedCompareExchange((volatile long*)(p), (long)(d), (long)*(e)) == (long)*(e))
+	#endif
+#endif
+
 #ifndef ISO_15675_UNUSED
 	#define ISO_15675_UNUSED(x) ((void)(x))
 #endif
@@ -70,10 +144,19 @@ a separate license is required. Contact:
 typedef enum
 {
 	CBUS_FR_FRM_STD = 0x01,		/* Standard CANBUS */
-	CBUS_FR_FRM_FD  = 0x02		/* FD CANBUS       */
+	CBUS_FR_FRM_FD  = 0x02,		/* FD CANBUS       */
+	CBUS_FR_FRM_XL  = 0x03		/* XL CANBUS (I15765_CANXL) */
 }cbus_fr_format;
 #endif
 
+/* --- CANBus Frame Data Length -------------------------------------------- */
+
+#ifdef I15765_CANXL
+typedef uint16_t cbus_dl_t;	/* CAN DL up to 2048 (CAN XL) */
+#else
+typedef uint8_t cbus_dl_t;	/* CAN DL up to 64 (CAN FD) */
+#endif
+
 /* --- CANBus Mode [ID Type] (ref: iso15765-2 p.8) -------==---------------- */
 
 #ifndef CBUS_ID_TYPE
@@ -85,6 +168,15 @@ typedef enum
 }cbus_id_type;
 #endif
 
+/* --- CANBus bit timing (bus-load model) ---------------------------------- */
+
+typedef struct
+{
+	uint32_t nbr;		/* Nominal (arbitration phase) bitrate in bit/s */
+	uint32_t dbr;		/* Data phase bitrate of CAN FD/XL frames in bit/s
+				 * (0: no bitrate switch, the nominal bitrate is used) */
+}n_bus_cfg_t;
+
 /* --- CANBus Frame (ref: iso15765-2 p.) ----------------------------------- */
 
 #ifndef CANBUS_FRAME
@@ -95,10 +187,34 @@ typedef struct
 	uint32_t id_type;	/* CAN Frame Id Type `cbus_id_type` */
 	uint16_t fr_format;	/* CAN Frame Format `cbus_fr_format` */
 	uint16_t dlc;		/* Size of data */
-	uint8_t dt[64];		/* Actual data of the frame */
+	uint8_t dt[I15765_MAX_DL];	/* Actual data of the frame */
+#ifdef I15765_FRAME_TS
+	uint64_t ts;		/* Arrival time (driver/hardware timestamp) in the time-base
+				 * of 'get_ts'. 0: stamped by 'iso15765_enqueue' */
+#endif
 }canbus_frame_t;
 #endif
 
+/* --- Compact classic CAN frame (reception buffer slot) ------------------- */
+
+typedef struct
+{
+	uint32_t id;		/* CAN Frame Id */
+	uint8_t id_type;	/* CAN Frame Id Type `cbus_id_type` */
+	uint8_t dlc;		/* Size of data (up to 8) */
+	uint8_t rsv[2];		/* Reserved (padding) */
+	uint8_t dt[8];		/* Actual data of the frame */
+#ifdef I15765_FRAME_TS
+	uint64_t ts;		/* Arrival time */
+#endif
+}n_cframe_t;
+
+#ifdef I15765_CLASSIC_ONLY
+typedef n_cframe_t n_inq_slot_t;
+#else
+typedef canbus_frame_t n_inq_slot_t;
+#endif
+
 /* --- CANTP Addressing Mode (ref: iso15765-2 p.28) ------------------------ */
 
 typedef enum
@@ -149,6 +265,14 @@ typedef enum
 				 * to continue transmission of the following N_PDUs */
 }fl_param;
 
+/* --- Scope of a N_ChangeParameter request -------------------------------- */
+
+typedef enum
+{
+	N_CHG_SESSION = 0x00U,	/* All the receptions of the handler ('config') */
+	N_CHG_PEER = 0x01U	/* Only the receptions from the peer of 'n_ai' ('peers') */
+}n_chg_scope;
+
 /* --- N rslts (ref: iso15765-2 p.10-11) ----------------------------------- */
 
 typedef enum
@@ -210,6 +334,15 @@ typedef enum
 				 * bytes that can be stored in the buffer of the receiver entity */
 }flow_sts;
 
+/* --- Pending FlowControl of the reception -------------------------------- */
+
+typedef enum
+{
+	N_FC_NONE     = 0x00U,	/* no FlowControl is pending */
+	N_FC_HELD     = 0x01U,	/* held until 'iso15765_fc_release' (fc_hold), which sets BS/STmin */
+	N_FC_DEFERRED = 0x02U	/* deferred by the bus-load limiter or the driver, sent again unchanged */
+}fc_pend_sts;
+
 /* --- dt I/O Stream Status (ref: iso15765-2 p.8) ------------------------ */
 
 typedef enum
@@ -270,7 +403,7 @@ typedef struct ALIGNMENT
 	uint16_t sz;	/* Actual data size */
 	n_ai_t n_ai;	/* Address information */
 	n_pci_t n_pci;	/* Protocol control information */
-	uint8_t dt[64];	/* Data Field */
+	uint8_t dt[I15765_MAX_DL];	/* Data Field */
 } n_pdu_t;
 
 /* --- N_USdt.cfm (ref: iso15765-2 p.6) ------------------------------------ */
@@ -280,6 +413,9 @@ typedef struct ALIGNMENT
 	n_ai_t n_ai;	/* Address information */
 	n_pci_t n_pci;	/* Protocol control information */
 	n_rslt rslt;	/* Result of the request */
+#ifdef I15765_DIGEST
+	uint32_t crc;	/* Digest of the transmitted message (of the bytes sent if it failed) */
+#endif
 }n_cfm_t;
 
 /* --- N_FF.indn (ref: iso15765-2 p.6) ------------------------------------ */
@@ -312,28 +448,37 @@ typedef struct ALIGNMENT
 	n_pci_t n_pci;			/* Protocol control information */
 	n_rslt rslt;			/* Result of the reception */
 	uint16_t msg_sz;		/* Received message actual size */
+	uint8_t* buf;			/* Reception pool only: the message is lent in this buffer
+					 * (not copied to 'msg') until 'iso15765_rx_release' */
+#ifdef I15765_FRAME_TS
+	uint64_t ts;			/* Arrival time of the frame which completed the message */
+#endif
+#ifdef I15765_DIGEST
+	uint32_t crc;			/* Digest of the received message (of the bytes received
+					 * if it failed) */
+#endif
 	uint8_t msg[I15765_MSG_SIZE];	/* Received message data */
 }n_indn_t;
 
 typedef struct ALIGNMENT
 {
-	n_ai_t n_ai;		/* Address information. Not supported:
-				 * the lib handles only 1 stream */
-	n_pci_t n_pci;		/* Protocol control information. Not supported:
-				 * the lib handles only 1 stream) */
+	n_ai_t n_ai;		/* Address information of the receptions from the peer, as
+				 * in their indications (N_CHG_PEER only) */
+	n_pci_t n_pci;		/* Protocol control information. Not used */
 	fl_param param;		/* Parameter to change */
 	uint8_t pval;		/* Value to set */
+	n_chg_scope scope;	/* Receptions affected by the change */
 }n_chg_param_req_t;
 
 typedef struct ALIGNMENT
 {
-	n_ai_t n_ai;		/* Address information. Not supported:
-				 * the lib handles only 1 stream */
-	n_pci_t n_pci;		/* Protocol control information. Not
-				 * supported: because the lib handles only 1 stream */
+	n_ai_t n_ai;		/* Address information of the request */
+	n_pci_t n_pci;		/* Protocol control information. Not used */
 	fl_param param;		/* Requested Parameter to change */
 	uint8_t pval;		/* Requested Value to set */
-	n_rslt rslt;		/* Result of the request */
+	n_rslt rslt;		/* Result of the request: N_OK, N_WRG_PARAM, N_WRG_VALUE,
+				 * N_RX_BUSY (a reception of the affected peer is in progress)
+				 * or N_OVFLW (all the entries of 'peers' are in use) */
 }n_chg_param_cfm_t;
 
 
@@ -342,9 +487,176 @@ typedef enum
 	N_INDN = 0x01,		/* N_USData.indication */
 	N_FF_INDN = 0x02,	/* N_USData_FF.indication */
 	N_CONF = 0x03,		/* N_USData.confirm */
-	N_CHG_P_CONF = 0x04	/* N_ChangeParameter.confirm */
+	N_CHG_P_CONF = 0x04,	/* N_ChangeParameter.confirm */
+	N_ERR_INDN = 0x05	/* Error report (on_error) */
 }signal_tp;
 
+/* --- Event record (event-queue output mode) ------------------------------ */
+
+typedef struct ALIGNMENT
+{
+	uint8_t tp;		/* Type of the event `signal_tp` */
+	uint8_t fr_fmt;		/* CANBus Frame format `cbus_fr_format` */
+	uint16_t rslt;		/* Result of the service or the reported error `n_rslt` */
+	n_ai_t n_ai;		/* Address information */
+	uint16_t msg_sz;	/* Size of the message */
+	const uint8_t* msg;	/* Reference to the message (not copied). N_INDN: buffer of the
+				 * reception pool, lent until 'iso15765_rx_release' */
+#ifdef I15765_FRAME_TS
+	uint64_t ts;		/* Arrival time of the frame which completed the reception
+				 * (N_INDN, N_FF_INDN). Otherwise 0 */
+#endif
+#ifdef I15765_DIGEST
+	uint32_t crc;		/* Digest of the message (N_INDN, N_CONF) */
+#endif
+}n_evt_t;
+
+/* --- Event queue (single producer: engine, single consumer: application) - */
+
+typedef struct ALIGNMENT
+{
+	n_evt_t* buf;		/* Caller provided storage of the events */
+	uint16_t mask;		/* No. of elements - 1 (No. of elements must be a power of two) */
+	volatile uint16_t head;	/* Write position. Only updated by the engine */
+	volatile uint16_t tail;	/* Read position. Only updated by the application */
+	uint32_t lost;		/* Events that were dropped because the queue was full */
+}n_evtq_t;
+
+/* --- Reception buffer (lent to the application with the indication) ----- */
+
+typedef struct ALIGNMENT
+{
+	volatile uint8_t lent;		/* Owned by the application until 'iso15765_rx_release' */
+	uint16_t msg_sz;		/* Size of the lent message */
+	uint8_t msg[I15765_MSG_SIZE];	/* Message data */
+}n_rxbuf_t;
+
+/* --- FlowControl parameters changed for a peer (N_ChangeParameter) ------ */
+
+typedef struct ALIGNMENT
+{
+	n_ai_t n_ai;		/* Address information of the receptions from the peer */
+	uint8_t used;		/* Parameters set for the peer (bit: 1 << `fl_param`). 0: free */
+	uint8_t bs;		/* BlockSize of the FlowControl frames */
+	uint8_t stmin;		/* SeparationTimeMin of the FlowControl frames */
+}n_peer_param_t;
+
+/* --- Return values of the 'send_frame' callback -------------------------- */
+
+typedef enum
+{
+	N_SEND_OK = 0x00,	/* The frame was taken by the driver/controller */
+	N_SEND_ERR = 0x01,	/* The frame could not be sent (any other value) */
+	N_SEND_BUSY = 0x02	/* The TX buffer/mailboxes are full (e.g. HAL_BUSY): the same
+				 * frame is sent again later, the transmission does not advance */
+}n_send_rslt;
+
+/* --- Reception queue overflow policy ------------------------------------- */
+
+typedef enum
+{
+	N_INQ_DROP_NEWEST = 0x00,	/* The new frame is dropped (N_BUFFER_OVFLW) */
+	N_INQ_DROP_OLDEST = 0x01,	/* The oldest frame is dropped to store the new one (N_OK).
+					 * Requires the atomic operations (I15765_ATOMIC_CAS) */
+	N_INQ_REJECT = 0x02		/* The new frame is not stored and the caller keeps
+					 * it to enqueue it later (N_RX_BUSY) */
+}n_inq_policy;
+
+/* --- Digest of the messages (I15765_DIGEST) ----------------------------- */
+
+typedef enum
+{
+	N_DIGEST_NONE = 0x00,		/* No digest (0) */
+	N_DIGEST_CRC32 = 0x01,		/* CRC-32 (IEEE 802.3, zlib) */
+	N_DIGEST_CRC32C = 0x02		/* CRC-32C (Castagnoli), hardware accelerated on SSE4.2/ARMv8 */
+}n_digest;
+
+/* --- Completion token of a submitted request ---------------------------- */
+
+typedef enum
+{
+	N_TOK_FREE = 0x00,	/* Not in use */
+	N_TOK_PENDING = 0x01,	/* Submitted, the transmission is pending or in progress */
+	N_TOK_DONE = 0x02	/* Completed, 'rslt' is valid */
+}n_tok_sts;
+
+typedef struct ALIGNMENT
+{
+	volatile uint32_t sts;	/* Token status `n_tok_sts` */
+	n_rslt rslt;		/* Result of the transmission (N_USData.confirm) */
+#ifdef I15765_DIGEST
+	uint32_t crc;		/* Digest of the transmitted message */
+#endif
+}n_token_t;
+
+/* --- Pending transmission request (priority TX queue) ------------------- */
+
+typedef struct ALIGNMENT
+{
+	n_req_t* req;		/* Pending request. Must stay valid until its transmission starts */
+	uint8_t prio;		/* Priority of the request (0: highest) */
+	n_token_t* tok;		/* Optional. Completion token of the request */
+}n_txq_elm_t;
+
+typedef struct ALIGNMENT
+{
+	n_txq_elm_t* buf;	/* Caller provided storage, sorted by priority */
+	uint8_t elms;		/* Capacity of the storage */
+	uint8_t cnt;		/* No. of pending requests */
+	uint32_t preempted;	/* Single Frames sent between the CFs of a transfer */
+}n_txq_t;
+
+/* --- Multi-producer submission queue ------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	volatile uint32_t seq;	/* Sequence of the slot (bounded MPMC queue scheme) */
+	n_req_t* req;		/* Submitted request */
+	uint8_t prio;		/* Priority of the request (0: highest) */
+	n_token_t* tok;		/* Optional. Completion token of the request */
+}n_subq_elm_t;
+
+typedef struct ALIGNMENT
+{
+	n_subq_elm_t* buf;	/* Caller provided storage */
+	uint32_t mask;		/* No. of elements - 1 (No. of elements must be a power of two) */
+	volatile uint32_t head;	/* Next position to write. Claimed by the producers (CAS) */
+	uint32_t tail;		/* Next position to read. Only used by 'iso15765_process' */
+}n_subq_t;
+
+/* --- Bus-load limiter (token bucket) ------------------------------------- */
+
+typedef enum
+{
+	N_RATE_FRAMES = 0x00,	/* One token per frame */
+	N_RATE_BITS = 0x01	/* One token per on-wire bit (worst-case stuffing, incl. IFS) */
+}n_rate_unit;
+
+typedef struct ALIGNMENT
+{
+	n_rate_unit unit;	/* Cost of a frame in tokens */
+	uint32_t rate;		/* Tokens added per second (frames/s or bits/s) */
+	uint32_t burst;		/* Max. tokens of the bucket (burst allowance) */
+	uint32_t tokens;	/* Available tokens */
+	uint32_t rem;		/* Remainder of the last refill (tokens * 1/1000) */
+	uint32_t last_ms;	/* Time of the last refill */
+	uint8_t sync;		/* 'last_ms' is valid */
+	uint32_t denied;	/* No. of times a frame was deferred by the limiter */
+}n_rate_t;
+
+/* --- Work budget of 'iso15765_process_budget' ---------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint16_t max_frames;	/* Max. frames (received + sent) per call. 0: no limit */
+	uint32_t max_us;	/* Max. time per call in us, checked between frames ('get_us',
+				 * else 'get_ms' with a 1ms resolution). 0: no limit */
+	uint16_t rx_frames;	/* Out: frames taken from the reception queue */
+	uint16_t tx_frames;	/* Out: frames of the outbound stream taken by the driver */
+	uint16_t rx_left;	/* Out: frames left in the reception queue */
+	uint8_t tx_left;	/* Out: the outbound stream or the TX queues have pending work */
+}n_budget_t;
+
 /* --- Callbacks  ---------------------------------------------------------- */
 
 typedef struct ALIGNMENT
@@ -364,13 +676,20 @@ typedef struct ALIGNMENT
 	void (*on_error)(n_rslt);			/* Will be fired in any occured error. */
 	uint32_t(*get_ms)();				/* Time-source for the library in ms(required) */
 	uint8_t(*send_frame)				/* Callback to assing the Network Layer. This callback */
-		(					/* will be fired when a transmission of a canbus frame is ready. */
+		(					/* will be fired when a transmission of a canbus frame is ready.
+							 * Returns `n_send_rslt` */
 		cbus_id_type,				/* - CANBus Frame ID Type [Standard or Extended] */
 		uint32_t,				/* - Frame ID */
-		cbus_fr_format,				/* - Frame Type: [CLASSIC or FD]*/
-		uint8_t,				/* - Frame Data Length */
+		cbus_fr_format,				/* - Frame Type: [CLASSIC, FD or XL]*/
+		cbus_dl_t,				/* - Frame Data Length */
 		uint8_t*				/* - Frame Data Array */
 		);										
+#ifdef I15765_FRAME_TS
+	uint64_t(*get_ts)();				/* Optional. Time-source of the frame timestamps. If NULL,
+							 * the timestamps are 'get_ms' x 'ts_per_ms' */
+#endif
+	uint32_t(*get_us)();				/* Optional. Time-source in us of the time budget of
+							 * 'iso15765_process_budget' */
 }n_callbacks_t;
 
 /* --- PDU Stream  --------------------------------------------------------- */
@@ -383,15 +702,33 @@ typedef struct ALIGNMENT
 	uint8_t wf_cnt;			/* Current received wait flow control frames */
 	uint8_t sn_glb;			/* Current Sequence Number of the transmittion */
 	uint8_t cfg_wf;			/* Max supported Wait Flow Control frames */
-	uint8_t stmin;			/* Frames transmission rate */
+	uint8_t stmin;			/* Frames transmission rate (ms) */
 	uint8_t cfg_bs;			/* Max. supported block sequence (ConsecutiveFrame) */
 	stream_sts sts;			/* Stream status */
 	uint16_t msg_sz;		/* Actual message buffer size */
 	uint16_t msg_pos;		/* Transmit message buffer position */
+	uint16_t msg_avl;		/* Bytes of the message buffer available for transmission */
+	uint8_t fc_pend;		/* A FlowControl is pending (fc_pend_sts) */
+	uint8_t prio;			/* Priority of the transmission in progress */
+	cbus_dl_t tx_dl;		/* CAN DL of the FF/CFs of the transmission in progress */
 	n_timeouts last_upd;		/* Time keeper for timouts */
+#ifdef I15765_DIGEST
+	uint32_t crc;			/* Digest of the bytes received/sent so far */
+#endif
 	uint8_t msg[I15765_MSG_SIZE];	/* Received/Transmit message buffer */
 }n_iostream_t;
 
+/* --- FlowControl of the reception ---------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	cbus_fr_format fr_fmt;		/* CANBus Frame format of the reception */
+	n_ai_t n_ai;			/* Address information (the sender of the FF/CFs is the target) */
+	uint8_t fs;			/* FlowStatus (flow_sts) */
+	uint8_t bs;			/* BlockSize */
+	uint8_t st;			/* SeparationTime (STmin encoding) */
+}n_fc_t;
+
 /* --- iso15765 timing configuration (ref: iso15765-2 p.25)----------------- */
 
 typedef struct ALIGNMENT
@@ -413,11 +750,56 @@ typedef struct ALIGNMENT
 	n_iostream_t in;		/* Incoming data stream (reception) */
 	n_iostream_t out;		/* Outcoming data stream (transmission) */
 	n_pdu_t fl_pdu;			/* Flow control pdu */
+	n_fc_t fc;			/* Last FlowControl of the reception, kept while it is pending */
 	n_callbacks_t clbs;		/* Callbacks */
 	n_config_t config;		/* Default configuration to be used. (timing etc) */
 	n_timeouts cfg_timeout;		/* Timeouts configuration */
+	uint8_t fc_hold;		/* If set, the FlowControl frames of the reception are held
+					 * until they are released by 'iso15765_fc_release' */
+	const n_bus_cfg_t* bus;		/* Optional. If assigned, the frame format and the CAN DL of the
+					 * CAN FD requests are chosen to minimize their bus time */
+	n_rate_t* rate;			/* Optional. If assigned, every transmitted frame consumes tokens
+					 * and is deferred while the bucket is empty */
+	n_subq_t* subq;			/* Optional. Requests submitted by other threads with
+					 * 'iso15765_submit' are taken from this queue */
+	n_token_t* tx_tok;		/* Completion token of the transmission in progress */
+	volatile uint32_t proc_busy;	/* 'iso15765_process' or 'iso15765_tx_complete' is running */
+	volatile uint8_t tx_kick;	/* 'iso15765_tx_complete' was called during the process */
+	n_txq_t* txq;			/* Optional. If assigned, requests made during a transmission
+					 * are queued by priority instead of returning N_TX_BUSY */
+	n_evtq_t* evtq;			/* Optional. If assigned, the events are written in this queue
+					 * instead of firing the indn/ff_indn/cfm/on_error callbacks.
+					 * Requires 'rx_pool' */
+	n_rxbuf_t* rx_pool;		/* Optional. If assigned, every reception is stored in a free
+					 * buffer of the pool, which is lent with the indication */
+	uint8_t rx_pool_elms;		/* No. of buffers of 'rx_pool' (2: double buffering) */
+	n_rxbuf_t* rx_cur;		/* Buffer of the reception in progress */
+	uint32_t rx_starved;		/* Receptions refused because all the buffers were lent */
+	n_peer_param_t* peers;		/* Optional. Storage of the FlowControl parameters changed per
+					 * peer with 'iso15765_change_param' (N_CHG_PEER) */
+	uint8_t peer_elms;		/* No. of entries of 'peers' */
+	void* inq_storage;		/* Optional. Caller provided storage of the reception queue
+					 * ('inq_elms' x n_inq_slot_t). If NULL, 'inq_buf' is used */
+	uint16_t inq_elms;		/* No. of slots of 'inq_storage' (power of two is faster) */
+	n_inq_policy inq_policy;	/* Action when the reception queue is full */
+	uint32_t inq_dropped;		/* Frames dropped by the DROP_NEWEST/DROP_OLDEST policies */
+	uint32_t inq_rejected;		/* Frames refused by the REJECT policy */
+	uint32_t tx_frames;		/* Frames taken by the driver (FlowControls included) */
+#ifdef I15765_DIGEST
+	n_digest digest;		/* Digest of the received and transmitted messages */
+#endif
+#ifdef I15765_FRAME_TS
+	uint32_t ts_per_ms;		/* Ticks of the timestamps per ms (0: 1000000, ns) */
+	uint64_t rx_ts;			/* Arrival time of the frame in process */
+	uint32_t rx_ms;			/* Arrival time of the frame in process (get_ms time-base) */
+	uint64_t lat_max;		/* Max. queueing latency (arrival to processing) in ticks */
+	uint64_t lat_sum;		/* Sum of the queueing latencies in ticks */
+	uint32_t lat_cnt;		/* Frames of 'lat_sum' */
+#endif
 	iqueue_t inqueue;		/* Queue handler for the incoming canbus frames */
-	uint8_t inq_buf[I15765_QUEUE_ELMS * sizeof(canbus_frame_t)]; /* Queue buffer */
+#if I15765_QUEUE_ELMS > 0
+	uint8_t inq_buf[I15765_QUEUE_ELMS * sizeof(n_inq_slot_t)]; /* Queue buffer */
+#endif
 }iso15765_t;
 
 /******************************************************************************
@@ -428,10 +810,46 @@ n_rslt iso15765_init(iso15765_t* instance);
 
 n_rslt iso15765_send(iso15765_t* instance, n_req_t* frame);
 
+n_rslt iso15765_send_prio(iso15765_t* instance, n_req_t* frame, uint8_t prio);
+
+n_rslt iso15765_txq_init(n_txq_t* queue, n_txq_elm_t* storage, uint8_t elms);
+
+#ifdef I15765_ATOMIC_CAS
+n_rslt iso15765_subq_init(n_subq_t* queue, n_subq_elm_t* storage, uint32_t elms);
+
+n_rslt iso15765_submit(iso15765_t* instance, n_req_t* frame, uint8_t prio, n_token_t* tok);
+
+n_rslt iso15765_token_poll(n_token_t* tok);
+#endif
+
+n_rslt iso15765_send_begin(iso15765_t* instance, cbus_fr_format fr_fmt, const n_ai_t* n_ai, uint16_t msg_sz);
+
+n_rslt iso15765_send_push(iso15765_t* instance, const uint8_t* dt, uint16_t sz);
+
+n_rslt iso15765_send_abort(iso15765_t* instance);
+
+n_rslt iso15765_rate_init(n_rate_t* limiter, n_rate_unit unit, uint32_t rate, uint32_t burst);
+
+n_rslt iso15765_fc_release(iso15765_t* instance, uint8_t bs, uint8_t stmin);
+
+n_rslt iso15765_change_param(iso15765_t* instance, n_chg_param_req_t* req);
+
 n_rslt iso15765_enqueue(iso15765_t* instance, canbus_frame_t* frame);
 
+n_rslt iso15765_frame_decode(addr_md address, const canbus_frame_t* frame, n_pdu_t* pdu);
+
 n_rslt iso15765_process(iso15765_t* instance);
 
+n_rslt iso15765_process_budget(iso15765_t* instance, n_budget_t* budget);
+
+n_rslt iso15765_tx_complete(iso15765_t* instance);
+
+n_rslt iso15765_rx_release(iso15765_t* instance, const uint8_t* msg);
+
+n_rslt iso15765_evtq_init(n_evtq_t* queue, n_evt_t* storage, uint16_t elms);
+
+n_rslt iso15765_evtq_pop(n_evtq_t* queue, n_evt_t* evt);
+
 /******************************************************************************
 * EOF - NO CODE AFTER THIS LINE
 ******************************************************************************/
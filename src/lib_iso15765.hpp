@@ -0,0 +1,870 @@
+/*!
+@file   lib_iso15765.hpp
+@brief  Header-only C++17 layer of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_HPP_
+#define DEVCOONS_ISO15765_2_HPP_
+
+#ifndef I15765_CPP_QUEUE_ELMS
+#define I15765_CPP_QUEUE_ELMS	64	/* No. of received frames queued by each Channel (power of two) */
+#endif
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+extern "C" {
+#include "lib_iso15765.h"
+}
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+namespace iso15765
+{
+
+#if defined(__cpp_lib_span)
+template<typename T>
+using span = std::span<T>;
+#else
+/* Minimal replacement of std::span for C++17 toolchains */
+template<typename T>
+class span
+{
+public:
+	constexpr span() noexcept : ptr_(nullptr), sz_(0) {}
+	constexpr span(T* ptr, std::size_t sz) noexcept : ptr_(ptr), sz_(sz) {}
+	template<std::size_t N>
+	constexpr span(T (&arr)[N]) noexcept : ptr_(arr), sz_(N) {}
+	template<typename U, typename = std::enable_if_t<std::is_convertible_v<U(*)[], T(*)[]>>>
+	constexpr span(const span<U>& other) noexcept : ptr_(other.data()), sz_(other.size()) {}
+	constexpr T* data() const noexcept { return ptr_; }
+	constexpr std::size_t size() const noexcept { return sz_; }
+	constexpr bool empty() const noexcept { return sz_ == 0; }
+	constexpr T& operator[](std::size_t i) const noexcept { return ptr_[i]; }
+	constexpr T* begin() const noexcept { return ptr_; }
+	constexpr T* end() const noexcept { return ptr_ + sz_; }
+private:
+	T* ptr_;
+	std::size_t sz_;
+};
+#endif
+
+/* --- Compile-time selectors ---------------------------------------------- */
+
+enum class AddrMode : std::uint8_t
+{
+	Normal   = N_ADM_NORMAL,
+	Fixed    = N_ADM_FIXED,
+	Mixed11  = N_ADM_MIXED11,
+	Extended = N_ADM_EXTENDED,
+	Mixed29  = N_ADM_MIXED29
+};
+
+enum class FrameFormat : std::uint8_t
+{
+	Classic = CBUS_FR_FRM_STD,
+	Fd      = CBUS_FR_FRM_FD
+};
+
+/* --- Addressing codec (ref: iso15765-2 p.28) ----------------------------- */
+
+template<AddrMode M>
+struct addr_codec
+{
+	static constexpr std::uint8_t offs = (static_cast<std::uint8_t>(M) & 0x01U);
+	static constexpr cbus_id_type id_type = (M == AddrMode::Fixed || M == AddrMode::Mixed29)
+		? CBUS_ID_T_EXTENDED : CBUS_ID_T_STANDARD;
+
+	/* Same layout as the C 'n_pdu_pack' but resolved at compile time */
+	static constexpr std::uint32_t pack_id(const n_ai_t& ai) noexcept
+	{
+		const std::uint32_t phy = (ai.n_tt == N_TA_T_PHY);
+
+		if constexpr (M == AddrMode::Extended)
+		{
+			return 0x80U | (std::uint32_t(ai.n_pr) << 8) | (std::uint32_t(ai.n_ae) << 3)
+				| ai.n_sa | (phy ? 0x40U : 0x00U);
+		}
+		else if constexpr (M == AddrMode::Normal || M == AddrMode::Mixed11)
+		{
+			return 0x80U | (std::uint32_t(ai.n_pr) << 8) | (std::uint32_t(ai.n_ta) << 3)
+				| ai.n_sa | (phy ? 0x40U : 0x00U);
+		}
+		else if constexpr (M == AddrMode::Mixed29)
+		{
+			return (std::uint32_t(ai.n_pr) << 26) | ((phy ? 0xCEU : 0xCDU) << 16)
+				| (std::uint32_t(ai.n_ta) << 8) | ai.n_sa;
+		}
+		else
+		{
+			return (std::uint32_t(ai.n_pr) << 26) | ((phy ? 0xDAU : 0xDBU) << 16)
+				| (std::uint32_t(ai.n_ta) << 8) | ai.n_sa;
+		}
+	}
+
+	/* Address byte which precedes the PCI (extended/mixed modes only) */
+	static constexpr std::uint8_t addr_byte(const n_ai_t& ai) noexcept
+	{
+		if constexpr (M == AddrMode::Extended)
+		{
+			return ai.n_ta;
+		}
+		else
+		{
+			return ai.n_ae;
+		}
+	}
+
+	/* Address information of a received frame, inverse of 'pack_id'/'addr_byte' */
+	static constexpr n_ai_t unpack(std::uint32_t id, const std::uint8_t* dt) noexcept
+	{
+		n_ai_t ai{};
+
+		if constexpr (M == AddrMode::Normal || M == AddrMode::Mixed11 || M == AddrMode::Extended)
+		{
+			ai.n_pr = static_cast<std::uint8_t>((id & 0x700U) >> 8);
+			ai.n_sa = static_cast<std::uint8_t>(id & 0x07U);
+			ai.n_tt = (id & 0x40U) != 0U ? N_TA_T_PHY : N_TA_T_FUNC;
+			if constexpr (M == AddrMode::Extended)
+			{
+				ai.n_ae = static_cast<std::uint8_t>((id & 0x38U) >> 3);
+				ai.n_ta = dt[0];
+			}
+			else
+			{
+				ai.n_ta = static_cast<std::uint8_t>((id & 0x38U) >> 3);
+			}
+		}
+		else
+		{
+			constexpr std::uint32_t phy = (M == AddrMode::Mixed29) ? 0xCEU : 0xDAU;
+			ai.n_pr = static_cast<std::uint8_t>((id >> 26) & 0x07U);
+			ai.n_tt = ((id >> 16) & 0xFFU) == phy ? N_TA_T_PHY : N_TA_T_FUNC;
+			ai.n_ta = static_cast<std::uint8_t>((id >> 8) & 0xFFU);
+			ai.n_sa = static_cast<std::uint8_t>(id & 0xFFU);
+		}
+		if constexpr (M == AddrMode::Mixed11 || M == AddrMode::Mixed29)
+		{
+			ai.n_ae = dt[0];
+		}
+		return ai;
+	}
+
+	/* Address information of the answer (FlowControl) to a received frame */
+	static constexpr n_ai_t reverse(const n_ai_t& ai) noexcept
+	{
+		n_ai_t rev = ai;
+		rev.n_sa = ai.n_ta;
+		rev.n_ta = ai.n_sa;
+		return rev;
+	}
+
+	/* Same peer, as the C 'peer_match': N_AE is part of the address only in
+	 * the extended and mixed modes */
+	static constexpr bool match(const n_ai_t& peer, const n_ai_t& ai) noexcept
+	{
+		if (peer.n_sa != ai.n_sa || peer.n_ta != ai.n_ta)
+		{
+			return false;
+		}
+		if constexpr (M == AddrMode::Extended || M == AddrMode::Mixed11 || M == AddrMode::Mixed29)
+		{
+			return peer.n_ae == ai.n_ae;
+		}
+		return true;
+	}
+};
+
+/* --- PCI codec (ref: iso15765-2 p.17) ------------------------------------ */
+
+template<AddrMode M, FrameFormat F>
+struct pci_codec
+{
+	static constexpr std::uint8_t offs = addr_codec<M>::offs;
+	static constexpr std::uint8_t tx_dl = (F == FrameFormat::Classic) ? 8U : 64U;
+	/* payload limits, identical to the ones used by 'iso15765_process_out' */
+	static constexpr std::uint16_t sf_max = (F == FrameFormat::Classic) ? (7U - offs) : (62U - offs);
+	static constexpr std::uint16_t ff_payload = (F == FrameFormat::Classic) ? (6U - offs) : (62U - offs);
+	static constexpr std::uint16_t cf_payload = (F == FrameFormat::Classic) ? (7U - offs) : (63U - offs);
+
+	/* CAN FD data length table indexed by the payload size */
+	static constexpr std::uint8_t can_dl(std::size_t sz) noexcept
+	{
+		if constexpr (F == FrameFormat::Classic)
+		{
+			return static_cast<std::uint8_t>(sz <= 8U ? sz : 8U);
+		}
+		else
+		{
+			constexpr std::uint8_t dls[] = { 8, 12, 16, 20, 24, 32, 48, 64 };
+			if (sz <= 8U)
+			{
+				return static_cast<std::uint8_t>(sz);
+			}
+			for (std::uint8_t dl : dls)
+			{
+				if (sz <= dl)
+				{
+					return dl;
+				}
+			}
+			return 64U;
+		}
+	}
+
+	/* Separation time (ms) of a received STmin, as 'n_stmin_ms' of the C engine */
+	static constexpr std::uint8_t stmin_ms(std::uint8_t st) noexcept
+	{
+		if (st <= 0x7FU)
+		{
+			return st;
+		}
+		return (st >= 0xF1U && st <= 0xF9U) ? 1U : 0x7FU;
+	}
+
+	/* Address byte and pad the frame up to its CAN DL. Returns the CAN DL */
+	static std::uint8_t finish(const n_ai_t& ai, std::size_t used, std::uint8_t* dt) noexcept
+	{
+		if constexpr (offs != 0U)
+		{
+			dt[0] = addr_codec<M>::addr_byte(ai);
+		}
+		std::uint8_t dl = can_dl(used);
+		std::memset(&dt[used], 0, dl - used);
+		return dl;
+	}
+
+	/* Encode a complete Single Frame. Returns the CAN DL of the frame */
+	static std::uint8_t encode_sf(const n_ai_t& ai, span<const std::uint8_t> msg, std::uint8_t* dt) noexcept
+	{
+		std::uint8_t pos = offs;
+
+		if (msg.size() <= std::size_t(7U - offs))
+		{
+			dt[pos++] = static_cast<std::uint8_t>(msg.size() & 0x0FU);
+		}
+		else
+		{
+			dt[pos++] = 0x00U;
+			dt[pos++] = static_cast<std::uint8_t>(msg.size());
+		}
+		std::memcpy(&dt[pos], msg.data(), msg.size());
+		return finish(ai, pos + msg.size(), dt);
+	}
+
+	/* Encode a First Frame with the first 'ff_payload' bytes of the message */
+	static std::uint8_t encode_ff(const n_ai_t& ai, span<const std::uint8_t> msg, std::uint8_t* dt) noexcept
+	{
+		dt[offs] = static_cast<std::uint8_t>(0x10U | ((msg.size() >> 8) & 0x0FU));
+		dt[offs + 1U] = static_cast<std::uint8_t>(msg.size() & 0xFFU);
+		std::memcpy(&dt[offs + 2U], msg.data(), ff_payload);
+		return finish(ai, tx_dl, dt);
+	}
+
+	/* Encode a Consecutive Frame with up to 'cf_payload' bytes */
+	static std::uint8_t encode_cf(const n_ai_t& ai, std::uint8_t sn, span<const std::uint8_t> part, std::uint8_t* dt) noexcept
+	{
+		dt[offs] = static_cast<std::uint8_t>(0x20U | (sn & 0x0FU));
+		std::memcpy(&dt[offs + 1U], part.data(), part.size());
+		return finish(ai, offs + 1U + part.size(), dt);
+	}
+
+	/* Encode a FlowControl */
+	static std::uint8_t encode_fc(const n_ai_t& ai, std::uint8_t fs, std::uint8_t bs, std::uint8_t st, std::uint8_t* dt) noexcept
+	{
+		dt[offs] = static_cast<std::uint8_t>(0x30U | (fs & 0x0FU));
+		dt[offs + 1U] = bs;
+		dt[offs + 2U] = st;
+		return finish(ai, offs + 3U, dt);
+	}
+};
+
+/* --- Channel  ------------------------------------------------------------ */
+
+/* ISO15765-2 protocol engine specialized at compile time. The frames are
+ * decoded, reassembled and segmented by the codecs of the template parameters
+ * (no runtime dispatch on the addressing mode or the frame format) and the
+ * events are delivered to the callables as soon as they occur. */
+template<AddrMode M, FrameFormat F, std::uint16_t MaxMsg = I15765_MSG_SIZE>
+class Channel
+{
+	static_assert(MaxMsg > 0U && MaxMsg <= I15765_MSG_SIZE,
+		"MaxMsg must fit the message buffers of the library (I15765_MSG_SIZE)");
+	static_assert(MaxMsg <= 0xFFFU, "MaxMsg must fit the 12 bits FF_DL");
+	static_assert(I15765_CPP_QUEUE_ELMS > 1 && (I15765_CPP_QUEUE_ELMS & (I15765_CPP_QUEUE_ELMS - 1)) == 0,
+		"I15765_CPP_QUEUE_ELMS must be a power of two");
+
+public:
+	using addr = addr_codec<M>;
+	using pci = pci_codec<M, F>;
+
+	using send_fn = std::function<bool(std::uint32_t id, span<const std::uint8_t> dt)>;
+	using time_fn = std::function<std::uint32_t()>;
+	using indn_fn = std::function<void(const n_ai_t&, n_rslt, span<const std::uint8_t>)>;
+	using cfm_fn = std::function<void(const n_ai_t&, n_rslt)>;
+	using error_fn = std::function<void(n_rslt)>;
+
+	/* 'send' returns false if the driver did not take the frame: the same
+	 * frame is sent again by the next 'process' */
+	Channel(send_fn send, time_fn get_ms, const n_config_t& config)
+		: send_(std::move(send)), get_ms_(std::move(get_ms)), config_(config)
+	{
+		sts_ = (send_ && get_ms_) ? N_OK : N_MISSING_CLB;
+	}
+
+	/* The inbound queue is shared with the driver, the Channel must not move */
+	Channel(const Channel&) = delete;
+	Channel& operator=(const Channel&) = delete;
+
+	n_rslt status() const noexcept { return sts_; }
+
+	/* No transmission in progress, 'send' accepts a new message */
+	bool tx_idle() const noexcept { return tx_.sts == tx_sts::idle; }
+
+	/* Frames refused by 'enqueue' because the inbound queue was full */
+	std::uint32_t rx_dropped() const noexcept { return rx_dropped_; }
+
+	void on_indication(indn_fn fn) { indn_ = std::move(fn); }
+	void on_ff_indication(indn_fn fn) { ff_indn_ = std::move(fn); }
+	void on_confirm(cfm_fn fn) { cfm_ = std::move(fn); }
+	void on_error(error_fn fn) { error_ = std::move(fn); }
+
+	/* Frames received by the driver (single producer, e.g. the RX interrupt) */
+	n_rslt enqueue(const canbus_frame_t& frame) noexcept
+	{
+		if (frame.id_type != static_cast<std::uint32_t>(addr::id_type) || frame.dlc <= pci::offs || frame.dlc > pci::tx_dl)
+		{
+			return N_ERROR;
+		}
+
+		std::uint32_t head = head_.load(std::memory_order_relaxed);
+		if (head - tail_.load(std::memory_order_acquire) >= I15765_CPP_QUEUE_ELMS)
+		{
+			rx_dropped_++;
+			return N_BUFFER_OVFLW;
+		}
+		rx_slot& slot = inq_[head & (I15765_CPP_QUEUE_ELMS - 1U)];
+		slot.id = frame.id;
+		slot.dlc = static_cast<std::uint8_t>(frame.dlc);
+		std::memcpy(slot.dt, frame.dt, frame.dlc);
+		head_.store(head + 1U, std::memory_order_release);
+		return N_OK;
+	}
+
+	/* Request a transmission. The message is copied, the confirmation is
+	 * delivered to 'on_confirm' when the transmission ends (N_OK or the
+	 * reason of the failure) */
+	n_rslt send(const n_ai_t& ai, span<const std::uint8_t> msg)
+	{
+		if (msg.empty())
+		{
+			return N_INV_REQ_SZ;
+		}
+		if (msg.size() > MaxMsg)
+		{
+			return N_BUFFER_OVFLW;
+		}
+		if (tx_.sts != tx_sts::idle)
+		{
+			return N_TX_BUSY;
+		}
+
+		tx_.ai = ai;
+		tx_.sz = static_cast<std::uint16_t>(msg.size());
+		tx_.pos = 0;
+		std::memcpy(tx_.msg, msg.data(), msg.size());
+		tx_.sts = msg.size() <= pci::sf_max ? tx_sts::sf : tx_sts::ff;
+
+		/* a Single Frame leaves right away if the driver takes it */
+		if (tx_.sts == tx_sts::sf)
+		{
+			tx_step(get_ms_());
+		}
+		return N_OK;
+	}
+
+	/* Run the protocol: every queued frame is processed and the outbound
+	 * message advances as far as the driver and the FlowControl allow */
+	n_rslt process()
+	{
+		n_budget_t budget{};
+		return process(budget);
+	}
+
+	/* Same with a work budget (see 'iso15765_process_budget'). The received
+	 * frames and the frames of the outbound message are interleaved */
+	n_rslt process(n_budget_t& budget)
+	{
+		if (sts_ != N_OK)
+		{
+			return sts_;
+		}
+
+		std::uint32_t start = get_ms_();
+		budget.rx_frames = 0;
+		budget.tx_frames = 0;
+
+		for (;;)
+		{
+			std::uint8_t progress = 0;
+
+			if (within(budget, start))
+			{
+				rx_slot* slot = peek();
+				if (slot != nullptr)
+				{
+					rx_frame(*slot);
+					tail_.store(tail_.load(std::memory_order_relaxed) + 1U, std::memory_order_release);
+					budget.rx_frames++;
+					progress = 1;
+				}
+			}
+			if (within(budget, start))
+			{
+				std::uint32_t now = get_ms_();
+				if (fc_step() || tx_step(now))
+				{
+					budget.tx_frames++;
+					progress = 1;
+				}
+			}
+			if (progress == 0)
+			{
+				break;
+			}
+		}
+
+		process_timeouts(get_ms_());
+		budget.rx_left = static_cast<std::uint16_t>(head_.load(std::memory_order_acquire)
+			- tail_.load(std::memory_order_relaxed));
+		budget.tx_left = (fc_.pend != 0 || tx_.sts == tx_sts::sf || tx_.sts == tx_sts::ff
+			|| tx_.sts == tx_sts::cf) ? 1U : 0U;
+		return N_OK;
+	}
+
+private:
+	enum class tx_sts : std::uint8_t { idle, sf, ff, wait_fc, cf };
+
+	/* Slot of the inbound queue (only the frame format of the Channel) */
+	struct rx_slot
+	{
+		std::uint32_t id;
+		std::uint8_t dlc;
+		std::uint8_t dt[pci::tx_dl];
+	};
+
+	/* Reception in progress (segmented message) */
+	struct rx_stream
+	{
+		bool busy = false;
+		n_ai_t ai{};
+		std::uint16_t sz = 0;
+		std::uint16_t pos = 0;
+		std::uint8_t sn = 0;
+		std::uint8_t bs_cnt = 0;
+		std::uint32_t t_cr = 0;
+		std::uint8_t msg[MaxMsg];
+	};
+
+	/* Outbound message */
+	struct tx_stream
+	{
+		tx_sts sts = tx_sts::idle;
+		n_ai_t ai{};
+		std::uint16_t sz = 0;
+		std::uint16_t pos = 0;
+		std::uint8_t sn = 0;
+		std::uint8_t bs = 0;		/* Block size of the receiver (0: no more FC) */
+		std::uint8_t cf_cnt = 0;	/* CFs sent in the current block */
+		std::uint8_t wf_cnt = 0;	/* FC.WAIT received in a row */
+		std::uint8_t stmin = 0;		/* Separation time of the receiver (ms) */
+		bool st_wait = false;		/* The separation time runs since 't' */
+		std::uint32_t t = 0;		/* Start of N_Bs or time of the last CF */
+		std::uint8_t msg[MaxMsg];
+	};
+
+	/* FlowControl which the driver did not take yet (sent exactly as it was built) */
+	struct fc_frame
+	{
+		std::uint8_t pend = 0;
+		std::uint32_t id = 0;
+		std::uint8_t dl = 0;
+		std::uint8_t dt[pci::tx_dl];
+	};
+
+	bool within(const n_budget_t& budget, std::uint32_t start) const
+	{
+		if (budget.max_frames != 0 && budget.rx_frames + budget.tx_frames >= budget.max_frames)
+		{
+			return false;
+		}
+		return budget.max_us == 0 || (std::uint32_t)(get_ms_() - start) * 1000U < budget.max_us;
+	}
+
+	rx_slot* peek() noexcept
+	{
+		std::uint32_t tail = tail_.load(std::memory_order_relaxed);
+		if (head_.load(std::memory_order_acquire) == tail)
+		{
+			return nullptr;
+		}
+		return &inq_[tail & (I15765_CPP_QUEUE_ELMS - 1U)];
+	}
+
+	void report(n_rslt rslt)
+	{
+		if (error_) error_(rslt);
+	}
+
+	void indicate(const n_ai_t& ai, n_rslt rslt, span<const std::uint8_t> msg)
+	{
+		if (indn_) indn_(ai, rslt, msg);
+	}
+
+	/* The callable may already request the next transmission */
+	void confirm(n_rslt rslt)
+	{
+		n_ai_t ai = tx_.ai;
+		tx_.sts = tx_sts::idle;
+		if (cfm_) cfm_(ai, rslt);
+	}
+
+	/* An interrupted reception is reported with the received part */
+	void rx_abort(n_rslt rslt)
+	{
+		rx_.busy = false;
+		report(rslt);
+		indicate(rx_.ai, rslt, span<const std::uint8_t>(rx_.msg, rx_.pos));
+	}
+
+	void send_fc(const n_ai_t& rcv, std::uint8_t fs, std::uint8_t bs, std::uint8_t st)
+	{
+		n_ai_t ai = addr::reverse(rcv);
+		fc_.id = addr::pack_id(ai);
+		fc_.dl = pci::encode_fc(ai, fs, bs, st, fc_.dt);
+		fc_.pend = 1;
+		fc_step();
+	}
+
+	bool fc_step()
+	{
+		if (fc_.pend == 0 || !send_(fc_.id, span<const std::uint8_t>(fc_.dt, fc_.dl)))
+		{
+			return false;
+		}
+		fc_.pend = 0;
+		return true;
+	}
+
+	/* Reception of a frame (ref: iso15765-2 9.6) */
+	void rx_frame(const rx_slot& fr)
+	{
+		const n_ai_t ai = addr::unpack(fr.id, fr.dt);
+		const std::uint8_t* pdu = &fr.dt[pci::offs];
+		const std::uint8_t len = static_cast<std::uint8_t>(fr.dlc - pci::offs);
+
+		switch (pdu[0] >> 4)
+		{
+		case N_PCI_T_SF:
+			rx_sf(ai, pdu, len);
+			break;
+		case N_PCI_T_FF:
+			rx_ff(ai, pdu, len);
+			break;
+		case N_PCI_T_CF:
+			rx_cf(ai, pdu, len);
+			break;
+		case N_PCI_T_FC:
+			rx_fc(pdu, len);
+			break;
+		default:
+			report(N_INV_PDU);
+			break;
+		}
+	}
+
+	void rx_sf(const n_ai_t& ai, const std::uint8_t* pdu, std::uint8_t len)
+	{
+		std::uint16_t dl = pdu[0] & 0x0FU;
+		std::uint8_t hdr = 1U;
+
+		/* escape sequence of the CAN FD SF_DL */
+		if constexpr (F == FrameFormat::Fd)
+		{
+			if (dl == 0U && std::uint32_t(len) + pci::offs > 8U)
+			{
+				dl = pdu[1];
+				hdr = 2U;
+			}
+		}
+		if (dl == 0U || dl + hdr > len)
+		{
+			report(N_INV_PDU);
+			return;
+		}
+		if (rx_.busy)
+		{
+			rx_abort(N_UNE_PDU);
+		}
+		/* zero-copy: the payload is delivered from the queued frame */
+		indicate(ai, N_OK, span<const std::uint8_t>(&pdu[hdr], dl));
+	}
+
+	void rx_ff(const n_ai_t& ai, const std::uint8_t* pdu, std::uint8_t len)
+	{
+		if (len < 2U)
+		{
+			report(N_INV_PDU);
+			return;
+		}
+
+		std::uint16_t dl = static_cast<std::uint16_t>(((pdu[0] & 0x0FU) << 8) | pdu[1]);
+		std::uint16_t sz = static_cast<std::uint16_t>(len - 2U);
+
+		if (dl <= sz)
+		{
+			report(N_INV_PDU);
+			return;
+		}
+		if (rx_.busy)
+		{
+			rx_abort(N_UNE_PDU);
+		}
+		if (dl > MaxMsg)
+		{
+			report(N_BUFFER_OVFLW);
+			send_fc(ai, N_OVERFLOW, 0U, 0U);
+			return;
+		}
+
+		rx_.busy = true;
+		rx_.ai = ai;
+		rx_.sz = dl;
+		rx_.pos = sz;
+		rx_.sn = 1U;
+		rx_.bs_cnt = 0;
+		rx_.t_cr = get_ms_();
+		std::memcpy(rx_.msg, &pdu[2], sz);
+		if (ff_indn_) ff_indn_(ai, N_OK, span<const std::uint8_t>(rx_.msg, dl));
+		send_fc(ai, N_CONTINUE, config_.bs, config_.stmin);
+	}
+
+	void rx_cf(const n_ai_t& ai, const std::uint8_t* pdu, std::uint8_t len)
+	{
+		/* a CF which does not belong to a reception in progress is ignored */
+		if (!rx_.busy || !addr::match(rx_.ai, ai))
+		{
+			return;
+		}
+		/* same result as the C engine */
+		if ((pdu[0] & 0x0FU) != rx_.sn)
+		{
+			rx_abort(N_INV_SEQ_NUM);
+			return;
+		}
+
+		/* the padding of the last CF is not copied */
+		std::uint16_t sz = static_cast<std::uint16_t>(len - 1U);
+		sz = sz < rx_.sz - rx_.pos ? sz : static_cast<std::uint16_t>(rx_.sz - rx_.pos);
+		std::memcpy(&rx_.msg[rx_.pos], &pdu[1], sz);
+		rx_.pos = static_cast<std::uint16_t>(rx_.pos + sz);
+		rx_.sn = static_cast<std::uint8_t>((rx_.sn + 1U) & 0x0FU);
+		rx_.t_cr = get_ms_();
+
+		if (rx_.pos >= rx_.sz)
+		{
+			rx_.busy = false;
+			indicate(rx_.ai, N_OK, span<const std::uint8_t>(rx_.msg, rx_.sz));
+			return;
+		}
+		if (config_.bs != 0U && ++rx_.bs_cnt == config_.bs)
+		{
+			rx_.bs_cnt = 0;
+			send_fc(rx_.ai, N_CONTINUE, config_.bs, config_.stmin);
+		}
+	}
+
+	void rx_fc(const std::uint8_t* pdu, std::uint8_t len)
+	{
+		/* a FlowControl is only expected after the FF or the last CF of a block */
+		if (tx_.sts != tx_sts::wait_fc || len < 3U)
+		{
+			return;
+		}
+
+		switch (pdu[0] & 0x0FU)
+		{
+		case N_CONTINUE:
+			tx_.bs = pdu[1];
+			tx_.stmin = pci::stmin_ms(pdu[2]);
+			tx_.cf_cnt = 0;
+			tx_.wf_cnt = 0;
+			tx_.st_wait = false;
+			tx_.sts = tx_sts::cf;
+			break;
+		case N_WAIT:
+			if (++tx_.wf_cnt > config_.wf)
+			{
+				report(N_WFT_OVRN);
+				confirm(N_WFT_OVRN);
+				break;
+			}
+			tx_.t = get_ms_();
+			break;
+		case N_OVERFLOW:
+			report(N_BUFFER_OVFLW);
+			confirm(N_BUFFER_OVFLW);
+			break;
+		default:
+			report(N_INV_FS);
+			confirm(N_INV_FS);
+			break;
+		}
+	}
+
+	/* Send the next frame of the outbound message. Returns true if the
+	 * driver took a frame */
+	bool tx_step(std::uint32_t now)
+	{
+		std::uint8_t dt[pci::tx_dl];
+		std::uint8_t dl;
+		span<const std::uint8_t> msg(tx_.msg, tx_.sz);
+
+		switch (tx_.sts)
+		{
+		case tx_sts::sf:
+			dl = pci::encode_sf(tx_.ai, msg, dt);
+			if (!send_(addr::pack_id(tx_.ai), span<const std::uint8_t>(dt, dl)))
+			{
+				return false;
+			}
+			confirm(N_OK);
+			return true;
+		case tx_sts::ff:
+			dl = pci::encode_ff(tx_.ai, msg, dt);
+			if (!send_(addr::pack_id(tx_.ai), span<const std::uint8_t>(dt, dl)))
+			{
+				return false;
+			}
+			tx_.pos = pci::ff_payload;
+			tx_.sn = 1U;
+			tx_.wf_cnt = 0;
+			tx_.t = now;
+			tx_.sts = tx_sts::wait_fc;
+			return true;
+		case tx_sts::cf:
+		{
+			if (tx_.st_wait && (std::uint32_t)(now - tx_.t) < tx_.stmin)
+			{
+				return false;
+			}
+			std::uint16_t sz = static_cast<std::uint16_t>(tx_.sz - tx_.pos);
+			sz = sz < pci::cf_payload ? sz : pci::cf_payload;
+			dl = pci::encode_cf(tx_.ai, tx_.sn, span<const std::uint8_t>(&tx_.msg[tx_.pos], sz), dt);
+			if (!send_(addr::pack_id(tx_.ai), span<const std::uint8_t>(dt, dl)))
+			{
+				return false;
+			}
+			tx_.pos = static_cast<std::uint16_t>(tx_.pos + sz);
+			tx_.sn = static_cast<std::uint8_t>((tx_.sn + 1U) & 0x0FU);
+			tx_.t = now;
+			tx_.st_wait = tx_.stmin != 0U;
+			if (tx_.pos >= tx_.sz)
+			{
+				confirm(N_OK);
+			}
+			else if (tx_.bs != 0U && ++tx_.cf_cnt == tx_.bs)
+			{
+				tx_.sts = tx_sts::wait_fc;
+			}
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	/* N_Bs (awaited FlowControl) and N_Cr (awaited CF) */
+	void process_timeouts(std::uint32_t now)
+	{
+		if (tx_.sts == tx_sts::wait_fc && config_.n_bs != 0U && (std::uint32_t)(now - tx_.t) >= config_.n_bs)
+		{
+			report(N_TIMEOUT_Bs);
+			confirm(N_TIMEOUT_Bs);
+		}
+		if (rx_.busy && config_.n_cr != 0U && (std::uint32_t)(now - rx_.t_cr) >= config_.n_cr)
+		{
+			rx_abort(N_TIMEOUT_Cr);
+		}
+	}
+
+	send_fn send_;
+	time_fn get_ms_;
+	n_config_t config_;
+	n_rslt sts_;
+	indn_fn indn_;
+	indn_fn ff_indn_;
+	cfm_fn cfm_;
+	error_fn error_;
+	rx_stream rx_;
+	tx_stream tx_;
+	fc_frame fc_;
+	std::atomic<std::uint32_t> head_{ 0 };
+	std::atomic<std::uint32_t> tail_{ 0 };
+	std::uint32_t rx_dropped_ = 0;
+	rx_slot inq_[I15765_CPP_QUEUE_ELMS];
+};
+
+} /* namespace iso15765 */
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
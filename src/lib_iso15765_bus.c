@@ -0,0 +1,249 @@
+/*!
+@file   lib_iso15765_bus.c
+@brief  Source file of the CANBus bus-load model of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include "lib_iso15765_bus.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/* CAN FD data lengths (ref: ISO 11898-1) */
+static const uint8_t fd_dls[] = { 8, 12, 16, 20, 24, 32, 48, 64 };
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * Helper function to find the closest valid CAN DL of a payload
+ */
+inline static cbus_dl_t bus_closest_dl(uint16_t size, cbus_fr_format fr_fmt)
+{
+	if (size <= 8U)
+	{
+		return (cbus_dl_t)size;
+	}
+	if (fr_fmt == CBUS_FR_FRM_STD)
+	{
+		return 8U;
+	}
+#ifdef I15765_CANXL
+	if (fr_fmt == CBUS_FR_FRM_XL)
+	{
+		return (cbus_dl_t)(size <= I15765_MAX_DL ? size : I15765_MAX_DL);
+	}
+#endif
+	for (uint8_t i = 0; i < sizeof(fd_dls); i++)
+	{
+		if (size <= fd_dls[i])
+		{
+			return fd_dls[i];
+		}
+	}
+	return 64U;
+}
+
+/*
+ * Helper function to convert bits to ns for the given bitrate
+ */
+inline static uint64_t bus_bits_ns(uint32_t bits, uint32_t bitrate)
+{
+	return bitrate == 0U ? 0U : ((uint64_t)bits * 1000000000ULL + bitrate - 1U) / bitrate;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Number of bits of a frame on the wire, including the worst-case dynamic stuff
+ * bits and the interframe space. For CAN FD frames the bits between the BRS and
+ * the CRC delimiter (stuff count, FD CRC and its fixed stuff bits included) are
+ * counted as data phase bits. CAN XL frames have an 11 bits priority ID (a 29 bits
+ * ID is carried in the acceptance field) and fixed stuff bits in the data phase.
+ */
+n_frame_bits_t iso15765_frame_bits(cbus_id_type id_type, cbus_fr_format fr_fmt, cbus_dl_t dlc)
+{
+	n_frame_bits_t bits;
+	uint32_t data = 8U * (uint32_t)dlc;
+
+	if (fr_fmt == CBUS_FR_FRM_STD)
+	{
+		/* SOF, arbitration, control, data and CRC are subject to stuffing.
+		* base: 1+11+1+1+1+4 extended: 1+11+1+1+18+1+1+1+4, CRC: 15 */
+		uint32_t stuffed = (id_type == CBUS_ID_T_STANDARD ? 19U : 39U) + data + 15U;
+		/* CRC delimiter(1), ACK(2), EOF(7), IFS(3) */
+		bits.nom_bits = (uint16_t)(stuffed + (stuffed - 1U) / 4U + 13U);
+		bits.dat_bits = 0;
+	}
+#ifdef I15765_CANXL
+	else if (fr_fmt == CBUS_FR_FRM_XL)
+	{
+		/* SOF, priority ID, RRS, IDE, FDF, XLF, resXLF, ADH (stuffed dynamically) */
+		uint32_t arb = 18U;
+		/* SDT(8), SEC(1), DLC(11), SBC(3), PCRC(13), VCID(8), AF(32), data, FCRC(32),
+		* FCP(4) with a fixed stuff bit every 10 bits */
+		uint32_t ctl = 112U + data;
+
+		/* ADS(4), DAS(4), ACK(2), EOF(7), IFS(3) */
+		bits.nom_bits = (uint16_t)(arb + arb / 4U + 20U);
+		bits.dat_bits = (uint16_t)(ctl + ctl / 10U);
+		ISO_15675_UNUSED(id_type);
+	}
+#endif
+	else
+	{
+		/* SOF, ID, RRS/SRR, IDE, FDF, res, BRS */
+		uint32_t arb = (id_type == CBUS_ID_T_STANDARD ? 17U : 36U);
+		/* ESI, DLC and data are stuffed dynamically */
+		uint32_t ctl = 1U + 4U + data;
+		/* stuff count(4), CRC(17/21), fixed stuff bits(6/7) and CRC delimiter(1) */
+		uint32_t crc = dlc <= 16U ? (4U + 17U + 6U + 1U) : (4U + 21U + 7U + 1U);
+
+		/* ACK(2), EOF(7), IFS(3) */
+		bits.nom_bits = (uint16_t)(arb + arb / 4U + 12U);
+		bits.dat_bits = (uint16_t)(ctl + ctl / 4U + crc);
+	}
+	return bits;
+}
+
+/*
+ * Time on the wire (ns) of a single frame with the given bit timing
+ */
+uint32_t iso15765_frame_ns(const n_bus_cfg_t* bus, cbus_id_type id_type, cbus_fr_format fr_fmt, cbus_dl_t dlc)
+{
+	if (bus == NULL || bus->nbr == 0U)
+	{
+		return 0;
+	}
+
+	n_frame_bits_t bits = iso15765_frame_bits(id_type, fr_fmt, dlc);
+	uint32_t dbr = (fr_fmt != CBUS_FR_FRM_STD && bus->dbr != 0U) ? bus->dbr : bus->nbr;
+
+	return (uint32_t)(bus_bits_ns(bits.nom_bits, bus->nbr) + bus_bits_ns(bits.dat_bits, dbr));
+}
+
+/*
+ * Total time on the wire (ns) of a message segmented with the given frame
+ * format and CAN DL (of the FF/CFs). Segmented messages include one FlowControl
+ * of the receiver.
+ */
+uint32_t iso15765_msg_ns(const n_bus_cfg_t* bus, addr_md address, cbus_id_type id_type,
+	cbus_fr_format fr_fmt, cbus_dl_t tx_dl, uint16_t msg_sz)
+{
+	uint8_t offs = (address & 0x01);
+	uint16_t sf_max = tx_dl <= 8U ? (uint16_t)(7U - offs) : (uint16_t)(tx_dl - 2U - offs);
+
+#ifdef I15765_CANXL
+	/* the SF_DL of the escape sequence is a single byte and the FF of a
+	* message shorter than the CAN DL is shortened (see the engine) */
+	sf_max = sf_max > 0xFFU ? 0xFFU : sf_max;
+	if (fr_fmt == CBUS_FR_FRM_XL && msg_sz > sf_max && msg_sz < tx_dl)
+	{
+		tx_dl = (cbus_dl_t)msg_sz;
+	}
+#endif
+
+	if (msg_sz <= sf_max)
+	{
+		uint8_t pci = msg_sz <= (uint16_t)(7U - offs) ? 1U : 2U;
+		return iso15765_frame_ns(bus, id_type, fr_fmt, bus_closest_dl(offs + pci + msg_sz, fr_fmt));
+	}
+
+	uint16_t cf_pl = (uint16_t)(tx_dl - 1U - offs);
+	uint16_t rem = (uint16_t)(msg_sz - (tx_dl - 2U - offs));
+	uint32_t full = rem / cf_pl;
+	uint16_t last = (uint16_t)(rem % cf_pl);
+
+	uint32_t ns = iso15765_frame_ns(bus, id_type, fr_fmt, tx_dl);
+	ns += full * iso15765_frame_ns(bus, id_type, fr_fmt, tx_dl);
+	if (last != 0U)
+	{
+		ns += iso15765_frame_ns(bus, id_type, fr_fmt, bus_closest_dl(offs + 1U + last, fr_fmt));
+	}
+	ns += iso15765_frame_ns(bus, id_type, fr_fmt, (cbus_dl_t)(offs + 3U));
+	return ns;
+}
+
+/*
+ * Find the frame format and CAN DL which minimize the bus time of a message.
+ * A CAN FD request may use any CAN DL or fall back to classic frames, while a
+ * classic request keeps the classic format (the receiver may not support FD).
+ */
+n_rslt iso15765_best_layout(const n_bus_cfg_t* bus, addr_md address, cbus_id_type id_type,
+	uint16_t msg_sz, cbus_fr_format* fr_fmt, cbus_dl_t* tx_dl)
+{
+	if (bus == NULL || fr_fmt == NULL || tx_dl == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (bus->nbr == 0U || msg_sz == 0U)
+	{
+		return N_WRG_VALUE;
+	}
+
+	cbus_fr_format best_fmt = CBUS_FR_FRM_STD;
+	uint8_t best_dl = 8U;
+	uint32_t best_ns = iso15765_msg_ns(bus, address, id_type, CBUS_FR_FRM_STD, 8U, msg_sz);
+
+	if (*fr_fmt == CBUS_FR_FRM_FD)
+	{
+		for (uint8_t i = 0; i < sizeof(fd_dls); i++)
+		{
+			uint32_t ns = iso15765_msg_ns(bus, address, id_type, CBUS_FR_FRM_FD, fd_dls[i], msg_sz);
+			if (ns < best_ns)
+			{
+				best_ns = ns;
+				best_fmt = CBUS_FR_FRM_FD;
+				best_dl = fd_dls[i];
+			}
+		}
+	}
+
+	*fr_fmt = best_fmt;
+	*tx_dl = best_dl;
+	return N_OK;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,71 @@
+/*!
+@file   lib_iso15765_bus.h
+@brief  Header file of the CANBus bus-load model of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_BUS_H_
+#define DEVCOONS_ISO15765_2_BUS_H_
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+/* --- On-wire size of a frame (worst-case bit stuffing) ------------------- */
+
+typedef struct
+{
+	uint16_t nom_bits;	/* Bits transmitted with the nominal bitrate (incl. IFS) */
+	uint16_t dat_bits;	/* Bits transmitted with the data bitrate (CAN FD/XL data phase) */
+}n_frame_bits_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+n_frame_bits_t iso15765_frame_bits(cbus_id_type id_type, cbus_fr_format fr_fmt, cbus_dl_t dlc);
+
+uint32_t iso15765_frame_ns(const n_bus_cfg_t* bus, cbus_id_type id_type, cbus_fr_format fr_fmt, cbus_dl_t dlc);
+
+uint32_t iso15765_msg_ns(const n_bus_cfg_t* bus, addr_md address, cbus_id_type id_type,
+	cbus_fr_format fr_fmt, cbus_dl_t tx_dl, uint16_t msg_sz);
+
+n_rslt iso15765_best_layout(const n_bus_cfg_t* bus, addr_md address, cbus_id_type id_type,
+	uint16_t msg_sz, cbus_fr_format* fr_fmt, cbus_dl_t* tx_dl);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
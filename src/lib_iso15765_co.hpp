@@ -0,0 +1,474 @@
+/*!
+@file   lib_iso15765_co.hpp
+@brief  Header-only C++20 coroutine layer of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_CO_HPP_
+#define DEVCOONS_ISO15765_2_CO_HPP_
+
+#ifndef I15765_CO_BACKLOG
+#define I15765_CO_BACKLOG	4	/* No. of received messages kept while no receiver waits */
+#endif
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "lib_iso15765.hpp"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+namespace iso15765::co
+{
+
+class executor;
+
+/* --- Task ---------------------------------------------------------------- */
+
+template<typename T = void>
+class task;
+
+namespace detail
+{
+
+struct promise_base
+{
+	std::coroutine_handle<> cont;	/* Awaiting coroutine (nested tasks) */
+	executor* ex = nullptr;		/* Owner executor (spawned tasks) */
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template<typename T>
+struct promise_value : promise_base
+{
+	T value{};
+	void return_value(T v) { value = std::move(v); }
+	T take() { return std::move(value); }
+};
+
+template<>
+struct promise_value<void> : promise_base
+{
+	void return_void() noexcept {}
+	void take() noexcept {}
+};
+
+} /* namespace detail */
+
+/* --- Single-threaded executor  ------------------------------------------- */
+
+class executor
+{
+public:
+	/* Schedule a coroutine to be resumed during the next 'run_once' */
+	void post(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+	/* Register a poll function (e.g. the process of a channel) */
+	void attach(std::function<void()> poll) { polls_.push_back(std::move(poll)); }
+
+	/* Start a task. The executor takes its ownership */
+	template<typename T>
+	void spawn(task<T>&& t);
+
+	/* Poll every attached channel once and resume every ready coroutine */
+	void run_once()
+	{
+		for (auto& poll : polls_)
+		{
+			poll();
+		}
+		while (!ready_.empty())
+		{
+			std::coroutine_handle<> h = ready_.front();
+			ready_.pop_front();
+			h.resume();
+		}
+	}
+
+	/* No. of spawned tasks which are not finished yet */
+	std::size_t live() const noexcept { return live_; }
+
+	void task_done() noexcept { live_--; }
+
+private:
+	std::deque<std::coroutine_handle<>> ready_;
+	std::vector<std::function<void()>> polls_;
+	std::size_t live_ = 0;
+};
+
+template<typename T>
+class task
+{
+public:
+	struct promise_type : detail::promise_value<T>
+	{
+		task get_return_object() noexcept
+		{
+			return task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		struct final_awaiter
+		{
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+			{
+				promise_type& p = h.promise();
+				if (p.cont)
+				{
+					return p.cont;
+				}
+				if (p.ex != nullptr)
+				{
+					/* spawned (detached) task: release the frame */
+					executor* ex = p.ex;
+					h.destroy();
+					ex->task_done();
+				}
+				return std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+
+		final_awaiter final_suspend() noexcept { return {}; }
+	};
+
+	task(task&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+	task(const task&) = delete;
+	task& operator=(const task&) = delete;
+
+	~task()
+	{
+		if (h_)
+		{
+			h_.destroy();
+		}
+	}
+
+	/* Nested await: start the task and resume the caller when it finishes */
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept
+	{
+		h_.promise().cont = caller;
+		return h_;
+	}
+	T await_resume() { return h_.promise().take(); }
+
+private:
+	friend class executor;
+	explicit task(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+	std::coroutine_handle<promise_type> release() noexcept { return std::exchange(h_, {}); }
+
+	std::coroutine_handle<promise_type> h_;
+};
+
+template<typename T>
+void executor::spawn(task<T>&& t)
+{
+	auto h = t.release();
+	h.promise().ex = this;
+	live_++;
+	post(h);
+}
+
+/* --- Reception filter & message ------------------------------------------ */
+
+struct rx_filter
+{
+	int16_t n_sa = -1;	/* Source address to match (-1: any) */
+	int16_t n_ta = -1;	/* Target address to match (-1: any) */
+	int16_t n_ae = -1;	/* Address extension to match (-1: any) */
+
+	bool match(const n_ai_t& ai) const noexcept
+	{
+		return (n_sa < 0 || n_sa == ai.n_sa)
+			&& (n_ta < 0 || n_ta == ai.n_ta)
+			&& (n_ae < 0 || n_ae == ai.n_ae);
+	}
+};
+
+struct message
+{
+	n_ai_t n_ai{};			/* Address information */
+	n_rslt rslt = N_OK;		/* Result of the reception */
+	std::vector<std::uint8_t> data;	/* Copy of the received message */
+};
+
+/* --- Asynchronous channel  ----------------------------------------------- */
+
+template<AddrMode M, FrameFormat F, std::uint16_t MaxMsg = I15765_MSG_SIZE>
+class async_channel
+{
+public:
+	using channel_t = Channel<M, F, MaxMsg>;
+
+	/* Awaiters are stored in the coroutine frame and linked in intrusive
+	 * lists, a waiting conversation costs no allocation */
+	struct send_awaiter
+	{
+		async_channel* ch;
+		n_ai_t ai;
+		span<const std::uint8_t> msg;
+		std::coroutine_handle<> h;
+		n_rslt rslt = N_OK;
+		send_awaiter* next = nullptr;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> caller) { h = caller; ch->push_send(this); }
+		n_rslt await_resume() const noexcept { return rslt; }
+	};
+
+	struct receive_awaiter
+	{
+		async_channel* ch;
+		rx_filter filter;
+		uint32_t timeout_ms;
+		uint32_t start = 0;
+		std::coroutine_handle<> h;
+		message msg;
+		receive_awaiter* next = nullptr;
+
+		bool await_ready() { return ch->take_backlog(*this); }
+		void await_suspend(std::coroutine_handle<> caller)
+		{
+			h = caller;
+			start = ch->get_ms_();
+			ch->push_receive(this);
+		}
+		message await_resume() { return std::move(msg); }
+	};
+
+	async_channel(executor& ex, typename channel_t::send_fn send, typename channel_t::time_fn get_ms,
+		const n_config_t& config)
+		: ex_(ex), get_ms_(get_ms), ch_(std::move(send), std::move(get_ms), config)
+	{
+		ch_.on_indication([this](const n_ai_t& ai, n_rslt rslt, span<const std::uint8_t> msg)
+		{
+			on_indication(ai, rslt, msg);
+		});
+		/* every end of the outbound message is confirmed (N_OK, N_TIMEOUT_Bs,
+		 * FlowControl errors): errors of the receptions do not complete a send */
+		ch_.on_confirm([this](const n_ai_t&, n_rslt rslt)
+		{
+			complete_send(rslt);
+		});
+		ex_.attach([this]() { poll(); });
+	}
+
+	async_channel(const async_channel&) = delete;
+	async_channel& operator=(const async_channel&) = delete;
+
+	channel_t& channel() noexcept { return ch_; }
+
+	/* co_await ch.send(ai, buf) -> n_rslt (confirmation of the transmission).
+	 * The buffer must stay valid until the awaiter resumes */
+	send_awaiter send(const n_ai_t& ai, span<const std::uint8_t> msg)
+	{
+		return send_awaiter{ this, ai, msg, {}, N_OK, nullptr };
+	}
+
+	/* co_await ch.receive(filter, timeout) -> message. A timeout of 0 waits forever
+	 * and an expired wait returns a message with rslt N_TIMEOUT_A */
+	receive_awaiter receive(rx_filter filter = {}, uint32_t timeout_ms = 0)
+	{
+		return receive_awaiter{ this, filter, timeout_ms, 0, {}, {}, nullptr };
+	}
+
+	/* Indications which were dropped because no receiver matched */
+	std::size_t dropped() const noexcept { return dropped_; }
+
+private:
+	void push_send(send_awaiter* w)
+	{
+		if (stail_ == nullptr)
+		{
+			shead_ = w;
+		}
+		else
+		{
+			stail_->next = w;
+		}
+		stail_ = w;
+	}
+
+	void push_receive(receive_awaiter* w)
+	{
+		if (rtail_ == nullptr)
+		{
+			rhead_ = w;
+		}
+		else
+		{
+			rtail_->next = w;
+		}
+		rtail_ = w;
+	}
+
+	bool take_backlog(receive_awaiter& w)
+	{
+		for (auto it = backlog_.begin(); it != backlog_.end(); ++it)
+		{
+			if (w.filter.match(it->n_ai))
+			{
+				w.msg = std::move(*it);
+				backlog_.erase(it);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void complete_send(n_rslt rslt)
+	{
+		if (inflight_ != nullptr)
+		{
+			inflight_->rslt = rslt;
+			ex_.post(inflight_->h);
+			inflight_ = nullptr;
+		}
+	}
+
+	void on_indication(const n_ai_t& ai, n_rslt rslt, span<const std::uint8_t> data)
+	{
+		message msg;
+		msg.n_ai = ai;
+		msg.rslt = rslt;
+		msg.data.assign(data.begin(), data.end());
+
+		receive_awaiter* prev = nullptr;
+		for (receive_awaiter* w = rhead_; w != nullptr; prev = w, w = w->next)
+		{
+			if (w->filter.match(ai))
+			{
+				unlink(prev, w);
+				w->msg = std::move(msg);
+				ex_.post(w->h);
+				return;
+			}
+		}
+
+		if (backlog_.size() >= I15765_CO_BACKLOG)
+		{
+			backlog_.pop_front();
+			dropped_++;
+		}
+		backlog_.push_back(std::move(msg));
+	}
+
+	void unlink(receive_awaiter* prev, receive_awaiter* w)
+	{
+		if (prev == nullptr)
+		{
+			rhead_ = w->next;
+		}
+		else
+		{
+			prev->next = w->next;
+		}
+		if (rtail_ == w)
+		{
+			rtail_ = prev;
+		}
+		w->next = nullptr;
+	}
+
+	void poll()
+	{
+		ch_.process();
+
+		/* start the next pending transmission */
+		while (inflight_ == nullptr && shead_ != nullptr)
+		{
+			send_awaiter* w = shead_;
+			if (!ch_.tx_idle())
+			{
+				break;
+			}
+			shead_ = w->next;
+			if (shead_ == nullptr)
+			{
+				stail_ = nullptr;
+			}
+			inflight_ = w;
+			n_rslt rslt = ch_.send(w->ai, w->msg);
+			if (rslt != N_OK && inflight_ == w)
+			{
+				complete_send(rslt);
+			}
+		}
+
+		/* expire the receivers which waited too long */
+		uint32_t now = get_ms_();
+		receive_awaiter* prev = nullptr;
+		for (receive_awaiter* w = rhead_; w != nullptr;)
+		{
+			receive_awaiter* next = w->next;
+			if (w->timeout_ms != 0 && (uint32_t)(now - w->start) >= w->timeout_ms)
+			{
+				unlink(prev, w);
+				w->msg.rslt = N_TIMEOUT_A;
+				ex_.post(w->h);
+			}
+			else
+			{
+				prev = w;
+			}
+			w = next;
+		}
+	}
+
+	executor& ex_;
+	typename channel_t::time_fn get_ms_;
+	channel_t ch_;
+	send_awaiter* shead_ = nullptr;
+	send_awaiter* stail_ = nullptr;
+	send_awaiter* inflight_ = nullptr;
+	receive_awaiter* rhead_ = nullptr;
+	receive_awaiter* rtail_ = nullptr;
+	std::deque<message> backlog_;
+	std::size_t dropped_ = 0;
+};
+
+} /* namespace iso15765::co */
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
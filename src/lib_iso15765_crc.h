@@ -0,0 +1,61 @@
+/*!
+@file   lib_iso15765_crc.h
+@brief  Header file of the CRC-32/CRC-32C digests of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+CRC-32 (IEEE 802.3, zlib) and CRC-32C (Castagnoli, iSCSI) of a byte stream.
+The digest of a message is computed in parts by passing the result of the
+previous part (0 for the first one), e.g. crc = iso15765_crc32(0, a, 4);
+crc = iso15765_crc32(crc, b, 8) is the CRC-32 of the 12 bytes a|b.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_CRC_H_
+#define DEVCOONS_ISO15765_2_CRC_H_
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include <stddef.h>
+#include "lib_iso15765.h"
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+uint32_t iso15765_crc32(uint32_t crc, const uint8_t* dt, size_t sz);
+
+uint32_t iso15765_crc32c(uint32_t crc, const uint8_t* dt, size_t sz);
+
+uint32_t iso15765_digest(n_digest digest, uint32_t crc, const uint8_t* dt, size_t sz);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
@@ -0,0 +1,451 @@
+/*!
+@file   lib_iso15765_dec.c
+@brief  Source file of the ISO15765-2 offline trace decoder
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define DEC_RUN		32	/* Max. ConsecutiveFrames checked at once by the batch stage */
+
+#if !defined(I15765_NO_SIMD)
+#if defined(__AVX2__)
+#define DEC_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DEC_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DEC_SIMD_NEON
+#endif
+#endif
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include "lib_iso15765_dec.h"
+
+#if defined(DEC_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(DEC_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(DEC_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/* PCI bytes of an in-order CF run: dec_cf_pci[sn + k] is the PCI of the k-th CF */
+static const uint8_t dec_cf_pci[16 + DEC_RUN] = {
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+};
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * Index of the lowest set bit (v != 0)
+ */
+inline static uint32_t dec_ctz(uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return (uint32_t)__builtin_ctzll(v);
+#else
+	uint32_t n = 0;
+	while ((v & 1U) == 0)
+	{
+		v >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
+/*
+ * Length of the in-order ConsecutiveFrame run of the gathered PCI bytes: the
+ * bytes are classified (CF) and their SequenceNumbers checked in one compare
+ * with the expected sequence starting at 'sn'. 'pci' holds DEC_RUN bytes.
+ */
+inline static uint32_t dec_cf_run(const uint8_t* pci, uint32_t n, uint8_t sn)
+{
+	const uint8_t* exp = &dec_cf_pci[sn & 0x0FU];
+	uint32_t run;
+
+#if defined(DEC_SIMD_AVX2)
+	__m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)pci), _mm256_loadu_si256((const __m256i*)exp));
+	uint64_t ne = ~(uint64_t)(uint32_t)_mm256_movemask_epi8(eq);
+	run = dec_ctz(ne);
+#elif defined(DEC_SIMD_SSE2)
+	uint32_t lo = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)pci), _mm_loadu_si128((const __m128i*)exp)));
+	uint32_t hi = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&pci[16]), _mm_loadu_si128((const __m128i*)&exp[16])));
+	run = dec_ctz(~((uint64_t)hi << 16 | lo));
+#elif defined(DEC_SIMD_NEON)
+	uint8x16_t e0 = vceqq_u8(vld1q_u8(pci), vld1q_u8(exp));
+	uint8x16_t e1 = vceqq_u8(vld1q_u8(&pci[16]), vld1q_u8(&exp[16]));
+	/* narrow the compare results to 4 bits per byte */
+	uint64_t m0 = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(e0), 4)), 0);
+	uint64_t m1 = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(e1), 4)), 0);
+	run = m0 != ~0ULL ? dec_ctz(~m0) / 4U : 16U + (m1 != ~0ULL ? dec_ctz(~m1) / 4U : 16U);
+#else
+	for (run = 0; run < n && pci[run] == exp[run]; run++);
+#endif
+	return run < n ? run : n;
+}
+
+/*
+ * Addressing tuple of a PDU (source, target, target type and extension)
+ */
+inline static uint32_t dec_key(const n_ai_t* n_ai)
+{
+	return 0x80000000U | ((uint32_t)(n_ai->n_tt & 0x03U) << 24)
+		| ((uint32_t)n_ai->n_ae << 16) | ((uint32_t)n_ai->n_ta << 8) | n_ai->n_sa;
+}
+
+/*
+ * Find (or allocate) the stream of an addressing tuple. The slots are never
+ * released, the number of tuples of a trace is small.
+ */
+static n_dec_strm_t* dec_stream(iso15765_dec_t* dec, uint32_t key)
+{
+	uint32_t i = (key * 2654435761U) & dec->mask;
+
+	for (uint32_t n = 0; n <= dec->mask; n++)
+	{
+		n_dec_strm_t* s = &dec->strm[i];
+		if (s->key == key)
+		{
+			return s;
+		}
+		if (s->key == 0)
+		{
+			s->key = key;
+			s->active = 0;
+			return s;
+		}
+		i = (i + 1U) & dec->mask;
+	}
+	return NULL;
+}
+
+/*
+ * Report a message of a stream and release the stream
+ */
+static void dec_emit(iso15765_dec_t* dec, n_dec_strm_t* s, const uint8_t* msg, uint16_t msg_sz, n_rslt rslt)
+{
+	n_dec_msg_t m;
+
+	if (rslt == N_OK)
+	{
+		dec->msgs++;
+	}
+	else
+	{
+		dec->errors++;
+	}
+
+	if (dec->on_msg != NULL)
+	{
+		m.ts_first = s->ts_first;
+		m.ts_last = s->ts_last;
+		memmove(&m.n_ai, &s->n_ai, sizeof(n_ai_t));
+		m.fr_fmt = s->fr_fmt;
+		m.rslt = rslt;
+		m.msg_sz = msg_sz;
+		m.msg = msg;
+		dec->on_msg(dec->ctx, &m);
+	}
+	s->active = 0;
+}
+
+/*
+ * Decode a frame and return the stream it belongs to (if any)
+ */
+static n_rslt dec_push(iso15765_dec_t* dec, uint64_t ts, const canbus_frame_t* frame, n_dec_strm_t** strm)
+{
+	n_pdu_t pdu;
+
+	*strm = NULL;
+	dec->frames++;
+	if (iso15765_frame_decode(dec->addr_md, frame, &pdu) != N_OK)
+	{
+		dec->errors++;
+		return N_INV_PDU;
+	}
+
+	if (pdu.n_pci.pt == N_PCI_T_FC)
+	{
+		return N_OK;
+	}
+
+	n_dec_strm_t* s = dec_stream(dec, dec_key(&pdu.n_ai));
+	if (s == NULL)
+	{
+		dec->overflow++;
+		return N_OVFLW;
+	}
+	*strm = s;
+
+	/* the gap since the last frame exceeds N_Cr: the message is incomplete */
+	if (s->active != 0 && dec->n_cr != 0 && ts - s->ts_last > dec->n_cr)
+	{
+		dec_emit(dec, s, s->msg, s->msg_pos, N_TIMEOUT_Cr);
+	}
+
+	switch (pdu.n_pci.pt)
+	{
+	case N_PCI_T_SF:
+	case N_PCI_T_FF:
+		/* a new message interrupts the one in progress */
+		if (s->active != 0)
+		{
+			dec_emit(dec, s, s->msg, s->msg_pos, N_UNE_PDU);
+		}
+		memmove(&s->n_ai, &pdu.n_ai, sizeof(n_ai_t));
+		s->fr_fmt = (uint8_t)frame->fr_format;
+		s->ts_first = ts;
+		s->ts_last = ts;
+		if (pdu.n_pci.pt == N_PCI_T_SF)
+		{
+			dec_emit(dec, s, pdu.dt, pdu.n_pci.dl, N_OK);
+			return N_OK;
+		}
+		if (pdu.n_pci.dl > I15765_DEC_MSG_SIZE || pdu.sz > pdu.n_pci.dl)
+		{
+			dec->errors++;
+			return N_INV_REQ_SZ;
+		}
+		memmove(s->msg, pdu.dt, pdu.sz);
+		s->msg_sz = pdu.n_pci.dl;
+		s->msg_pos = pdu.sz;
+		s->sn = 1;
+		s->active = 1;
+		return N_OK;
+
+	case N_PCI_T_CF:
+		if (s->active == 0)
+		{
+			dec->errors++;
+			return N_UNE_CF;
+		}
+		s->ts_last = ts;
+		if (pdu.n_pci.sn != s->sn)
+		{
+			dec_emit(dec, s, s->msg, s->msg_pos, N_WRG_SN);
+			return N_INV_SEQ_NUM;
+		}
+		s->sn = (s->sn + 1U) & 0x0FU;
+
+		/* the last CF may be padded */
+		uint16_t sz = (uint16_t)(s->msg_sz - s->msg_pos);
+		sz = pdu.sz < sz ? pdu.sz : sz;
+		memmove(&s->msg[s->msg_pos], pdu.dt, sz);
+		s->msg_pos += sz;
+		if (s->msg_pos >= s->msg_sz)
+		{
+			dec_emit(dec, s, s->msg, s->msg_sz, N_OK);
+		}
+		return N_OK;
+
+	default:
+		break;
+	}
+	return N_INV_PDU;
+}
+
+/*
+ * Fast path of the batch stage: consume the in-order ConsecutiveFrames of the
+ * stream 's' starting at 'frames[0]' which do not complete the message. The
+ * PCI bytes of the frames of the same CAN Id (and N_TA/N_AE byte) are gathered
+ * and checked at once. Returns the number of consumed frames.
+ */
+static uint32_t dec_cf_fast(iso15765_dec_t* dec, n_dec_strm_t* s, const uint64_t* ts,
+	const canbus_frame_t* frames, uint32_t cnt)
+{
+	uint8_t offs = (uint8_t)(dec->addr_md & 0x01);
+	uint8_t pci[DEC_RUN];
+	uint32_t n = 0;
+	uint16_t dlc = frames[0].dlc;
+	uint32_t id = frames[0].id;
+
+	if (dlc < 2U + offs || dlc > sizeof(frames[0].dt))
+	{
+		return 0;
+	}
+
+	/* gather: frames of the stream with the same CAN DL */
+	cnt = cnt < DEC_RUN ? cnt : DEC_RUN;
+	while (n < cnt && frames[n].id == id && frames[n].dlc == dlc
+		&& (offs == 0 || frames[n].dt[0] == frames[0].dt[0]))
+	{
+		pci[n] = frames[n].dt[offs];
+		n++;
+	}
+	memset(&pci[n], 0, DEC_RUN - n);
+
+	n = dec_cf_run(pci, n, s->sn);
+
+	/* the frame completing the message takes the common path */
+	uint16_t pl = (uint16_t)(dlc - 1U - offs);
+	uint32_t left = (uint32_t)(s->msg_sz - s->msg_pos - 1U) / pl;
+	n = n < left ? n : left;
+
+	uint64_t last = s->ts_last;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (dec->n_cr != 0 && ts[i] - last > dec->n_cr)
+		{
+			n = i;
+			break;
+		}
+		last = ts[i];
+		memcpy(&s->msg[s->msg_pos], &frames[i].dt[1U + offs], pl);
+		s->msg_pos += pl;
+	}
+	s->ts_last = last;
+	s->sn = (uint8_t)((s->sn + n) & 0x0FU);
+	dec->frames += n;
+	return n;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Initialize a decoder using the caller provided stream table. The number of
+ * slots must be a power of two, larger than the addressing tuples of the trace.
+ */
+n_rslt iso15765_dec_init(iso15765_dec_t* dec, addr_md address, n_dec_strm_t* storage, uint32_t elms)
+{
+	if (dec == NULL || storage == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (elms == 0 || (elms & (elms - 1U)) != 0)
+	{
+		return N_WRG_VALUE;
+	}
+
+	for (uint32_t i = 0; i < elms; i++)
+	{
+		storage[i].key = 0;
+		storage[i].active = 0;
+	}
+	dec->addr_md = address;
+	dec->strm = storage;
+	dec->mask = elms - 1U;
+	dec->frames = 0;
+	dec->msgs = 0;
+	dec->errors = 0;
+	dec->overflow = 0;
+	return N_OK;
+}
+
+/*
+ * Decode a recorded frame. The frames of each addressing tuple must be pushed
+ * in the order of the trace. FlowControl frames are ignored.
+ */
+n_rslt iso15765_dec_push(iso15765_dec_t* dec, uint64_t ts, const canbus_frame_t* frame)
+{
+	n_dec_strm_t* s;
+
+	if (dec == NULL || frame == NULL)
+	{
+		return N_NULL;
+	}
+	return dec_push(dec, ts, frame, &s);
+}
+
+/*
+ * Decode a batch of recorded frames (e.g. the frames read from a trace). The
+ * runs of in-order ConsecutiveFrames of a message are copied without decoding
+ * each frame; every other frame (SF, FF, FC, the last CF, errors) is decoded
+ * as by 'iso15765_dec_push'.
+ */
+n_rslt iso15765_dec_push_batch(iso15765_dec_t* dec, const uint64_t* ts, const canbus_frame_t* frames, uint32_t cnt)
+{
+	n_dec_strm_t* s = NULL;
+	uint32_t i = 0;
+
+	if (dec == NULL || ts == NULL || frames == NULL)
+	{
+		return N_NULL;
+	}
+
+	while (i < cnt)
+	{
+		/* continue the message of the previous frame */
+		if (s != NULL && s->active != 0 && frames[i].id == frames[i - 1U].id
+			&& ((dec->addr_md & 0x01) == 0 || frames[i].dt[0] == frames[i - 1U].dt[0]))
+		{
+			uint32_t n = dec_cf_fast(dec, s, &ts[i], &frames[i], cnt - i);
+			if (n != 0)
+			{
+				i += n;
+				continue;
+			}
+		}
+		dec_push(dec, ts[i], &frames[i], &s);
+		i++;
+	}
+	return N_OK;
+}
+
+/*
+ * Report the messages which are still in progress at the end of the trace
+ */
+n_rslt iso15765_dec_flush(iso15765_dec_t* dec)
+{
+	if (dec == NULL)
+	{
+		return N_NULL;
+	}
+
+	for (uint32_t i = 0; i <= dec->mask; i++)
+	{
+		n_dec_strm_t* s = &dec->strm[i];
+		if (s->key != 0 && s->active != 0)
+		{
+			dec_emit(dec, s, s->msg, s->msg_pos, N_TIMEOUT_Cr);
+		}
+	}
+	return N_OK;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,112 @@
+/*!
+@file   lib_iso15765_dec.h
+@brief  Header file of the ISO15765-2 offline trace decoder
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_DEC_H_
+#define DEVCOONS_ISO15765_2_DEC_H_
+
+#ifndef I15765_DEC_MSG_SIZE
+#define I15765_DEC_MSG_SIZE	4095	/* Max. size of a reassembled message */
+#endif
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+/* --- Reassembled message ------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint64_t ts_first;		/* Timestamp of the SF/FF (unit of the trace) */
+	uint64_t ts_last;		/* Timestamp of the last frame of the message */
+	n_ai_t n_ai;			/* Address information */
+	uint8_t fr_fmt;			/* CANBus frame format `cbus_fr_format` */
+	n_rslt rslt;			/* N_OK, or the reason the message is incomplete
+					 * (N_WRG_SN, N_UNE_PDU, N_TIMEOUT_Cr) */
+	uint16_t msg_sz;		/* Message size (received bytes if incomplete) */
+	const uint8_t* msg;		/* Message data. Valid during the callback */
+}n_dec_msg_t;
+
+/* --- Reassembly stream of one addressing tuple --------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint32_t key;			/* Addressing tuple of the stream (0: free slot) */
+	uint8_t active;			/* A segmented message is in progress */
+	uint8_t sn;			/* Expected SequenceNumber */
+	uint8_t fr_fmt;			/* CANBus frame format of the message */
+	n_ai_t n_ai;			/* Address information */
+	uint16_t msg_sz;		/* Size of the message (FF_DL) */
+	uint16_t msg_pos;		/* Received bytes */
+	uint64_t ts_first;		/* Timestamp of the FF */
+	uint64_t ts_last;		/* Timestamp of the last CF */
+	uint8_t msg[I15765_DEC_MSG_SIZE]; /* Message buffer */
+}n_dec_strm_t;
+
+/* --- Decoder handler ----------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	addr_md addr_md;		/* Addressing mode of the trace */
+	n_dec_strm_t* strm;		/* Caller provided storage, one slot per addressing tuple */
+	uint32_t mask;			/* No. of slots - 1 (No. of slots must be a power of two) */
+	uint64_t n_cr;			/* Optional. Max. gap between the frames of a message
+					 * (unit of the trace, 0: no timeout) */
+	void* ctx;			/* User context of 'on_msg' */
+	void (*on_msg)(void*, const n_dec_msg_t*); /* Reassembled (or interrupted) message */
+	uint64_t frames;		/* Decoded frames */
+	uint64_t msgs;			/* Complete messages */
+	uint64_t errors;		/* Interrupted messages and invalid frames */
+	uint64_t overflow;		/* Frames dropped because the stream table was full */
+}iso15765_dec_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+n_rslt iso15765_dec_init(iso15765_dec_t* dec, addr_md address, n_dec_strm_t* storage, uint32_t elms);
+
+n_rslt iso15765_dec_push(iso15765_dec_t* dec, uint64_t ts, const canbus_frame_t* frame);
+
+n_rslt iso15765_dec_push_batch(iso15765_dec_t* dec, const uint64_t* ts, const canbus_frame_t* frames, uint32_t cnt);
+
+n_rslt iso15765_dec_flush(iso15765_dec_t* dec);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
@@ -0,0 +1,417 @@
+/*!
+@file   lib_iso15765_flash.c
+@brief  Source file of the UDS block-transfer (flashing) pipeline of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define FL_SID_REQ_DL		0x34U	/* RequestDownload */
+#define FL_SID_TRANSFER		0x36U	/* TransferData */
+#define FL_SID_EXIT		0x37U	/* RequestTransferExit */
+#define FL_SID_NEG		0x7FU	/* Negative response */
+#define FL_NRC_PENDING		0x78U	/* requestCorrectlyReceived-ResponsePending */
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include "lib_iso15765_flash.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * Service Id of the request waiting for a response
+ */
+inline static uint8_t fl_sid(const iso15765_flash_t* fl)
+{
+	switch (fl->sts)
+	{
+	case N_FL_REQ_DL:
+		return FL_SID_REQ_DL;
+	case N_FL_TRANSFER:
+		return FL_SID_TRANSFER;
+	default:
+		return FL_SID_EXIT;
+	}
+}
+
+/*
+ * Transmit the request prepared in the staging buffer. The request is copied
+ * by the engine, so the buffer is free to stage the next block.
+ */
+static n_rslt fl_send(iso15765_flash_t* fl, uint16_t sz)
+{
+	memmove(&fl->stage.n_ai, &fl->n_ai, sizeof(n_ai_t));
+	fl->stage.fr_fmt = fl->fr_fmt;
+	fl->stage.msg_sz = sz;
+
+	if (iso15765_send(fl->ih, &fl->stage) != N_OK)
+	{
+		fl->sts = N_FL_ERR_TX;
+		return N_ERROR;
+	}
+	fl->tx_busy = 1;
+	fl->rsp_pend = 1;
+	fl->pending = 0;
+	fl->t_rsp = fl->ih->clbs.get_ms();
+	return N_OK;
+}
+
+/*
+ * Data bytes of the block which is staged
+ */
+inline static uint16_t fl_blk_target(const iso15765_flash_t* fl)
+{
+	uint32_t left = fl->size - (fl->staged - fl->stg_pos);
+	uint16_t max = (uint16_t)(fl->blk_len - 2U);
+
+	return left < max ? (uint16_t)left : max;
+}
+
+/*
+ * Read the next block from the provider (while the previous one is on the bus)
+ */
+static void fl_stage(iso15765_flash_t* fl)
+{
+	if (fl->sts != N_FL_TRANSFER || fl->staged >= fl->size)
+	{
+		return;
+	}
+
+	uint16_t target = fl_blk_target(fl);
+
+	while (fl->stg_pos < target)
+	{
+		uint16_t n = fl->read(fl->ctx, fl->staged, &fl->stage.msg[2U + fl->stg_pos], (uint16_t)(target - fl->stg_pos));
+		if (n == 0)
+		{
+			break;
+		}
+		n = n > target - fl->stg_pos ? (uint16_t)(target - fl->stg_pos) : n;
+		fl->staged += n;
+		fl->stg_pos += n;
+	}
+}
+
+/*
+ * The previous request was answered: send the staged block or the
+ * RequestTransferExit
+ */
+static void fl_next(iso15765_flash_t* fl)
+{
+	if (fl->acked >= fl->size)
+	{
+		fl->stage.msg[0] = FL_SID_EXIT;
+		fl->sts = N_FL_EXIT;
+		fl_send(fl, 1);
+		return;
+	}
+
+	uint16_t target = fl_blk_target(fl);
+
+	if (target == 0 || fl->stg_pos < target)
+	{
+		return;
+	}
+
+	fl->stage.msg[0] = FL_SID_TRANSFER;
+	fl->stage.msg[1] = (uint8_t)(fl->bsc + 1U);
+	if (fl_send(fl, (uint16_t)(2U + target)) == N_OK)
+	{
+		fl->bsc++;
+		fl->blk_dt = target;
+		fl->stg_pos = 0;
+	}
+}
+
+/*
+ * Handle a response of the ECU. Returns 0 if the message is not a response
+ * to the request in progress.
+ */
+static uint8_t fl_response(iso15765_flash_t* fl, const n_evt_t* evt)
+{
+	const uint8_t* msg = evt->msg;
+	uint8_t sid = fl_sid(fl);
+
+	if (evt->msg_sz >= 3U && msg[0] == FL_SID_NEG && msg[1] == sid)
+	{
+		if (msg[2] == FL_NRC_PENDING)
+		{
+			fl->pending = 1;
+			fl->t_rsp = fl->ih->clbs.get_ms();
+			return 1;
+		}
+		fl->nrc = msg[2];
+		fl->sts = N_FL_ERR_NRC;
+		fl->rsp_pend = 0;
+		return 1;
+	}
+
+	if (msg[0] != (uint8_t)(sid + 0x40U))
+	{
+		return 0;
+	}
+	fl->rsp_pend = 0;
+
+	switch (fl->sts)
+	{
+	case N_FL_REQ_DL:
+	{
+		/* lengthFormatIdentifier: size of maxNumberOfBlockLength */
+		uint8_t lfi = evt->msg_sz >= 2U ? (uint8_t)(msg[1] >> 4) : 0U;
+		uint32_t max = 0;
+
+		if (lfi == 0 || lfi > 4U || evt->msg_sz < 2U + lfi)
+		{
+			fl->sts = N_FL_ERR_RSP;
+			break;
+		}
+		for (uint8_t i = 0; i < lfi; i++)
+		{
+			max = (max << 8) | msg[2U + i];
+		}
+		max = max > I15765_MSG_SIZE ? I15765_MSG_SIZE : max;
+		max = (fl->max_blk != 0 && max > fl->max_blk) ? fl->max_blk : max;
+		if (max < 3U)
+		{
+			fl->sts = N_FL_ERR_RSP;
+			break;
+		}
+		fl->blk_len = (uint16_t)max;
+		fl->sts = N_FL_TRANSFER;
+		fl->t_start = fl->ih->clbs.get_ms();
+		fl->t_last = fl->t_start;
+		break;
+	}
+	case N_FL_TRANSFER:
+		if (evt->msg_sz < 2U || msg[1] != fl->bsc)
+		{
+			fl->sts = N_FL_ERR_RSP;
+			break;
+		}
+		fl->acked += fl->blk_dt;
+		fl->t_last = fl->ih->clbs.get_ms();
+		break;
+	default:
+		fl->sts = N_FL_DONE;
+		break;
+	}
+	return 1;
+}
+
+/*
+ * Consume the events of the handler
+ */
+static void fl_handle_events(iso15765_flash_t* fl)
+{
+	n_evt_t evt;
+
+	while (iso15765_evtq_pop(fl->ih->evtq, &evt) == N_OK)
+	{
+		uint8_t busy = fl->sts >= N_FL_REQ_DL && fl->sts <= N_FL_EXIT;
+
+		if (busy && evt.tp == N_CONF && fl->tx_busy != 0)
+		{
+			fl->tx_busy = 0;
+			if (evt.rslt != N_OK)
+			{
+				fl->sts = N_FL_ERR_TX;
+			}
+			/* P2 starts with the end of the request */
+			fl->t_rsp = fl->ih->clbs.get_ms();
+			continue;
+		}
+		if (busy && evt.tp == N_INDN && evt.rslt == N_OK && evt.msg_sz != 0 && fl->rsp_pend != 0
+			&& evt.n_ai.n_sa == fl->n_ai.n_ta && fl_response(fl, &evt) != 0)
+		{
+			iso15765_rx_release(fl->ih, evt.msg);
+			continue;
+		}
+		if (fl->on_event != NULL)
+		{
+			fl->on_event(&evt);
+		}
+		else if (evt.tp == N_INDN && evt.msg != NULL)
+		{
+			iso15765_rx_release(fl->ih, evt.msg);
+		}
+	}
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Validate the configuration of the pipeline. The handler must be already
+ * initialized and have an event queue assigned.
+ */
+n_rslt iso15765_flash_init(iso15765_flash_t* fl)
+{
+	if (fl == NULL || fl->ih == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (fl->ih->init_sts != N_OK)
+	{
+		return N_ERROR;
+	}
+
+	if (fl->ih->evtq == NULL || fl->read == NULL)
+	{
+		return N_MISSING_CLB;
+	}
+
+#ifdef I15765_CANXL
+	if (fl->fr_fmt != CBUS_FR_FRM_FD && fl->fr_fmt != CBUS_FR_FRM_XL)
+#else
+	if (fl->fr_fmt != CBUS_FR_FRM_FD)
+#endif
+	{
+		fl->fr_fmt = CBUS_FR_FRM_STD;
+	}
+	fl->p2_ms = fl->p2_ms == 0 ? I15765_FL_P2_MS : fl->p2_ms;
+	fl->p2x_ms = fl->p2x_ms == 0 ? I15765_FL_P2X_MS : fl->p2x_ms;
+	fl->sts = N_FL_IDLE;
+	return N_OK;
+}
+
+/*
+ * Start the download of the image with a RequestDownload
+ */
+n_rslt iso15765_flash_start(iso15765_flash_t* fl)
+{
+	if (fl == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (fl->sts >= N_FL_REQ_DL && fl->sts <= N_FL_EXIT)
+	{
+		return N_TX_BUSY;
+	}
+
+	fl->nrc = 0;
+	fl->bsc = 0;
+	fl->tx_busy = 0;
+	fl->rsp_pend = 0;
+	fl->blk_dt = 0;
+	fl->acked = 0;
+	fl->staged = 0;
+	fl->stg_pos = 0;
+	fl->t_start = 0;
+	fl->t_last = 0;
+
+	/* addressAndLengthFormatIdentifier 0x44: 4 bytes address and size */
+	uint8_t* msg = fl->stage.msg;
+	msg[0] = FL_SID_REQ_DL;
+	msg[1] = fl->dfi;
+	msg[2] = 0x44U;
+	for (uint8_t i = 0; i < 4U; i++)
+	{
+		msg[3U + i] = (uint8_t)(fl->address >> (24U - 8U * i));
+		msg[7U + i] = (uint8_t)(fl->size >> (24U - 8U * i));
+	}
+	fl->sts = N_FL_REQ_DL;
+	return fl_send(fl, 11);
+}
+
+/*
+ * Process the handler and advance the download. Should be called continuously
+ * instead of 'iso15765_process'. Returns N_TX_BUSY while the download is in
+ * progress, N_OK when it is completed and N_ERROR if it failed (see 'sts').
+ */
+n_rslt iso15765_flash_process(iso15765_flash_t* fl)
+{
+	if (fl == NULL)
+	{
+		return N_NULL;
+	}
+
+	iso15765_process(fl->ih);
+	fl_handle_events(fl);
+
+	if (fl->sts >= N_FL_REQ_DL && fl->sts <= N_FL_EXIT)
+	{
+		fl_stage(fl);
+		if (fl->sts == N_FL_TRANSFER && fl->rsp_pend == 0)
+		{
+			fl_next(fl);
+			/* stage the next block while this one is on the bus */
+			fl_stage(fl);
+		}
+
+		uint32_t tmo = fl->pending != 0 ? fl->p2x_ms : fl->p2_ms;
+		if (fl->rsp_pend != 0 && fl->tx_busy == 0 && (uint32_t)(fl->ih->clbs.get_ms() - fl->t_rsp) > tmo)
+		{
+			fl->sts = N_FL_ERR_TIMEOUT;
+		}
+	}
+
+	switch (fl->sts)
+	{
+	case N_FL_IDLE:
+		return N_IDLE;
+	case N_FL_DONE:
+		return N_OK;
+	case N_FL_REQ_DL:
+	case N_FL_TRANSFER:
+	case N_FL_EXIT:
+		return N_TX_BUSY;
+	default:
+		return N_ERROR;
+	}
+}
+
+/*
+ * Sustained transfer rate (bytes/s) of the TransferData phase
+ */
+uint32_t iso15765_flash_rate(const iso15765_flash_t* fl)
+{
+	if (fl == NULL || fl->t_last == fl->t_start)
+	{
+		return 0;
+	}
+	return (uint32_t)(((uint64_t)fl->acked * 1000U) / (uint32_t)(fl->t_last - fl->t_start));
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
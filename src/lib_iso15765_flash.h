@@ -0,0 +1,116 @@
+/*!
+@file   lib_iso15765_flash.h
+@brief  Header file of the UDS block-transfer (flashing) pipeline of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_FLASH_H_
+#define DEVCOONS_ISO15765_2_FLASH_H_
+
+#define I15765_FL_P2_MS		50	/* Default P2 (response timeout) */
+#define I15765_FL_P2X_MS	5000	/* Default P2* (timeout after a 'response pending') */
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+/* --- Status of the download ---------------------------------------------- */
+
+typedef enum
+{
+	N_FL_IDLE = 0x00,		/* Not started */
+	N_FL_REQ_DL = 0x01,		/* RequestDownload (0x34) sent */
+	N_FL_TRANSFER = 0x02,		/* TransferData (0x36) in progress */
+	N_FL_EXIT = 0x03,		/* RequestTransferExit (0x37) sent */
+	N_FL_DONE = 0x04,		/* The image was downloaded */
+	N_FL_ERR_NRC = 0x10,		/* Negative response (see 'nrc') */
+	N_FL_ERR_TIMEOUT = 0x11,	/* No response within P2/P2* */
+	N_FL_ERR_TX = 0x12,		/* A request could not be transmitted */
+	N_FL_ERR_RSP = 0x13		/* Invalid positive response */
+}n_fl_sts;
+
+/* --- Flashing pipeline handler ------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	iso15765_t* ih;			/* Handler of the tester. Must be initialized with an event
+					 * queue and a reception pool assigned (the pipeline drains it) */
+	n_ai_t n_ai;			/* Address information of the requests */
+	cbus_fr_format fr_fmt;		/* Frame format of the requests */
+	uint32_t address;		/* memoryAddress of the RequestDownload */
+	uint32_t size;			/* memorySize: size of the image */
+	uint8_t dfi;			/* dataFormatIdentifier (0x00: no compression/encryption) */
+	uint16_t max_blk;		/* Optional. Upper limit of the block length (0: the negotiated
+					 * maxNumberOfBlockLength or I15765_MSG_SIZE) */
+	uint16_t p2_ms;			/* Optional. P2 timeout (0: I15765_FL_P2_MS) */
+	uint16_t p2x_ms;		/* Optional. P2* timeout (0: I15765_FL_P2X_MS) */
+	uint16_t (*read)(void*, uint32_t, uint8_t*, uint16_t); /* Image provider: (ctx, offset, buffer,
+					 * max. length), returns the copied bytes (0: not ready yet) */
+	void* ctx;			/* User context of 'read' */
+	void (*on_event)(n_evt_t*);	/* Optional. Events which are not consumed by the pipeline. The
+					 * buffers of N_INDN are released by the callee (else dropped) */
+	n_fl_sts sts;			/* Status of the download */
+	uint8_t nrc;			/* NegativeResponseCode of N_FL_ERR_NRC */
+	uint8_t bsc;			/* blockSequenceCounter of the block on the bus */
+	uint8_t tx_busy;		/* The last request is not confirmed yet */
+	uint8_t rsp_pend;		/* A response is expected */
+	uint8_t pending;		/* 'responsePending' (NRC 0x78) was received */
+	uint16_t blk_len;		/* Block length (SID and BSC included) */
+	uint16_t blk_dt;		/* Data bytes of the block on the bus */
+	uint32_t acked;			/* Data bytes confirmed by the ECU */
+	uint32_t staged;		/* Data bytes read from the provider */
+	uint16_t stg_pos;		/* Data bytes in the staging buffer */
+	uint32_t t_rsp;			/* Start of the response timeout */
+	uint32_t t_start;		/* Start of the transfer (ms) */
+	uint32_t t_last;		/* Last progress of the transfer (ms) */
+	n_req_t stage;			/* Next request, prepared while the previous block is on the bus */
+}iso15765_flash_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+n_rslt iso15765_flash_init(iso15765_flash_t* fl);
+
+n_rslt iso15765_flash_start(iso15765_flash_t* fl);
+
+n_rslt iso15765_flash_process(iso15765_flash_t* fl);
+
+uint32_t iso15765_flash_rate(const iso15765_flash_t* fl);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
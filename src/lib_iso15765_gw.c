@@ -0,0 +1,336 @@
+/*!
+@file   lib_iso15765_gw.c
+@brief  Source file of the ISO15765-2 cut-through gateway
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include "lib_iso15765_gw.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * Max. payload of a ConsecutiveFrame for the given handler and frame format
+ */
+inline static uint16_t gw_cf_payload(iso15765_t* ih, cbus_fr_format fr_fmt)
+{
+	uint8_t offs = (ih->addr_md & 0x01);
+#ifdef I15765_CANXL
+	if (fr_fmt == CBUS_FR_FRM_XL)
+	{
+		return (uint16_t)(I15765_MAX_DL - 1U - offs);
+	}
+#endif
+	return (uint16_t)((fr_fmt == CBUS_FR_FRM_STD ? 7U : 63U) - offs);
+}
+
+/*
+ * Stop forwarding a message and abort the outbound stream
+ */
+static void gw_abort(iso15765_gw_t* gw, uint8_t x)
+{
+	if (gw->dir[x].active != 0)
+	{
+		iso15765_send_abort(gw->side[x ^ 1U]);
+		gw->dir[x].active = 0;
+		gw->dropped++;
+	}
+}
+
+/*
+ * Start a streamed transmission on the opposite side of 'x'
+ */
+static n_rslt gw_begin(iso15765_gw_t* gw, uint8_t x, n_evt_t* evt)
+{
+	n_ai_t n_ai;
+
+	memmove(&n_ai, &evt->n_ai, sizeof(n_ai_t));
+	if (gw->route != NULL)
+	{
+		gw->route(x, &n_ai);
+	}
+
+	n_rslt rslt = iso15765_send_begin(gw->side[x ^ 1U], gw->fr_fmt[x ^ 1U], &n_ai, evt->msg_sz);
+	if (rslt != N_OK)
+	{
+		return rslt;
+	}
+	gw->dir[x].active = 1;
+	gw->dir[x].fwd_pos = 0;
+	return N_OK;
+}
+
+/*
+ * A message reception of side 'x' completed (or was interrupted).
+ * Push the remaining data from the lent buffer of the event. Returns
+ * N_TX_BUSY if the outbound stream is still in use by the previous message.
+ */
+static n_rslt gw_complete(iso15765_gw_t* gw, uint8_t x, n_evt_t* evt)
+{
+	n_gw_dir_t* d = &gw->dir[x];
+
+	if (evt->rslt != N_OK)
+	{
+		gw_abort(gw, x);
+		return N_OK;
+	}
+
+	/* Single Frame or FF that could not be forwarded at the time */
+	if (d->active == 0)
+	{
+		n_rslt rslt = gw_begin(gw, x, evt);
+		if (rslt == N_TX_BUSY)
+		{
+			return N_TX_BUSY;
+		}
+		if (rslt != N_OK)
+		{
+			gw->dropped++;
+			return rslt;
+		}
+	}
+
+	if (evt->msg_sz > d->fwd_pos)
+	{
+		iso15765_send_push(gw->side[x ^ 1U], &evt->msg[d->fwd_pos], (uint16_t)(evt->msg_sz - d->fwd_pos));
+	}
+	d->active = 0;
+	return N_OK;
+}
+
+/*
+ * Consume the events of the handler of side 'x'. Receptions belong to the
+ * direction 'x' and confirmations/transmission errors to the direction 'x^1'.
+ */
+static void gw_handle_events(iso15765_gw_t* gw, uint8_t x)
+{
+	n_gw_dir_t* d = &gw->dir[x];
+	n_evt_t evt;
+
+	/* the events of the side wait (in order) behind a waiting message */
+	if (d->pend != 0)
+	{
+		if (gw_complete(gw, x, &d->evt) == N_TX_BUSY)
+		{
+			return;
+		}
+		iso15765_rx_release(gw->side[x], d->evt.msg);
+		d->pend = 0;
+	}
+
+	while (iso15765_evtq_pop(gw->side[x]->evtq, &evt) == N_OK)
+	{
+		switch (evt.tp)
+		{
+		case N_FF_INDN:
+			gw_begin(gw, x, &evt);
+			break;
+		case N_INDN:
+			/* N_Bs timeout is signaled by the outbound stream, followed by its
+			* N_ERR_INDN: the forwarding ends here and is counted once */
+			if (evt.rslt == N_TIMEOUT_Bs)
+			{
+				gw->dir[x ^ 1U].active = 0;
+				gw->dropped++;
+				break;
+			}
+			if (gw_complete(gw, x, &evt) == N_TX_BUSY)
+			{
+				memmove(&d->evt, &evt, sizeof(n_evt_t));
+				d->pend = 1;
+				return;
+			}
+			/* the message was pushed: return the buffer (reception pool) */
+			iso15765_rx_release(gw->side[x], evt.msg);
+			break;
+		case N_CONF:
+			if (evt.rslt == N_OK)
+			{
+				gw->forwarded++;
+			}
+			else
+			{
+				gw->dropped++;
+			}
+			break;
+		case N_ERR_INDN:
+			/* FlowControl errors stop the outbound stream without a confirmation */
+			if (gw->dir[x ^ 1U].active != 0 && gw->side[x]->out.sts == N_S_IDLE)
+			{
+				gw->dir[x ^ 1U].active = 0;
+				gw->dropped++;
+			}
+			if (gw->on_event != NULL)
+			{
+				gw->on_event(x, &evt);
+			}
+			break;
+		default:
+			if (gw->on_event != NULL)
+			{
+				gw->on_event(x, &evt);
+			}
+			break;
+		}
+	}
+}
+
+/*
+ * Push the newly received bytes of side 'x' and release its held FlowControl
+ * as soon as the outbound side is able to make progress.
+ */
+static void gw_forward(iso15765_gw_t* gw, uint8_t x)
+{
+	iso15765_t* src = gw->side[x];
+	iso15765_t* dst = gw->side[x ^ 1U];
+	n_gw_dir_t* d = &gw->dir[x];
+
+	if (d->active != 0 && (src->in.sts & N_S_RX_BUSY) != 0)
+	{
+		uint16_t rcv = src->in.msg_pos > src->in.msg_sz ? src->in.msg_sz : src->in.msg_pos;
+		const uint8_t* msg = src->rx_cur != NULL ? src->rx_cur->msg : src->in.msg;
+		if (rcv > d->fwd_pos)
+		{
+			iso15765_send_push(dst, &msg[d->fwd_pos], (uint16_t)(rcv - d->fwd_pos));
+			d->fwd_pos = rcv;
+		}
+	}
+
+	if (src->in.fc_pend == 0)
+	{
+		return;
+	}
+
+	if (d->active == 0)
+	{
+		iso15765_fc_release(src, src->config.bs, src->config.stmin);
+		return;
+	}
+
+	/* hold the inbound FC while the outbound side waits for its own FC */
+	if (dst->out.sts == N_S_TX_WAIT_FC)
+	{
+		return;
+	}
+
+	/* match the inbound rate to the outbound one: the separation time is
+	* scaled by the ratio of the CF payloads of the two sides (the outbound
+	* CAN DL may have been reduced by the bus-load model) */
+	uint16_t in_pl = gw_cf_payload(src, src->in.fr_fmt);
+	uint16_t out_pl = (uint16_t)(dst->out.tx_dl - 1U - (dst->addr_md & 0x01));
+	uint32_t st = ((uint32_t)dst->out.stmin * in_pl + out_pl - 1U) / out_pl;
+
+	st = st < src->config.stmin ? src->config.stmin : st;
+	st = st > 0x7FU ? 0x7FU : st;
+	iso15765_fc_release(src, src->config.bs, (uint8_t)st);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Link the two handlers of the gateway. The handlers must be already
+ * initialized and have an event queue and a reception pool assigned. The
+ * FlowControl frames of both handlers are held and released by the gateway.
+ */
+n_rslt iso15765_gw_init(iso15765_gw_t* gw)
+{
+	if (gw == NULL || gw->side[0] == NULL || gw->side[1] == NULL)
+	{
+		return N_NULL;
+	}
+
+	for (uint8_t x = 0; x < 2U; x++)
+	{
+		if (gw->side[x]->init_sts != N_OK)
+		{
+			return N_ERROR;
+		}
+		if (gw->side[x]->evtq == NULL)
+		{
+			return N_MISSING_CLB;
+		}
+#ifdef I15765_CANXL
+		if (gw->fr_fmt[x] != CBUS_FR_FRM_FD && gw->fr_fmt[x] != CBUS_FR_FRM_XL)
+#else
+		if (gw->fr_fmt[x] != CBUS_FR_FRM_FD)
+#endif
+		{
+			gw->fr_fmt[x] = CBUS_FR_FRM_STD;
+		}
+		gw->side[x]->fc_hold = 1;
+		gw->dir[x].active = 0;
+		gw->dir[x].fwd_pos = 0;
+		gw->dir[x].pend = 0;
+	}
+
+	gw->forwarded = 0;
+	gw->dropped = 0;
+	return N_OK;
+}
+
+/*
+ * Process both handlers and forward the data between them. Should be called
+ * continuously, as the 'iso15765_process' of a single handler.
+ */
+n_rslt iso15765_gw_process(iso15765_gw_t* gw)
+{
+	if (gw == NULL)
+	{
+		return N_NULL;
+	}
+
+	n_rslt rslt = iso15765_process(gw->side[0]);
+	rslt |= iso15765_process(gw->side[1]);
+
+	gw_handle_events(gw, 0);
+	gw_handle_events(gw, 1);
+	gw_forward(gw, 0);
+	gw_forward(gw, 1);
+	return rslt;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,82 @@
+/*!
+@file   lib_iso15765_gw.h
+@brief  Header file of the ISO15765-2 cut-through gateway
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_GW_H_
+#define DEVCOONS_ISO15765_2_GW_H_
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+/* --- Forwarding state of one direction ----------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint8_t active;			/* A message is forwarded in this direction */
+	uint16_t fwd_pos;		/* Bytes of the inbound message pushed to the outbound stream */
+	uint8_t pend;			/* A received message waits for the outbound stream */
+	n_evt_t evt;			/* Indication of the waiting message (its buffer stays lent) */
+}n_gw_dir_t;
+
+/* --- Gateway handler  ---------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	iso15765_t* side[2];		/* The two linked handlers. Both must be initialized with an
+					 * event queue and a reception pool (the gateway drains it) */
+	cbus_fr_format fr_fmt[2];	/* Frame format used when transmitting on each side */
+	void (*route)(uint8_t, n_ai_t*);/* Optional. Translate the address information of a message
+					 * received on side 'x' before it is forwarded */
+	void (*on_event)(uint8_t, n_evt_t*); /* Optional. Events which are not consumed by the gateway */
+	n_gw_dir_t dir[2];		/* Forwarding state. dir[x]: from side 'x' to the other */
+	uint32_t forwarded;		/* No. of forwarded messages */
+	uint32_t dropped;		/* No. of messages which could not be forwarded */
+}iso15765_gw_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+n_rslt iso15765_gw_init(iso15765_gw_t* gw);
+
+n_rslt iso15765_gw_process(iso15765_gw_t* gw);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
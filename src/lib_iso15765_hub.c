@@ -0,0 +1,276 @@
+/*!
+@file   lib_iso15765_hub.c
+@brief  Source file of the ISO15765-2 CAN ID demultiplexing hub
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define HUB_KEY_VALID	0x01000000U
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include "lib_iso15765_hub.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * Routing key of a target. The N_AE is part of the key only in the addressing
+ * modes which carry it (extended and mixed).
+ */
+inline static uint32_t hub_key(addr_md address, uint8_t n_ta, uint8_t n_tt, uint8_t n_ae)
+{
+	return HUB_KEY_VALID | ((uint32_t)n_tt << 16)
+		| ((uint32_t)((address & 0x01) != 0 ? n_ae : 0U) << 8) | n_ta;
+}
+
+/*
+ * Extract the routing key of a received frame (same layout as 'n_pdu_pack')
+ */
+static uint32_t hub_frame_key(addr_md address, const canbus_frame_t* frame)
+{
+	uint32_t id = frame->id;
+
+	switch (address)
+	{
+	case N_ADM_NORMAL:
+		return hub_key(address, (uint8_t)((id & 0x38U) >> 3), (id & 0x40U) != 0 ? N_TA_T_PHY : N_TA_T_FUNC, 0);
+	case N_ADM_MIXED11:
+		return hub_key(address, (uint8_t)((id & 0x38U) >> 3), (id & 0x40U) != 0 ? N_TA_T_PHY : N_TA_T_FUNC, frame->dt[0]);
+	case N_ADM_EXTENDED:
+		return hub_key(address, frame->dt[0], (id & 0x40U) != 0 ? N_TA_T_PHY : N_TA_T_FUNC, (uint8_t)((id & 0xF8U) >> 3));
+	case N_ADM_FIXED:
+		return hub_key(address, (uint8_t)((id & 0xFF00U) >> 8), ((id & 0x00FF0000U) >> 16) == 0xDAU ? N_TA_T_PHY : N_TA_T_FUNC, 0);
+	case N_ADM_MIXED29:
+		return hub_key(address, (uint8_t)((id & 0xFF00U) >> 8), ((id & 0x00FF0000U) >> 16) == 0xCEU ? N_TA_T_PHY : N_TA_T_FUNC, frame->dt[0]);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Home slot of a key (multiplicative hashing)
+ */
+inline static uint16_t hub_slot(const iso15765_hub_t* hub, uint32_t key)
+{
+	return (uint16_t)(((key * 2654435761U) >> 16) & hub->mask);
+}
+
+/*
+ * Insert an entry (linear probing). The table always keeps one empty slot.
+ */
+static n_rslt hub_insert(iso15765_hub_t* hub, uint32_t key, iso15765_t* ih)
+{
+	uint16_t i = hub_slot(hub, key);
+
+	while (hub->buf[i].key != 0)
+	{
+		if (hub->buf[i].key == key && hub->buf[i].ih == ih)
+		{
+			return N_OK;
+		}
+		i = (uint16_t)((i + 1U) & hub->mask);
+	}
+
+	if (hub->cnt >= hub->mask)
+	{
+		return N_OVFLW;
+	}
+
+	hub->buf[i].key = key;
+	hub->buf[i].ih = ih;
+	hub->cnt++;
+	return N_OK;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Initialize a hub using the caller provided storage of the routing table. The
+ * number of entries must be a power of two and larger than the number of
+ * targets (the lookups are faster when the table is at most half full).
+ */
+n_rslt iso15765_hub_init(iso15765_hub_t* hub, addr_md address, n_hub_elm_t* storage, uint16_t elms)
+{
+	if (hub == NULL || storage == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (elms < 2U || (elms & (elms - 1U)) != 0)
+	{
+		return N_WRG_VALUE;
+	}
+
+	if (address != N_ADM_NORMAL && address != N_ADM_FIXED && address != N_ADM_MIXED11
+		&& address != N_ADM_EXTENDED && address != N_ADM_MIXED29)
+	{
+		return N_WRG_VALUE;
+	}
+
+	memset(storage, 0, elms * sizeof(n_hub_elm_t));
+	hub->addr_md = address;
+	hub->buf = storage;
+	hub->mask = (uint16_t)(elms - 1U);
+	hub->cnt = 0;
+	hub->dflt = NULL;
+	hub->unrouted = 0;
+	hub->dropped = 0;
+	return N_OK;
+}
+
+/*
+ * Route the frames of a target to a handler. A handler usually owns its
+ * physical address and any functional address it listens to. A target may
+ * be attached to several handlers (e.g. a functional address).
+ */
+n_rslt iso15765_hub_attach(iso15765_hub_t* hub, iso15765_t* ih, uint8_t n_ta, ta_type n_tt, uint8_t n_ae)
+{
+	if (hub == NULL || ih == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (ih->addr_md != hub->addr_md || (n_tt != N_TA_T_PHY && n_tt != N_TA_T_FUNC))
+	{
+		return N_WRG_VALUE;
+	}
+
+	return hub_insert(hub, hub_key(hub->addr_md, n_ta, (uint8_t)n_tt, n_ae), ih);
+}
+
+/*
+ * Remove all the routes of a handler. The displaced entries are re-inserted
+ * to keep the probing sequences intact.
+ */
+n_rslt iso15765_hub_detach(iso15765_hub_t* hub, iso15765_t* ih)
+{
+	if (hub == NULL || ih == NULL)
+	{
+		return N_NULL;
+	}
+
+	for (uint16_t i = 0; i <= hub->mask; i++)
+	{
+		if (hub->buf[i].key != 0 && hub->buf[i].ih == ih)
+		{
+			hub->buf[i].key = 0;
+			hub->cnt--;
+		}
+	}
+
+	/* start after an empty slot, so that no cluster wraps around the scan */
+	uint16_t s = 0;
+	while (hub->buf[s].key != 0)
+	{
+		s++;
+	}
+
+	for (uint16_t n = 1; n <= hub->mask; n++)
+	{
+		uint16_t i = (uint16_t)((s + n) & hub->mask);
+		if (hub->buf[i].key != 0 && hub_slot(hub, hub->buf[i].key) != i)
+		{
+			n_hub_elm_t elm = hub->buf[i];
+			hub->buf[i].key = 0;
+			hub->cnt--;
+			hub_insert(hub, elm.key, elm.ih);
+		}
+	}
+	return N_OK;
+}
+
+/*
+ * Hand over a received frame to the handler(s) owning its target. Should be
+ * used by the driver instead of calling 'iso15765_enqueue' on every handler.
+ */
+n_rslt iso15765_hub_enqueue(iso15765_hub_t* hub, canbus_frame_t* frame)
+{
+	if (hub == NULL || frame == NULL)
+	{
+		return N_NULL;
+	}
+
+	/* the addressing byte is needed by the extended/mixed modes */
+	if ((hub->addr_md & 0x01) != 0 && frame->dlc == 0)
+	{
+		hub->unrouted++;
+		return N_INV;
+	}
+
+	uint32_t key = hub_frame_key(hub->addr_md, frame);
+	uint16_t i = hub_slot(hub, key);
+	n_rslt rslt = N_INV;
+
+	while (hub->buf[i].key != 0)
+	{
+		if (hub->buf[i].key == key)
+		{
+			if (iso15765_enqueue(hub->buf[i].ih, frame) == N_OK)
+			{
+				rslt = N_OK;
+			}
+			else
+			{
+				hub->dropped++;
+				rslt = rslt == N_OK ? N_OK : N_BUFFER_OVFLW;
+			}
+		}
+		i = (uint16_t)((i + 1U) & hub->mask);
+	}
+
+	if (rslt != N_INV)
+	{
+		return rslt;
+	}
+
+	if (hub->dflt != NULL)
+	{
+		return iso15765_enqueue(hub->dflt, frame);
+	}
+	hub->unrouted++;
+	return N_INV;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,83 @@
+/*!
+@file   lib_iso15765_hub.h
+@brief  Header file of the ISO15765-2 CAN ID demultiplexing hub
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_HUB_H_
+#define DEVCOONS_ISO15765_2_HUB_H_
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+/* --- Routing entry ------------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint32_t key;			/* Target address, target type and N_AE of the entry
+					 * (0: empty slot) */
+	iso15765_t* ih;			/* Owning handler */
+}n_hub_elm_t;
+
+/* --- Hub handler  -------------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	addr_md addr_md;		/* Addressing mode of the channel (all attached handlers) */
+	n_hub_elm_t* buf;		/* Caller provided storage of the routing table */
+	uint16_t mask;			/* No. of entries - 1 (No. of entries must be a power of two) */
+	uint16_t cnt;			/* No. of used entries */
+	iso15765_t* dflt;		/* Optional. Receives the frames no handler is attached to */
+	uint32_t unrouted;		/* Frames without an owner (and no default handler) */
+	uint32_t dropped;		/* Frames an owner could not enqueue */
+}iso15765_hub_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+n_rslt iso15765_hub_init(iso15765_hub_t* hub, addr_md address, n_hub_elm_t* storage, uint16_t elms);
+
+n_rslt iso15765_hub_attach(iso15765_hub_t* hub, iso15765_t* ih, uint8_t n_ta, ta_type n_tt, uint8_t n_ae);
+
+n_rslt iso15765_hub_detach(iso15765_hub_t* hub, iso15765_t* ih);
+
+n_rslt iso15765_hub_enqueue(iso15765_hub_t* hub, canbus_frame_t* frame);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
@@ -0,0 +1,405 @@
+/*!
+@file   lib_iso15765_sim.c
+@brief  Source file of the virtual CAN bus simulator of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define SIM_POLL_NS		1000000U	/* Default period of the process */
+#define SIM_SEED		0x2545F491U	/* Default seed of the random generator */
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <string.h>
+#include "lib_iso15765_sim.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/* The callbacks of the engine have no user context: the simulator which is
+ * running and the node which is processed are kept here (single-threaded) */
+static iso15765_sim_t* sim_act;
+static n_sim_node_t* node_act;
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+/*
+ * Random generator of the fault injection (xorshift32)
+ */
+static uint32_t sim_rand(iso15765_sim_t* sim)
+{
+	uint32_t x = sim->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	sim->seed = x;
+	return x;
+}
+
+/*
+ * Check if an event with the given probability (per million) occurs
+ */
+static uint8_t sim_chance(iso15765_sim_t* sim, uint32_t ppm)
+{
+	return (ppm != 0U && sim_rand(sim) % 1000000U < ppm) ? 1U : 0U;
+}
+
+/*
+ * Time-source of the nodes: the virtual clock
+ */
+static uint32_t sim_get_ms(void)
+{
+	return sim_act != NULL ? (uint32_t)(sim_act->now_ns / 1000000U) : 0U;
+}
+
+#ifdef I15765_FRAME_TS
+static uint64_t sim_get_ns(void)
+{
+	return sim_act != NULL ? sim_act->now_ns : 0U;
+}
+#endif
+
+/*
+ * Network layer of the nodes: the frame is written in a free TX mailbox of the
+ * node which is processed
+ */
+static uint8_t sim_send_frame(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	n_sim_node_t* node = node_act;
+
+	if (node == NULL || dlc > sizeof(((canbus_frame_t*)0)->dt))
+	{
+		return N_SEND_ERR;
+	}
+
+	if (node->mbx_cnt == node->mbx_elms)
+	{
+		node->tx_busy++;
+		return N_SEND_BUSY;
+	}
+
+	canbus_frame_t* frame = &node->mbx[(node->mbx_head + node->mbx_cnt) % node->mbx_elms];
+	memset(frame, 0, sizeof(canbus_frame_t));
+	frame->id = id;
+	frame->id_type = id_type;
+	frame->fr_format = fr_fmt;
+	frame->dlc = dlc;
+	memmove(frame->dt, dt, dlc);
+	node->mbx_cnt++;
+	return N_SEND_OK;
+}
+
+/*
+ * Arbitration value of a frame (lower wins). The base ID is compared first and
+ * a standard frame wins against an extended one with the same base ID (the
+ * IDE bit is dominant).
+ */
+static uint32_t sim_arb_key(const canbus_frame_t* frame)
+{
+	if (frame->id_type == CBUS_ID_T_STANDARD)
+	{
+		return (frame->id & 0x7FFU) << 19;
+	}
+	return (((frame->id >> 18) & 0x7FFU) << 19) | (1U << 18) | (frame->id & 0x3FFFFU);
+}
+
+/*
+ * The bus is idle: the first frame of every node with a pending frame takes
+ * part in the arbitration, the lowest arbitration value is sent
+ */
+static void sim_arbitrate(iso15765_sim_t* sim)
+{
+	n_sim_node_t* win = NULL;
+	uint32_t win_key = 0;
+
+	for (uint8_t i = 0; i < sim->node_cnt; i++)
+	{
+		n_sim_node_t* node = &sim->nodes[i];
+
+		if (node->mbx_cnt == 0)
+		{
+			continue;
+		}
+		node->arb_lost++;
+
+		uint32_t key = sim_arb_key(&node->mbx[node->mbx_head]);
+		if (win == NULL || key < win_key)
+		{
+			win = node;
+			win_key = key;
+		}
+	}
+
+	if (win == NULL)
+	{
+		return;
+	}
+	win->arb_lost--;
+
+	canbus_frame_t* frame = &win->mbx[win->mbx_head];
+	uint32_t ns = iso15765_frame_ns(&sim->bus, (cbus_id_type)frame->id_type, (cbus_fr_format)frame->fr_format, (cbus_dl_t)frame->dlc);
+
+	sim->tx = win;
+	sim->tx_end = sim->now_ns + (ns != 0U ? ns : 1U);
+	sim->busy_ns += ns;
+}
+
+/*
+ * Deliver a frame to every node (except the sender) whose filter accepts it
+ */
+static void sim_deliver(iso15765_sim_t* sim, n_sim_dlv_t* dlv)
+{
+#ifdef I15765_FRAME_TS
+	dlv->frame.ts = dlv->t_ns;
+#endif
+	for (uint8_t i = 0; i < sim->node_cnt; i++)
+	{
+		n_sim_node_t* node = &sim->nodes[i];
+
+		if (i == dlv->src || (dlv->frame.id & node->acc_mask) != (node->acc_id & node->acc_mask))
+		{
+			continue;
+		}
+		node->rx_frames++;
+		if (iso15765_enqueue(node->ih, &dlv->frame) != N_OK)
+		{
+			node->rx_dropped++;
+		}
+	}
+}
+
+/*
+ * End of the frame on the bus: the mailbox is released (TX complete) and the
+ * frame is delivered after the propagation delay, unless it is lost
+ */
+static void sim_frame_end(iso15765_sim_t* sim)
+{
+	n_sim_node_t* node = sim->tx;
+	canbus_frame_t* frame = &node->mbx[node->mbx_head];
+
+	sim->tx = NULL;
+	sim->frames++;
+	node->tx_frames++;
+
+	if (sim_chance(sim, sim->loss_ppm))
+	{
+		sim->lost++;
+	}
+	else
+	{
+		/* no room: the oldest frame in propagation is delivered earlier */
+		if (sim->dlv_cnt == I15765_SIM_DLV)
+		{
+			sim_deliver(sim, &sim->dlv[sim->dlv_head]);
+			sim->dlv_head = (uint8_t)((sim->dlv_head + 1U) % I15765_SIM_DLV);
+			sim->dlv_cnt--;
+		}
+
+		n_sim_dlv_t* dlv = &sim->dlv[(sim->dlv_head + sim->dlv_cnt) % I15765_SIM_DLV];
+		dlv->t_ns = sim->now_ns + sim->prop_ns;
+		dlv->src = (uint8_t)(node - sim->nodes);
+		memmove(&dlv->frame, frame, sizeof(canbus_frame_t));
+		if (frame->dlc != 0 && sim_chance(sim, sim->corrupt_ppm))
+		{
+			uint32_t r = sim_rand(sim);
+			dlv->frame.dt[r % frame->dlc] ^= (uint8_t)(1U << ((r >> 16) & 0x07U));
+			sim->corrupted++;
+		}
+		sim->dlv_cnt++;
+	}
+
+	node->mbx_head = (uint8_t)((node->mbx_head + 1U) % node->mbx_elms);
+	node->mbx_cnt--;
+
+	node_act = node;
+	iso15765_tx_complete(node->ih);
+	node_act = NULL;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Initialize the simulator. The nodes (handler, TX mailboxes and acceptance
+ * filter) and the bus must be assigned. The time-source and the network layer
+ * of the handlers are assigned here, so the handlers are initialized after.
+ * Only one simulator runs at a time.
+ */
+n_rslt iso15765_sim_init(iso15765_sim_t* sim)
+{
+	if (sim == NULL || sim->nodes == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (sim->node_cnt == 0 || sim->bus.nbr == 0)
+	{
+		return N_WRG_VALUE;
+	}
+
+	for (uint8_t i = 0; i < sim->node_cnt; i++)
+	{
+		n_sim_node_t* node = &sim->nodes[i];
+
+		if (node->ih == NULL || node->mbx == NULL)
+		{
+			return N_NULL;
+		}
+		if (node->mbx_elms == 0)
+		{
+			return N_WRG_VALUE;
+		}
+		node->ih->clbs.send_frame = sim_send_frame;
+		node->ih->clbs.get_ms = sim_get_ms;
+#ifdef I15765_FRAME_TS
+		node->ih->clbs.get_ts = sim_get_ns;
+		node->ih->ts_per_ms = 1000000U;
+#endif
+		node->mbx_head = 0;
+		node->mbx_cnt = 0;
+		node->tx_frames = 0;
+		node->tx_busy = 0;
+		node->arb_lost = 0;
+		node->rx_frames = 0;
+		node->rx_dropped = 0;
+	}
+
+	if (sim->poll_ns == 0)
+	{
+		sim->poll_ns = SIM_POLL_NS;
+	}
+	if (sim->seed == 0)
+	{
+		sim->seed = SIM_SEED;
+	}
+	sim->now_ns = 0;
+	sim->next_poll = 0;
+	sim->tx = NULL;
+	sim->tx_end = 0;
+	sim->busy_ns = 0;
+	sim->frames = 0;
+	sim->lost = 0;
+	sim->corrupted = 0;
+	sim->dlv_head = 0;
+	sim->dlv_cnt = 0;
+	sim_act = sim;
+	return N_OK;
+}
+
+/*
+ * Advance the virtual clock. The events (deliveries, end of the frame on the
+ * bus, process of the nodes and arbitration) are executed in time order.
+ */
+n_rslt iso15765_sim_run(iso15765_sim_t* sim, uint64_t duration_ns)
+{
+	if (sim == NULL || sim->nodes == NULL)
+	{
+		return N_NULL;
+	}
+
+	uint64_t end = sim->now_ns + duration_ns;
+
+	sim_act = sim;
+	while (sim->now_ns < end)
+	{
+		/* the frames which reached the receivers */
+		while (sim->dlv_cnt != 0 && sim->dlv[sim->dlv_head].t_ns <= sim->now_ns)
+		{
+			sim_deliver(sim, &sim->dlv[sim->dlv_head]);
+			sim->dlv_head = (uint8_t)((sim->dlv_head + 1U) % I15765_SIM_DLV);
+			sim->dlv_cnt--;
+		}
+
+		if (sim->tx != NULL && sim->tx_end <= sim->now_ns)
+		{
+			sim_frame_end(sim);
+		}
+
+		if (sim->next_poll <= sim->now_ns)
+		{
+			for (uint8_t i = 0; i < sim->node_cnt; i++)
+			{
+				node_act = &sim->nodes[i];
+				iso15765_process(node_act->ih);
+				if (sim->on_poll != NULL)
+				{
+					sim->on_poll(sim->ctx, i);
+				}
+			}
+			node_act = NULL;
+			sim->next_poll += sim->poll_ns;
+		}
+
+		if (sim->tx == NULL)
+		{
+			sim_arbitrate(sim);
+		}
+
+		/* jump to the next event */
+		uint64_t next = sim->next_poll < end ? sim->next_poll : end;
+		if (sim->tx != NULL && sim->tx_end < next)
+		{
+			next = sim->tx_end;
+		}
+		if (sim->dlv_cnt != 0 && sim->dlv[sim->dlv_head].t_ns < next)
+		{
+			next = sim->dlv[sim->dlv_head].t_ns;
+		}
+		sim->now_ns = next > sim->now_ns ? next : sim->now_ns;
+	}
+	return N_OK;
+}
+
+/*
+ * Load of the bus since the initialization in 0.01%
+ */
+uint32_t iso15765_sim_load(const iso15765_sim_t* sim)
+{
+	if (sim == NULL || sim->now_ns == 0)
+	{
+		return 0;
+	}
+	/* the frame on the bus is counted in full */
+	uint64_t load = sim->busy_ns * 10000U / sim->now_ns;
+	return load > 10000U ? 10000U : (uint32_t)load;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
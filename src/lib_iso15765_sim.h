@@ -0,0 +1,123 @@
+/*!
+@file   lib_iso15765_sim.h
+@brief  Header file of the virtual CAN bus simulator of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_SIM_H_
+#define DEVCOONS_ISO15765_2_SIM_H_
+
+#ifndef I15765_SIM_DLV
+#define I15765_SIM_DLV		16	/* Max. frames in propagation (delivered later) */
+#endif
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+#include "lib_iso15765_bus.h"
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+/* --- Node of the simulated bus ------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	iso15765_t* ih;			/* Handler of the node. 'send_frame'/'get_ms' are assigned by
+					 * 'iso15765_sim_init' (before 'iso15765_init') */
+	canbus_frame_t* mbx;		/* Caller provided TX mailboxes (sent in FIFO order) */
+	uint8_t mbx_elms;		/* No. of TX mailboxes. When all are used the node gets
+					 * N_SEND_BUSY */
+	uint32_t acc_id;		/* Acceptance filter: a frame is received if
+					 * (id & acc_mask) == (acc_id & acc_mask) */
+	uint32_t acc_mask;		/* Acceptance mask (0: every frame is received) */
+	uint8_t mbx_head;		/* First used mailbox */
+	uint8_t mbx_cnt;		/* Used mailboxes */
+	uint32_t tx_frames;		/* Frames sent on the bus */
+	uint32_t tx_busy;		/* Frames refused because the mailboxes were full */
+	uint32_t arb_lost;		/* Arbitrations lost */
+	uint32_t rx_frames;		/* Frames received (accepted by the filter) */
+	uint32_t rx_dropped;		/* Received frames the handler could not enqueue */
+}n_sim_node_t;
+
+/* --- Frame in propagation ------------------------------------------------ */
+
+typedef struct ALIGNMENT
+{
+	uint64_t t_ns;			/* Time of the delivery */
+	uint8_t src;			/* Index of the sending node */
+	canbus_frame_t frame;		/* The frame */
+}n_sim_dlv_t;
+
+/* --- Simulator handler --------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	n_bus_cfg_t bus;		/* Bitrates of the bus */
+	n_sim_node_t* nodes;		/* Caller provided nodes */
+	uint8_t node_cnt;		/* No. of nodes */
+	uint32_t poll_ns;		/* Period of 'iso15765_process' on every node (0: 1ms) */
+	uint32_t prop_ns;		/* Delay from the end of a frame to its reception */
+	uint32_t loss_ppm;		/* Probability (per million) that a frame is lost for every receiver */
+	uint32_t corrupt_ppm;		/* Probability (per million) that a bit of the data of a
+					 * frame is flipped (an error not detected by the CRC) */
+	uint32_t seed;			/* State of the random generator (0: default seed) */
+	void (*on_poll)(void*, uint8_t); /* Optional. Fired after the process of a node (ctx, node).
+					 * Only the handler of that node may be used in it */
+	void* ctx;			/* User context of 'on_poll' */
+	uint64_t now_ns;		/* Virtual clock */
+	uint64_t next_poll;		/* Time of the next process */
+	n_sim_node_t* tx;		/* Node of the frame on the bus (NULL: bus idle) */
+	uint64_t tx_end;		/* End of the frame on the bus (interframe space included) */
+	uint64_t busy_ns;		/* Time the bus was busy */
+	uint32_t frames;		/* Frames sent on the bus */
+	uint32_t lost;			/* Frames lost */
+	uint32_t corrupted;		/* Frames corrupted */
+	uint8_t dlv_head;		/* First frame in propagation */
+	uint8_t dlv_cnt;		/* Frames in propagation */
+	n_sim_dlv_t dlv[I15765_SIM_DLV]; /* Frames in propagation */
+}iso15765_sim_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+n_rslt iso15765_sim_init(iso15765_sim_t* sim);
+
+n_rslt iso15765_sim_run(iso15765_sim_t* sim, uint64_t duration_ns);
+
+uint32_t iso15765_sim_load(const iso15765_sim_t* sim);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif
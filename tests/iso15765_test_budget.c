@@ -0,0 +1,205 @@
+/*!
+@file   iso15765_test_budget.c
+@brief  Regression tests of the budgeted process of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_budget
+
+Returns 0 when all the checks pass. 'iso15765_process_budget' must check the
+timeouts on every call, even when the budget leaves frames in the reception
+queue, and report as sent only the frames taken by the driver.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_MSG_SZ	64	/* Segmented message (FF + CFs) */
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "lib_iso15765.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_t ih;
+static n_req_t req;
+static uint32_t now;
+static uint8_t drv_rslt;
+static uint32_t bs_timeouts;
+static uint32_t bs_timeout_at;
+static int fails;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint8_t tst_send(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	ISO_15675_UNUSED(id_type);
+	ISO_15675_UNUSED(id);
+	ISO_15675_UNUSED(fr_fmt);
+	ISO_15675_UNUSED(dlc);
+	ISO_15675_UNUSED(dt);
+	return drv_rslt;
+}
+
+static void tst_indn(n_indn_t* info)
+{
+	ISO_15675_UNUSED(info);
+}
+
+static void tst_error(n_rslt rslt)
+{
+	if (rslt == N_TIMEOUT_Bs && bs_timeouts++ == 0)
+	{
+		bs_timeout_at = now;
+	}
+}
+
+static uint32_t tst_get_ms(void)
+{
+	return now;
+}
+
+static void tst_setup(void)
+{
+	memset(&ih, 0, sizeof(ih));
+	ih.addr_md = N_ADM_FIXED;
+	ih.fr_id_type = CBUS_ID_T_EXTENDED;
+	ih.clbs.send_frame = tst_send;
+	ih.clbs.get_ms = tst_get_ms;
+	ih.clbs.indn = tst_indn;
+	ih.clbs.on_error = tst_error;
+	ih.config.n_bs = 100;
+	ih.config.n_cr = 100;
+	TST_CHECK(iso15765_init(&ih) == N_OK);
+	drv_rslt = N_SEND_OK;
+	bs_timeouts = 0;
+
+	memset(&req, 0, sizeof(req));
+	req.n_ai.n_pr = 6;
+	req.n_ai.n_sa = 0x01;
+	req.n_ai.n_ta = 0x02;
+	req.n_ai.n_tt = N_TA_T_PHY;
+	req.fr_fmt = CBUS_FR_FRM_STD;
+}
+
+/* Functional Single Frame of another peer */
+static void tst_enqueue_sf(uint8_t sa)
+{
+	canbus_frame_t fr;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.id = (0x06UL << 26) | (0xDBUL << 16) | (0x33UL << 8) | sa;
+	fr.id_type = CBUS_ID_T_EXTENDED;
+	fr.fr_format = CBUS_FR_FRM_STD;
+	fr.dlc = 8;
+	fr.dt[0] = 0x01;
+	fr.dt[1] = sa;
+	iso15765_enqueue(&ih, &fr);
+}
+
+/* The FlowControl never arrives while the queue is never empty */
+static void tst_timeout_under_load(void)
+{
+	n_budget_t budget;
+
+	tst_setup();
+	req.msg_sz = TST_MSG_SZ;
+	TST_CHECK(iso15765_send(&ih, &req) == N_OK);
+
+	memset(&budget, 0, sizeof(budget));
+	budget.max_frames = 2;
+	for (uint32_t i = 0; i < 200 && bs_timeouts == 0; i++)
+	{
+		tst_enqueue_sf((uint8_t)(0x10 + (i & 0x0F)));
+		tst_enqueue_sf((uint8_t)(0x20 + (i & 0x0F)));
+		now++;
+		iso15765_process_budget(&ih, &budget);
+		TST_CHECK(i == 0 || budget.rx_left != 0);
+	}
+	TST_CHECK(bs_timeouts == 1);
+	TST_CHECK(bs_timeout_at >= ih.config.n_bs && bs_timeout_at <= ih.config.n_bs + 2U);
+	TST_CHECK(ih.out.sts == N_S_IDLE);
+}
+
+/* Frames refused by the driver (TX buffer full, error) are not counted */
+static void tst_tx_frames(void)
+{
+	n_budget_t budget;
+
+	tst_setup();
+	req.msg_sz = 4;
+	memset(&budget, 0, sizeof(budget));
+
+	drv_rslt = N_SEND_BUSY;
+	TST_CHECK(iso15765_send(&ih, &req) == N_OK);
+	now++;
+	iso15765_process_budget(&ih, &budget);
+	TST_CHECK(budget.tx_frames == 0);
+	TST_CHECK(ih.tx_frames == 0);
+
+	drv_rslt = N_SEND_OK;
+	now++;
+	iso15765_process_budget(&ih, &budget);
+	TST_CHECK(budget.tx_frames == 1);
+	TST_CHECK(ih.tx_frames == 1);
+	TST_CHECK(ih.out.sts == N_S_IDLE);
+
+	/* the First Frame is lost: the stream moves on without a frame sent */
+	drv_rslt = N_SEND_ERR;
+	req.msg_sz = TST_MSG_SZ;
+	TST_CHECK(iso15765_send(&ih, &req) == N_OK);
+	now++;
+	iso15765_process_budget(&ih, &budget);
+	TST_CHECK(budget.tx_frames == 0);
+	TST_CHECK(ih.tx_frames == 1);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(void)
+{
+	tst_timeout_under_load();
+	tst_tx_frames();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,275 @@
+/*!
+@file   iso15765_test_co.cpp
+@brief  Regression tests of the C++20 coroutines of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_co
+
+Returns 0 when all the checks pass. Two async channels on one executor are
+connected back to back: an awaited send is confirmed and its message is
+received by the awaiting coroutine of the peer, a receive without a message
+expires after its timeout and many concurrent conversations of one channel
+each get their own answer.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_MSG_SZ	300	/* Size of the segmented message */
+#define TST_CONV	200	/* Concurrent conversations */
+#define TST_ROUNDS	3	/* Requests per conversation */
+
+/* every request may wait for the (single) echo coroutine */
+#define I15765_CO_BACKLOG	TST_CONV
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include "lib_iso15765_co.hpp"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+using namespace iso15765;
+using namespace iso15765::co;
+
+using tst_ch = async_channel<AddrMode::Fixed, FrameFormat::Classic>;
+
+static std::uint32_t now;
+static int fails;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static n_config_t tst_config()
+{
+	n_config_t cfg{};
+	cfg.bs = 8;
+	cfg.stmin = 1;
+	cfg.n_bs = 100;
+	cfg.n_cr = 100;
+	return cfg;
+}
+
+/* Frames of one channel are received by 'peer' */
+static bool tst_to(tst_ch** peer, std::uint32_t id, span<const std::uint8_t> dt)
+{
+	canbus_frame_t fr{};
+	fr.id = id;
+	fr.id_type = CBUS_ID_T_EXTENDED;
+	fr.fr_format = CBUS_FR_FRM_STD;
+	fr.dlc = static_cast<std::uint8_t>(dt.size());
+	std::memcpy(fr.dt, dt.data(), dt.size());
+	return (*peer)->channel().enqueue(fr) == N_OK;
+}
+
+/* Run the executor until 'done' or 'loops' elapsed milliseconds */
+template<typename P>
+static void tst_run(executor& ex, std::uint32_t loops, P done)
+{
+	for (std::uint32_t l = 0; l < loops && !done(); l++)
+	{
+		now++;
+		ex.run_once();
+	}
+}
+
+/* --- send / receive ------------------------------------------------------ */
+
+static task<> tst_sender(tst_ch& ch, const std::uint8_t* msg, n_rslt& rslt, bool& done)
+{
+	n_ai_t ai{ 6, 0x01, 0x02, 0, N_TA_T_PHY };
+	rslt = co_await ch.send(ai, span<const std::uint8_t>(msg, TST_MSG_SZ));
+	done = true;
+}
+
+static task<> tst_receiver(tst_ch& ch, message& msg, bool& done)
+{
+	msg = co_await ch.receive(rx_filter{ 0x01, 0x02, -1 });
+	done = true;
+}
+
+/* A segmented message awaited by the peer */
+static void tst_send_receive()
+{
+	executor ex;
+	tst_ch* pa = nullptr;
+	tst_ch* pb = nullptr;
+	tst_ch a(ex, [&pb](std::uint32_t id, span<const std::uint8_t> dt) { return tst_to(&pb, id, dt); }, [] { return now; }, tst_config());
+	tst_ch b(ex, [&pa](std::uint32_t id, span<const std::uint8_t> dt) { return tst_to(&pa, id, dt); }, [] { return now; }, tst_config());
+	std::uint8_t msg[TST_MSG_SZ];
+	n_rslt rslt = N_ERROR;
+	message rx;
+	bool sent = false;
+	bool received = false;
+
+	pa = &a;
+	pb = &b;
+	for (std::uint16_t i = 0; i < TST_MSG_SZ; i++)
+	{
+		msg[i] = static_cast<std::uint8_t>(i * 7);
+	}
+
+	ex.spawn(tst_receiver(b, rx, received));
+	ex.spawn(tst_sender(a, msg, rslt, sent));
+	TST_CHECK(ex.live() == 2);
+
+	tst_run(ex, 10000, [&] { return sent && received; });
+	TST_CHECK(sent && rslt == N_OK);
+	TST_CHECK(received && rx.rslt == N_OK);
+	TST_CHECK(rx.n_ai.n_sa == 0x01 && rx.n_ai.n_ta == 0x02);
+	TST_CHECK(rx.data.size() == TST_MSG_SZ && std::memcmp(rx.data.data(), msg, TST_MSG_SZ) == 0);
+	TST_CHECK(ex.live() == 0);
+	TST_CHECK(a.dropped() == 0 && b.dropped() == 0);
+}
+
+/* --- receive timeout ----------------------------------------------------- */
+
+static task<> tst_waiter(tst_ch& ch, std::uint32_t timeout_ms, message& msg, std::uint32_t& at)
+{
+	msg = co_await ch.receive(rx_filter{}, timeout_ms);
+	at = now;
+}
+
+/* A receive without a message expires after its timeout with N_TIMEOUT_A */
+static void tst_receive_timeout()
+{
+	executor ex;
+	tst_ch ch(ex, [](std::uint32_t, span<const std::uint8_t>) { return true; }, [] { return now; }, tst_config());
+	message msg;
+	std::uint32_t at = 0;
+	std::uint32_t start = now;
+
+	msg.rslt = N_ERROR;
+	ex.spawn(tst_waiter(ch, 50, msg, at));
+	tst_run(ex, 45, [] { return false; });
+	TST_CHECK(ex.live() == 1 && at == 0);
+
+	tst_run(ex, 1000, [&] { return ex.live() == 0; });
+	TST_CHECK(ex.live() == 0);
+	TST_CHECK(msg.rslt == N_TIMEOUT_A && msg.data.empty());
+	TST_CHECK(at - start >= 50 && at - start <= 52);
+}
+
+/* --- concurrent conversations -------------------------------------------- */
+
+/* Request 'k' of a conversation: 'n_sa' identifies it, the answer is the
+ * request echoed back to it */
+static task<bool> tst_request(tst_ch& ch, std::uint8_t n_sa, std::uint8_t k)
+{
+	n_ai_t ai{ 6, n_sa, 0xF0, 0, N_TA_T_PHY };
+	std::vector<std::uint8_t> req(static_cast<std::size_t>((n_sa + k) % 40 + 1), static_cast<std::uint8_t>(n_sa ^ k));
+
+	n_rslt rslt = co_await ch.send(ai, span<const std::uint8_t>(req.data(), req.size()));
+	if (rslt != N_OK)
+	{
+		co_return false;
+	}
+	message rsp = co_await ch.receive(rx_filter{ 0xF0, n_sa, -1 });
+	co_return rsp.rslt == N_OK && rsp.data == req;
+}
+
+static task<> tst_conversation(tst_ch& ch, std::uint8_t n_sa, std::uint32_t& done, std::uint32_t& good)
+{
+	for (std::uint8_t k = 0; k < TST_ROUNDS; k++)
+	{
+		good += (co_await tst_request(ch, n_sa, k)) ? 1U : 0U;
+	}
+	done++;
+}
+
+/* Echo of every request, to its source address, until 'stop' */
+static task<> tst_echo(tst_ch& ch, const bool& stop)
+{
+	while (!stop)
+	{
+		message req = co_await ch.receive(rx_filter{ -1, 0xF0, -1 }, 10);
+		if (req.rslt != N_OK)
+		{
+			continue;
+		}
+		n_ai_t ai{ 6, 0xF0, req.n_ai.n_sa, 0, N_TA_T_PHY };
+		co_await ch.send(ai, span<const std::uint8_t>(req.data.data(), req.data.size()));
+	}
+}
+
+/* Many conversations of one channel wait at once, each gets its own answers */
+static void tst_conversations()
+{
+	executor ex;
+	tst_ch* pa = nullptr;
+	tst_ch* pb = nullptr;
+	tst_ch a(ex, [&pb](std::uint32_t id, span<const std::uint8_t> dt) { return tst_to(&pb, id, dt); }, [] { return now; }, tst_config());
+	tst_ch b(ex, [&pa](std::uint32_t id, span<const std::uint8_t> dt) { return tst_to(&pa, id, dt); }, [] { return now; }, tst_config());
+	std::uint32_t done = 0;
+	std::uint32_t good = 0;
+	bool stop = false;
+
+	pa = &a;
+	pb = &b;
+	ex.spawn(tst_echo(b, stop));
+	for (std::uint16_t c = 0; c < TST_CONV; c++)
+	{
+		ex.spawn(tst_conversation(a, static_cast<std::uint8_t>(c), done, good));
+	}
+	TST_CHECK(ex.live() == TST_CONV + 1U);
+
+	tst_run(ex, 1000000, [&] { return done == TST_CONV; });
+	TST_CHECK(done == TST_CONV);
+	TST_CHECK(good == TST_CONV * TST_ROUNDS);
+	/* only the echo is left, waiting for the next request */
+	TST_CHECK(ex.live() == 1);
+	TST_CHECK(a.dropped() == 0 && b.dropped() == 0);
+
+	stop = true;
+	tst_run(ex, 100, [&] { return ex.live() == 0; });
+	TST_CHECK(ex.live() == 0);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main()
+{
+	tst_send_receive();
+	tst_receive_timeout();
+	tst_conversations();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
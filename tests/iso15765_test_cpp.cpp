@@ -0,0 +1,487 @@
+/*!
+@file   iso15765_test_cpp.cpp
+@brief  Regression tests of the C++ layer of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_cpp
+
+Returns 0 when all the checks pass. The Channel must deliver every message
+received before a 'process' call, transfer segmented messages between two
+Channels (loopback) with blocks and STmin, confirm the failures of the
+outbound message and stop at the limits of a work budget. A wrong SN and the
+CFs of another N_AE are handled as by the C engine.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_SF_CNT	30	/* Single Frames queued before a process call */
+#define TST_MSG_SZ	300	/* Size of the segmented messages */
+#define TST_TRACE	8	/* Indications/errors kept by the parity tests */
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include "lib_iso15765.hpp"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+using namespace iso15765;
+
+using classic_ch = Channel<AddrMode::Fixed, FrameFormat::Classic>;
+using fd_ch = Channel<AddrMode::Mixed11, FrameFormat::Fd>;
+using mixed_ch = Channel<AddrMode::Mixed11, FrameFormat::Classic>;
+
+/* Received messages and confirmations of a Channel */
+struct tst_log
+{
+	std::uint32_t indn = 0;
+	std::uint32_t indn_ok = 0;
+	std::uint32_t cfm = 0;
+	n_rslt cfm_rslt = N_ERROR;
+	std::uint32_t errs = 0;
+	n_rslt err_rslt = N_OK;
+	std::uint16_t sz = 0;
+	std::uint8_t msg[TST_MSG_SZ];
+};
+
+/* Indications and errors of an engine, in order */
+struct tst_trace
+{
+	std::uint32_t indn = 0;
+	n_rslt indn_rslt[TST_TRACE];
+	std::uint16_t indn_sz[TST_TRACE];
+	std::uint32_t errs = 0;
+	n_rslt err_rslt[TST_TRACE];
+};
+
+static std::uint32_t now;
+static int fails;
+
+static iso15765_t eng;
+static tst_trace eng_trace;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static n_config_t tst_config(std::uint8_t bs, std::uint8_t stmin)
+{
+	n_config_t cfg{};
+	cfg.bs = bs;
+	cfg.stmin = stmin;
+	cfg.wf = 2;
+	cfg.n_bs = 100;
+	cfg.n_cr = 100;
+	return cfg;
+}
+
+template<typename C>
+static void tst_attach(C& ch, tst_log& log)
+{
+	ch.on_indication([&log](const n_ai_t&, n_rslt rslt, span<const std::uint8_t> msg) {
+		log.indn++;
+		if (rslt == N_OK && msg.size() <= TST_MSG_SZ)
+		{
+			log.indn_ok++;
+			log.sz = static_cast<std::uint16_t>(msg.size());
+			std::memcpy(log.msg, msg.data(), msg.size());
+		}
+	});
+	ch.on_confirm([&log](const n_ai_t&, n_rslt rslt) { log.cfm++; log.cfm_rslt = rslt; });
+	ch.on_error([&log](n_rslt rslt) { log.errs++; log.err_rslt = rslt; });
+}
+
+/* Frame as the driver of the Channel 'C' would receive it */
+template<typename C>
+static canbus_frame_t tst_frame(std::uint32_t id, span<const std::uint8_t> dt)
+{
+	canbus_frame_t fr{};
+	fr.id = id;
+	fr.id_type = C::addr::id_type;
+	fr.fr_format = C::pci::tx_dl > 8U ? CBUS_FR_FRM_FD : CBUS_FR_FRM_STD;
+	fr.dlc = static_cast<std::uint8_t>(dt.size());
+	std::memcpy(fr.dt, dt.data(), dt.size());
+	return fr;
+}
+
+/* Single Frame from the peer 'sa' whose payload is 'sz' bytes of 'fill' */
+static void tst_enqueue_sf(classic_ch& ch, std::uint8_t sa, std::uint8_t fill, std::uint8_t sz)
+{
+	std::uint8_t dt[8];
+	std::uint8_t pld[7];
+	n_ai_t ai{ 6, sa, 0x01, 0, N_TA_T_PHY };
+
+	std::memset(pld, fill, sz);
+	std::uint8_t dl = classic_ch::pci::encode_sf(ai, span<const std::uint8_t>(pld, sz), dt);
+	canbus_frame_t fr = tst_frame<classic_ch>(classic_ch::addr::pack_id(ai), span<const std::uint8_t>(dt, dl));
+	TST_CHECK(ch.enqueue(fr) == N_OK);
+}
+
+/* Every message queued before a process call is delivered */
+static void tst_many_sf_per_process()
+{
+	tst_log log;
+	std::uint32_t cnt = 0;
+	classic_ch ch([](std::uint32_t, span<const std::uint8_t>) { return true; }, [] { return now; }, tst_config(0, 0));
+
+	ch.on_indication([&cnt](const n_ai_t& ai, n_rslt rslt, span<const std::uint8_t> msg) {
+		TST_CHECK(rslt == N_OK);
+		TST_CHECK(ai.n_sa == 0x10 + cnt);
+		TST_CHECK(msg.size() == 1 + cnt % 7);
+		for (std::size_t k = 0; k < msg.size(); k++)
+		{
+			TST_CHECK(msg[k] == static_cast<std::uint8_t>(0xA0 + cnt));
+		}
+		cnt++;
+	});
+
+	for (std::uint32_t i = 0; i < TST_SF_CNT; i++)
+	{
+		tst_enqueue_sf(ch, static_cast<std::uint8_t>(0x10 + i), static_cast<std::uint8_t>(0xA0 + i), static_cast<std::uint8_t>(1 + i % 7));
+	}
+	TST_CHECK(ch.process() == N_OK);
+	TST_CHECK(cnt == TST_SF_CNT);
+	TST_CHECK(ch.rx_dropped() == 0);
+}
+
+/* Segmented transfer between two Channels, 'a' sends to 'b' */
+template<typename C>
+static void tst_loopback(std::uint8_t bs, std::uint8_t stmin)
+{
+	tst_log la;
+	tst_log lb;
+	C* pa = nullptr;
+	C* pb = nullptr;
+	std::uint8_t msg[TST_MSG_SZ];
+	n_ai_t ai{ 6, 0x01, 0x02, 0x33, N_TA_T_PHY };
+
+	C a([&pb](std::uint32_t id, span<const std::uint8_t> dt) { return pb->enqueue(tst_frame<C>(id, dt)) == N_OK; },
+		[] { return now; }, tst_config(bs, stmin));
+	C b([&pa](std::uint32_t id, span<const std::uint8_t> dt) { return pa->enqueue(tst_frame<C>(id, dt)) == N_OK; },
+		[] { return now; }, tst_config(bs, stmin));
+	pa = &a;
+	pb = &b;
+	tst_attach(a, la);
+	tst_attach(b, lb);
+
+	for (std::uint16_t i = 0; i < TST_MSG_SZ; i++)
+	{
+		msg[i] = static_cast<std::uint8_t>(i * 7);
+	}
+	TST_CHECK(a.send(ai, span<const std::uint8_t>(msg, TST_MSG_SZ)) == N_OK);
+	TST_CHECK(a.send(ai, span<const std::uint8_t>(msg, 1)) == N_TX_BUSY);
+
+	for (std::uint32_t l = 0; l < 10000 && la.cfm == 0; l++)
+	{
+		now++;
+		a.process();
+		b.process();
+	}
+	TST_CHECK(la.cfm == 1 && la.cfm_rslt == N_OK);
+	TST_CHECK(lb.indn == 1 && lb.indn_ok == 1);
+	TST_CHECK(lb.sz == TST_MSG_SZ && std::memcmp(lb.msg, msg, TST_MSG_SZ) == 0);
+	TST_CHECK(la.errs == 0 && lb.errs == 0);
+	TST_CHECK(a.tx_idle());
+}
+
+/* A message larger than the receiver is refused with an OVERFLOW FlowControl */
+static void tst_fc_overflow()
+{
+	using small_ch = Channel<AddrMode::Fixed, FrameFormat::Classic, 64>;
+	tst_log la;
+	tst_log lb;
+	classic_ch* pa = nullptr;
+	small_ch* pb = nullptr;
+	std::uint8_t msg[TST_MSG_SZ] = { 0 };
+	n_ai_t ai{ 6, 0x01, 0x02, 0, N_TA_T_PHY };
+
+	classic_ch a([&pb](std::uint32_t id, span<const std::uint8_t> dt) { return pb->enqueue(tst_frame<small_ch>(id, dt)) == N_OK; },
+		[] { return now; }, tst_config(0, 0));
+	small_ch b([&pa](std::uint32_t id, span<const std::uint8_t> dt) { return pa->enqueue(tst_frame<classic_ch>(id, dt)) == N_OK; },
+		[] { return now; }, tst_config(0, 0));
+	pa = &a;
+	pb = &b;
+	tst_attach(a, la);
+	tst_attach(b, lb);
+
+	TST_CHECK(a.send(ai, span<const std::uint8_t>(msg, TST_MSG_SZ)) == N_OK);
+	for (std::uint32_t l = 0; l < 10 && la.cfm == 0; l++)
+	{
+		a.process();
+		b.process();
+	}
+	TST_CHECK(la.cfm == 1 && la.cfm_rslt == N_BUFFER_OVFLW);
+	TST_CHECK(lb.errs == 1 && lb.err_rslt == N_BUFFER_OVFLW);
+	TST_CHECK(lb.indn == 0);
+	TST_CHECK(a.tx_idle());
+}
+
+/* The outbound message is confirmed when the FlowControl does not arrive */
+static void tst_bs_timeout()
+{
+	tst_log log;
+	std::uint8_t msg[TST_MSG_SZ] = { 0 };
+	n_ai_t ai{ 6, 0x01, 0x02, 0, N_TA_T_PHY };
+	classic_ch ch([](std::uint32_t, span<const std::uint8_t>) { return true; }, [] { return now; }, tst_config(0, 0));
+
+	tst_attach(ch, log);
+	TST_CHECK(ch.send(ai, span<const std::uint8_t>(msg, TST_MSG_SZ)) == N_OK);
+	ch.process();
+	TST_CHECK(log.cfm == 0 && !ch.tx_idle());
+	now += 100;
+	ch.process();
+	TST_CHECK(log.cfm == 1 && log.cfm_rslt == N_TIMEOUT_Bs);
+	TST_CHECK(ch.tx_idle());
+}
+
+/* The work of a process call stops at the budget, frames refused by the
+ * driver are not counted and are sent again */
+static void tst_budget()
+{
+	tst_log log;
+	bool accept = false;
+	std::uint8_t msg[4] = { 1, 2, 3, 4 };
+	n_ai_t ai{ 6, 0x01, 0x02, 0, N_TA_T_PHY };
+	n_budget_t budget{};
+	classic_ch ch([&accept](std::uint32_t, span<const std::uint8_t>) { return accept; }, [] { return now; }, tst_config(0, 0));
+
+	tst_attach(ch, log);
+	for (std::uint8_t i = 0; i < 10; i++)
+	{
+		tst_enqueue_sf(ch, static_cast<std::uint8_t>(0x10 + i), i, 3);
+	}
+
+	budget.max_frames = 4;
+	TST_CHECK(ch.process(budget) == N_OK);
+	TST_CHECK(budget.rx_frames == 4 && budget.rx_left == 6);
+	TST_CHECK(log.indn == 4);
+
+	TST_CHECK(ch.send(ai, span<const std::uint8_t>(msg, sizeof(msg))) == N_OK);
+	budget.max_frames = 0;
+	TST_CHECK(ch.process(budget) == N_OK);
+	TST_CHECK(budget.rx_frames == 6 && budget.rx_left == 0);
+	TST_CHECK(budget.tx_frames == 0 && budget.tx_left == 1);
+	TST_CHECK(log.indn == 10 && log.cfm == 0);
+
+	accept = true;
+	TST_CHECK(ch.process(budget) == N_OK);
+	TST_CHECK(budget.tx_frames == 1 && budget.tx_left == 0);
+	TST_CHECK(log.cfm == 1 && log.cfm_rslt == N_OK);
+}
+
+/* --- Parity with the C engine ------------------------------------------- */
+
+static void tst_trace_indn(tst_trace& t, n_rslt rslt, std::size_t sz)
+{
+	if (t.indn < TST_TRACE)
+	{
+		t.indn_rslt[t.indn] = rslt;
+		t.indn_sz[t.indn] = static_cast<std::uint16_t>(sz);
+	}
+	t.indn++;
+}
+
+static void tst_trace_err(tst_trace& t, n_rslt rslt)
+{
+	if (t.errs < TST_TRACE)
+	{
+		t.err_rslt[t.errs] = rslt;
+	}
+	t.errs++;
+}
+
+static std::uint8_t eng_send_frame(cbus_id_type, std::uint32_t, cbus_fr_format, cbus_dl_t, std::uint8_t*)
+{
+	return N_SEND_OK;
+}
+
+static std::uint32_t eng_get_ms()
+{
+	return now;
+}
+
+static void eng_indn(n_indn_t* info)
+{
+	tst_trace_indn(eng_trace, info->rslt, info->msg_sz);
+}
+
+static void eng_error(n_rslt rslt)
+{
+	tst_trace_err(eng_trace, rslt);
+}
+
+/* The same frames are fed to a Channel and to the C engine (mixed 11 bits
+ * addressing, N_AE 0x33) one by one: both report the same indications and
+ * errors */
+static void tst_parity(const canbus_frame_t* frames, std::uint8_t cnt, const tst_trace& expected)
+{
+	tst_trace ch_trace;
+	mixed_ch ch([](std::uint32_t, span<const std::uint8_t>) { return true; }, [] { return now; }, tst_config(0, 0));
+
+	ch.on_indication([&ch_trace](const n_ai_t&, n_rslt rslt, span<const std::uint8_t> msg) {
+		tst_trace_indn(ch_trace, rslt, msg.size());
+	});
+	ch.on_error([&ch_trace](n_rslt rslt) { tst_trace_err(ch_trace, rslt); });
+
+	std::memset(&eng, 0, sizeof(eng));
+	eng.addr_md = N_ADM_MIXED11;
+	eng.fr_id_type = CBUS_ID_T_STANDARD;
+	eng.clbs.send_frame = eng_send_frame;
+	eng.clbs.get_ms = eng_get_ms;
+	eng.clbs.indn = eng_indn;
+	eng.clbs.on_error = eng_error;
+	eng.config.n_bs = 100;
+	eng.config.n_cr = 100;
+	eng_trace = tst_trace{};
+	TST_CHECK(iso15765_init(&eng) == N_OK);
+
+	for (std::uint8_t i = 0; i < cnt; i++)
+	{
+		canbus_frame_t fr = frames[i];
+		TST_CHECK(ch.enqueue(fr) == N_OK);
+		TST_CHECK(iso15765_enqueue(&eng, &fr) == N_OK);
+		ch.process();
+		iso15765_process(&eng);
+	}
+
+	for (const tst_trace* t : { &ch_trace, &eng_trace })
+	{
+		TST_CHECK(t->indn == expected.indn && t->errs == expected.errs);
+		for (std::uint32_t k = 0; k < t->indn && k < expected.indn; k++)
+		{
+			TST_CHECK(t->indn_rslt[k] == expected.indn_rslt[k] && t->indn_sz[k] == expected.indn_sz[k]);
+		}
+		for (std::uint32_t k = 0; k < t->errs && k < expected.errs; k++)
+		{
+			TST_CHECK(t->err_rslt[k] == expected.err_rslt[k]);
+		}
+	}
+}
+
+/* Frame of a segmented message of 'sz' bytes: 0 the FF, else the CF 'sn' */
+static canbus_frame_t tst_seg_frame(const n_ai_t& ai, std::uint16_t sz, std::uint8_t sn)
+{
+	std::uint8_t msg[TST_MSG_SZ];
+	std::uint8_t dt[8];
+	std::uint8_t dl;
+
+	for (std::uint16_t i = 0; i < sz; i++)
+	{
+		msg[i] = static_cast<std::uint8_t>(i);
+	}
+	if (sn == 0U)
+	{
+		dl = mixed_ch::pci::encode_ff(ai, span<const std::uint8_t>(msg, sz), dt);
+	}
+	else
+	{
+		std::uint16_t pos = static_cast<std::uint16_t>(mixed_ch::pci::ff_payload + (sn - 1U) * mixed_ch::pci::cf_payload);
+		std::uint16_t part = static_cast<std::uint16_t>(sz - pos);
+		part = part < mixed_ch::pci::cf_payload ? part : mixed_ch::pci::cf_payload;
+		dl = mixed_ch::pci::encode_cf(ai, sn, span<const std::uint8_t>(&msg[pos], part), dt);
+	}
+	return tst_frame<mixed_ch>(mixed_ch::addr::pack_id(ai), span<const std::uint8_t>(dt, dl));
+}
+
+/* A wrong SN interrupts the reception: N_INV_SEQ_NUM is reported and
+ * indicated with the received part, the next message is received */
+static void tst_parity_sn()
+{
+	n_ai_t ai{ 6, 0x01, 0x02, 0x33, N_TA_T_PHY };
+	std::uint8_t sf[2] = { 0xAA, 0x55 };
+	std::uint8_t dt[8];
+	std::uint8_t dl = mixed_ch::pci::encode_sf(ai, span<const std::uint8_t>(sf, 2), dt);
+	canbus_frame_t frames[] = {
+		tst_seg_frame(ai, 20, 0),
+		tst_seg_frame(ai, 20, 1),
+		tst_seg_frame(ai, 20, 3),
+		tst_frame<mixed_ch>(mixed_ch::addr::pack_id(ai), span<const std::uint8_t>(dt, dl)),
+	};
+	tst_trace expected;
+
+	expected.indn = 2;
+	expected.indn_rslt[0] = N_INV_SEQ_NUM;
+	expected.indn_sz[0] = mixed_ch::pci::ff_payload + mixed_ch::pci::cf_payload;
+	expected.indn_rslt[1] = N_OK;
+	expected.indn_sz[1] = 2;
+	expected.errs = 1;
+	expected.err_rslt[0] = N_INV_SEQ_NUM;
+	tst_parity(frames, sizeof(frames) / sizeof(frames[0]), expected);
+}
+
+/* A CF with another N_AE does not belong to the reception: it is ignored */
+static void tst_parity_ae()
+{
+	n_ai_t ai{ 6, 0x01, 0x02, 0x33, N_TA_T_PHY };
+	n_ai_t other = ai;
+	other.n_ae = 0x44;
+	canbus_frame_t frames[] = {
+		tst_seg_frame(ai, 20, 0),
+		tst_seg_frame(other, 20, 1),
+		tst_seg_frame(ai, 20, 1),
+		tst_seg_frame(other, 20, 2),
+		tst_seg_frame(ai, 20, 2),
+		tst_seg_frame(ai, 20, 3),
+	};
+	tst_trace expected;
+
+	expected.indn = 1;
+	expected.indn_rslt[0] = N_OK;
+	expected.indn_sz[0] = 20;
+	tst_parity(frames, sizeof(frames) / sizeof(frames[0]), expected);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main()
+{
+	tst_many_sf_per_process();
+	tst_loopback<classic_ch>(0, 0);
+	tst_loopback<classic_ch>(4, 2);
+	tst_loopback<fd_ch>(2, 0);
+	tst_fc_overflow();
+	tst_bs_timeout();
+	tst_budget();
+	tst_parity_sn();
+	tst_parity_ae();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
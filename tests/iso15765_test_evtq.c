@@ -0,0 +1,204 @@
+/*!
+@file   iso15765_test_evtq.c
+@brief  Regression tests of the event queue mode of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_evtq
+
+Returns 0 when all the checks pass. Several Single Frames are delivered to
+the engine before a single 'iso15765_process' call: every N_INDN event must
+reference its own message and not the payload of the last reception.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_RX_POOL	4	/* Reception buffers */
+#define TST_EVTQ_ELMS	16	/* Event records */
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "lib_iso15765.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_t ih;
+static n_evtq_t evtq;
+static n_evt_t evt_buf[TST_EVTQ_ELMS];
+static n_rxbuf_t rx_pool[TST_RX_POOL];
+static uint32_t now;
+static int fails;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint8_t tst_send(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	ISO_15675_UNUSED(id_type);
+	ISO_15675_UNUSED(id);
+	ISO_15675_UNUSED(fr_fmt);
+	ISO_15675_UNUSED(dlc);
+	ISO_15675_UNUSED(dt);
+	return 0;
+}
+
+static uint32_t tst_get_ms(void)
+{
+	return now;
+}
+
+static void tst_setup(n_rxbuf_t* pool, uint8_t pool_elms)
+{
+	memset(&ih, 0, sizeof(ih));
+	ih.addr_md = N_ADM_FIXED;
+	ih.fr_id_type = CBUS_ID_T_EXTENDED;
+	ih.clbs.send_frame = tst_send;
+	ih.clbs.get_ms = tst_get_ms;
+	ih.config.n_bs = 100;
+	ih.config.n_cr = 100;
+	iso15765_evtq_init(&evtq, evt_buf, TST_EVTQ_ELMS);
+	ih.evtq = &evtq;
+	ih.rx_pool = pool;
+	ih.rx_pool_elms = pool_elms;
+}
+
+/* Single Frame from the peer 'sa' whose payload is 'sz' bytes of 'fill' */
+static void tst_enqueue_sf(uint8_t sa, uint8_t fill, uint8_t sz)
+{
+	canbus_frame_t fr;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.id = (0x06UL << 26) | (0xDAUL << 16) | (0x01UL << 8) | sa;
+	fr.id_type = CBUS_ID_T_EXTENDED;
+	fr.fr_format = CBUS_FR_FRM_STD;
+	fr.dlc = 8;
+	fr.dt[0] = sz;
+	memset(&fr.dt[1], fill, sz);
+	TST_CHECK(iso15765_enqueue(&ih, &fr) == N_OK);
+}
+
+/* The event queue references the received messages: a pool is required */
+static void tst_pool_required(void)
+{
+	tst_setup(NULL, 0);
+	TST_CHECK(iso15765_init(&ih) == N_WRG_VALUE);
+}
+
+/* Several receptions in one process call keep their own payloads */
+static void tst_many_sf_per_process(void)
+{
+	n_evt_t evt;
+	uint8_t cnt = 0;
+
+	tst_setup(rx_pool, TST_RX_POOL);
+	TST_CHECK(iso15765_init(&ih) == N_OK);
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		tst_enqueue_sf((uint8_t)(0x10 + i), (uint8_t)(0xA0 + i), (uint8_t)(3 + i));
+	}
+	now++;
+	iso15765_process(&ih);
+
+	while (iso15765_evtq_pop(&evtq, &evt) == N_OK)
+	{
+		TST_CHECK(evt.tp == N_INDN);
+		TST_CHECK(evt.rslt == N_OK);
+		TST_CHECK(evt.n_ai.n_sa == 0x10 + cnt);
+		TST_CHECK(evt.msg_sz == 3 + cnt);
+		for (uint16_t k = 0; evt.msg != NULL && k < evt.msg_sz; k++)
+		{
+			TST_CHECK(evt.msg[k] == 0xA0 + cnt);
+		}
+		cnt++;
+	}
+	TST_CHECK(cnt == 3);
+
+	/* the messages stay valid until they are released */
+	TST_CHECK(iso15765_rx_release(&ih, rx_pool[0].msg) == N_OK);
+	TST_CHECK(iso15765_rx_release(&ih, rx_pool[0].msg) == N_WRG_VALUE);
+}
+
+/* A reception without a free buffer is refused, the lent ones are kept */
+static void tst_pool_exhausted(void)
+{
+	n_evt_t evt;
+	uint8_t indn = 0;
+	uint8_t errs = 0;
+
+	tst_setup(rx_pool, 2);
+	TST_CHECK(iso15765_init(&ih) == N_OK);
+
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		tst_enqueue_sf((uint8_t)(0x10 + i), (uint8_t)(0xA0 + i), 4);
+	}
+	now++;
+	iso15765_process(&ih);
+
+	while (iso15765_evtq_pop(&evtq, &evt) == N_OK)
+	{
+		if (evt.tp == N_INDN)
+		{
+			TST_CHECK(evt.msg != NULL && evt.msg[0] == 0xA0 + indn);
+			indn++;
+		}
+		else if (evt.tp == N_ERR_INDN)
+		{
+			errs++;
+		}
+	}
+	TST_CHECK(indn == 2);
+	TST_CHECK(errs == 1);
+	TST_CHECK(ih.rx_starved == 1);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(void)
+{
+	tst_pool_required();
+	tst_many_sf_per_process();
+	tst_pool_exhausted();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
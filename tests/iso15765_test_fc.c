@@ -0,0 +1,196 @@
+/*!
+@file   iso15765_test_fc.c
+@brief  Regression tests of the deferred FlowControl of the ISO15765-2 library
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_fc
+
+Returns 0 when all the checks pass. A FlowControl which is not sent right
+away (bus-load limiter, driver TX buffer full) must be sent later exactly as
+it was built, even if other frames were received in the meantime.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_SA		0x01	/* Address of the handler */
+#define TST_PEER	0x10	/* Sender of the refused FF */
+#define TST_OTHER	0x30	/* Sender of the frames received while the FC is pending */
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "lib_iso15765.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_t ih;
+static n_rxbuf_t rx_pool[1];
+static n_rate_t rate;
+static uint32_t now;
+static uint8_t busy;
+static uint32_t sent;
+static uint32_t sent_id;
+static uint8_t sent_dt[8];
+static int fails;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint8_t tst_send(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	ISO_15675_UNUSED(id_type);
+	ISO_15675_UNUSED(fr_fmt);
+	if (busy != 0)
+	{
+		return N_SEND_BUSY;
+	}
+	sent++;
+	sent_id = id;
+	memset(sent_dt, 0, sizeof(sent_dt));
+	memcpy(sent_dt, dt, dlc < sizeof(sent_dt) ? dlc : sizeof(sent_dt));
+	return N_SEND_OK;
+}
+
+static uint32_t tst_get_ms(void)
+{
+	return now;
+}
+
+/* Every reception is refused: the only buffer of the pool is lent */
+static void tst_setup(n_rate_t* rl)
+{
+	memset(&ih, 0, sizeof(ih));
+	memset(rx_pool, 0, sizeof(rx_pool));
+	ih.addr_md = N_ADM_FIXED;
+	ih.fr_id_type = CBUS_ID_T_EXTENDED;
+	ih.clbs.send_frame = tst_send;
+	ih.clbs.get_ms = tst_get_ms;
+	ih.config.bs = 4;
+	ih.config.stmin = 5;
+	ih.config.n_bs = 100;
+	ih.config.n_cr = 100;
+	ih.rx_pool = rx_pool;
+	ih.rx_pool_elms = 1;
+	ih.rate = rl;
+	TST_CHECK(iso15765_init(&ih) == N_OK);
+	rx_pool[0].lent = 1;
+	sent = 0;
+	busy = 0;
+}
+
+static void tst_enqueue(uint8_t sa, uint8_t pci0, uint8_t pci1)
+{
+	canbus_frame_t fr;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.id = (0x06UL << 26) | (0xDAUL << 16) | ((uint32_t)TST_SA << 8) | sa;
+	fr.id_type = CBUS_ID_T_EXTENDED;
+	fr.fr_format = CBUS_FR_FRM_STD;
+	fr.dlc = 8;
+	fr.dt[0] = pci0;
+	fr.dt[1] = pci1;
+	TST_CHECK(iso15765_enqueue(&ih, &fr) == N_OK);
+}
+
+/* The FC sent is the OVERFLOW answer to the FF of TST_PEER */
+static void tst_check_overflow_fc(void)
+{
+	TST_CHECK(sent == 1);
+	TST_CHECK(sent_id == ((0x06UL << 26) | (0xDAUL << 16) | ((uint32_t)TST_PEER << 8) | TST_SA));
+	TST_CHECK(sent_dt[0] == 0x30 + N_OVERFLOW);
+	TST_CHECK(sent_dt[1] == 0 && sent_dt[2] == 0);
+	TST_CHECK(ih.in.fc_pend == N_FC_NONE);
+}
+
+/* The driver does not take the OVERFLOW FC, a SF of another peer follows */
+static void tst_driver_busy(void)
+{
+	tst_setup(NULL);
+
+	busy = 1;
+	tst_enqueue(TST_PEER, 0x10, 0x80);
+	now++;
+	iso15765_process(&ih);
+	TST_CHECK(ih.in.fc_pend == N_FC_DEFERRED);
+
+	tst_enqueue(TST_OTHER, 0x03, 0xAA);
+	now++;
+	iso15765_process(&ih);
+	TST_CHECK(sent == 0);
+
+	busy = 0;
+	now++;
+	iso15765_process(&ih);
+	tst_check_overflow_fc();
+}
+
+/* The bus-load limiter defers the OVERFLOW FC, a SF of another peer follows */
+static void tst_rate_deferred(void)
+{
+	TST_CHECK(iso15765_rate_init(&rate, N_RATE_FRAMES, 10, 1) == N_OK);
+	tst_setup(&rate);
+	rate.tokens = 0;
+
+	tst_enqueue(TST_PEER, 0x10, 0x80);
+	now++;
+	iso15765_process(&ih);
+	TST_CHECK(ih.in.fc_pend == N_FC_DEFERRED);
+
+	tst_enqueue(TST_OTHER, 0x03, 0xAA);
+	now++;
+	iso15765_process(&ih);
+	TST_CHECK(sent == 0);
+
+	now += 100;
+	iso15765_process(&ih);
+	tst_check_overflow_fc();
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(void)
+{
+	tst_driver_busy();
+	tst_rate_deferred();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
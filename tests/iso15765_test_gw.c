@@ -0,0 +1,228 @@
+/*!
+@file   iso15765_test_gw.c
+@brief  Regression tests of the ISO15765-2 gateway
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_gw
+
+Returns 0 when all the checks pass. Back to back Single Frames received by
+one side are all forwarded with their own payloads, the ones that find the
+outbound stream busy wait for it instead of being dropped. A message whose
+outbound stream times out waiting for the FlowControl is dropped once.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_RX_POOL	4	/* Reception buffers per side */
+#define TST_EVTQ_ELMS	16	/* Event records per side */
+#define TST_MSGS	3	/* Single Frames received back to back */
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "lib_iso15765_gw.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_t side[2];
+static iso15765_t peer;
+static n_evtq_t evtq[2];
+static n_evt_t evt_buf[2][TST_EVTQ_ELMS];
+static n_rxbuf_t rx_pool[2][TST_RX_POOL];
+static iso15765_gw_t gw;
+static uint32_t now;
+static int fails;
+static uint8_t received;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint8_t tst_drop(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	ISO_15675_UNUSED(id_type);
+	ISO_15675_UNUSED(id);
+	ISO_15675_UNUSED(fr_fmt);
+	ISO_15675_UNUSED(dlc);
+	ISO_15675_UNUSED(dt);
+	return 0;
+}
+
+/* The outbound side of the gateway is wired to the peer */
+static uint8_t tst_to_peer(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	canbus_frame_t fr;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.id = id;
+	fr.id_type = id_type;
+	fr.fr_format = fr_fmt;
+	fr.dlc = dlc;
+	memcpy(fr.dt, dt, dlc);
+	return iso15765_enqueue(&peer, &fr) == N_OK ? 0 : 1;
+}
+
+static uint32_t tst_get_ms(void)
+{
+	return now;
+}
+
+/* Every message carries the source address in each byte of its payload */
+static void tst_peer_indn(n_indn_t* info)
+{
+	TST_CHECK(info->rslt == N_OK);
+	TST_CHECK(info->n_ai.n_sa == 0x10 + received);
+	TST_CHECK(info->msg_sz == 3);
+	for (uint16_t k = 0; k < info->msg_sz; k++)
+	{
+		TST_CHECK(info->msg[k] == info->n_ai.n_sa);
+	}
+	received++;
+}
+
+static void tst_setup(iso15765_t* ih, uint8_t (*send_frame)(cbus_id_type, uint32_t, cbus_fr_format, cbus_dl_t, uint8_t*))
+{
+	memset(ih, 0, sizeof(iso15765_t));
+	ih->addr_md = N_ADM_FIXED;
+	ih->fr_id_type = CBUS_ID_T_EXTENDED;
+	ih->clbs.send_frame = send_frame;
+	ih->clbs.get_ms = tst_get_ms;
+	ih->config.n_bs = 100;
+	ih->config.n_cr = 100;
+}
+
+/* The gateway between side 0 and side 1, whose frames go to 'send_frame' */
+static void tst_gw_setup(uint8_t (*send_frame)(cbus_id_type, uint32_t, cbus_fr_format, cbus_dl_t, uint8_t*))
+{
+	tst_setup(&side[0], tst_drop);
+	tst_setup(&side[1], send_frame);
+	for (uint8_t x = 0; x < 2U; x++)
+	{
+		iso15765_evtq_init(&evtq[x], evt_buf[x], TST_EVTQ_ELMS);
+		side[x].evtq = &evtq[x];
+		side[x].rx_pool = rx_pool[x];
+		side[x].rx_pool_elms = TST_RX_POOL;
+		TST_CHECK(iso15765_init(&side[x]) == N_OK);
+	}
+
+	memset(&gw, 0, sizeof(gw));
+	gw.side[0] = &side[0];
+	gw.side[1] = &side[1];
+	gw.fr_fmt[0] = CBUS_FR_FRM_STD;
+	gw.fr_fmt[1] = CBUS_FR_FRM_STD;
+	TST_CHECK(iso15765_gw_init(&gw) == N_OK);
+}
+
+/* A frame for side 0, from source address 'sa' */
+static void tst_rx_frame(uint8_t sa, const uint8_t* dt, uint8_t dlc)
+{
+	canbus_frame_t fr;
+
+	memset(&fr, 0, sizeof(fr));
+	fr.id = (0x06UL << 26) | (0xDAUL << 16) | (0x02UL << 8) | sa;
+	fr.id_type = CBUS_ID_T_EXTENDED;
+	fr.fr_format = CBUS_FR_FRM_STD;
+	fr.dlc = dlc;
+	memcpy(fr.dt, dt, dlc);
+	TST_CHECK(iso15765_enqueue(&side[0], &fr) == N_OK);
+}
+
+/* Back to back Single Frames are forwarded in order with their payloads */
+static void tst_back_to_back_sf(void)
+{
+	tst_gw_setup(tst_to_peer);
+	tst_setup(&peer, tst_drop);
+	peer.clbs.indn = tst_peer_indn;
+	TST_CHECK(iso15765_init(&peer) == N_OK);
+
+	for (uint8_t i = 0; i < TST_MSGS; i++)
+	{
+		uint8_t dt[8] = { 0 };
+		uint8_t sa = (uint8_t)(0x10 + i);
+
+		dt[0] = 3;
+		memset(&dt[1], sa, 3);
+		tst_rx_frame(sa, dt, 8);
+	}
+
+	for (uint8_t l = 0; l < 20U; l++)
+	{
+		now++;
+		iso15765_gw_process(&gw);
+		iso15765_process(&peer);
+	}
+
+	TST_CHECK(received == TST_MSGS);
+	TST_CHECK(gw.forwarded == TST_MSGS);
+	TST_CHECK(gw.dropped == 0);
+}
+
+/* The FF is forwarded at once but no FlowControl answers it: the N_Bs timeout
+ * of the outbound stream drops the message once */
+static void tst_bs_timeout(void)
+{
+	uint8_t dt[8] = { 0x10, 20, 1, 2, 3, 4, 5, 6 };
+
+	tst_gw_setup(tst_drop);
+	/* the reception must not time out before the outbound stream */
+	side[0].config.n_cr = 1000;
+	tst_rx_frame(0x10, dt, 8);
+
+	for (uint8_t l = 0; l < 200U; l++)
+	{
+		now++;
+		iso15765_gw_process(&gw);
+	}
+
+	TST_CHECK(side[1].out.sts == N_S_IDLE);
+	TST_CHECK(gw.forwarded == 0);
+	TST_CHECK(gw.dropped == 1);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(void)
+{
+	tst_back_to_back_sf();
+	tst_bs_timeout();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
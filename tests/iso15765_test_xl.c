@@ -0,0 +1,275 @@
+/*!
+@file   iso15765_test_xl.c
+@brief  Regression tests of the CAN XL frame format
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_test_xl
+
+Compiled with I15765_CANXL and I15765_MSG_SIZE=4095 (the engine is built in
+the test). Returns 0 when all the checks pass. Two handlers are connected
+back to back and exchange messages in CAN XL frames:
+
+  - Single Frames up to 255 bytes (one byte SF_DL), a FF above
+  - messages shorter than a full frame: the FF announces the message length
+    and a single unpadded CF follows
+  - messages over 2048 bytes, also with a block size of 1 and in CAN FD
+    frames (many CFs, the SN wraps)
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define TST_LOOPS	20000	/* Max. process calls per transfer */
+
+#define TST_CHECK(c)	do { if (!(c)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #c); fails++; } } while (0)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "lib_iso15765.h"
+
+#if !defined(I15765_CANXL) || I15765_MSG_SIZE < 4095
+#error "iso15765_test_xl requires I15765_CANXL and I15765_MSG_SIZE=4095"
+#endif
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_t tx;
+static iso15765_t rx;
+static n_req_t req;
+static uint32_t now;
+static int fails;
+
+/* result of the last transfer */
+static uint8_t indicated;
+static uint8_t confirmed;
+static n_rslt indn_rslt;
+
+/* frames of the sender: type and CAN DL of the first one, CFs */
+static uint8_t first_type;
+static cbus_dl_t first_dl;
+static uint16_t first_ff_dl;
+static uint32_t cf_cnt;
+static cbus_dl_t last_dl;
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint32_t tst_get_ms(void)
+{
+	return now;
+}
+
+static void tst_forward(iso15765_t* to, cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	static canbus_frame_t fr;
+
+	memset(&fr, 0, offsetof(canbus_frame_t, dt));
+	fr.id = id;
+	fr.id_type = id_type;
+	fr.fr_format = fr_fmt;
+	fr.dlc = dlc;
+	memcpy(fr.dt, dt, dlc);
+	TST_CHECK(iso15765_enqueue(to, &fr) == N_OK);
+}
+
+/* The frames of the sender are recorded (fixed addressing: the PCI is dt[0]) */
+static uint8_t tst_tx_frame(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	uint8_t type = (uint8_t)(dt[0] >> 4);
+
+	if (first_dl == 0)
+	{
+		first_type = type;
+		first_dl = dlc;
+		first_ff_dl = (uint16_t)(((dt[0] & 0x0FU) << 8) | dt[1]);
+	}
+	if (type == N_PCI_T_CF)
+	{
+		cf_cnt++;
+	}
+	last_dl = dlc;
+	tst_forward(&rx, id_type, id, fr_fmt, dlc, dt);
+	return N_SEND_OK;
+}
+
+static uint8_t tst_rx_frame(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	tst_forward(&tx, id_type, id, fr_fmt, dlc, dt);
+	return N_SEND_OK;
+}
+
+static void tst_indn(n_indn_t* info)
+{
+	indn_rslt = info->rslt;
+	if (info->rslt != N_OK)
+	{
+		return;
+	}
+	TST_CHECK(info->msg_sz == req.msg_sz);
+	TST_CHECK(memcmp(info->msg, req.msg, req.msg_sz) == 0);
+	indicated = 1;
+}
+
+static void tst_cfm(n_cfm_t* info)
+{
+	TST_CHECK(info->rslt == N_OK);
+	confirmed = 1;
+}
+
+static void tst_setup(iso15765_t* ih, uint8_t (*send_frame)(cbus_id_type, uint32_t, cbus_fr_format, cbus_dl_t, uint8_t*), uint8_t bs)
+{
+	memset(ih, 0, sizeof(iso15765_t));
+	ih->addr_md = N_ADM_FIXED;
+	ih->fr_id_type = CBUS_ID_T_EXTENDED;
+	ih->clbs.send_frame = send_frame;
+	ih->clbs.get_ms = tst_get_ms;
+	ih->clbs.indn = tst_indn;
+	ih->clbs.cfm = tst_cfm;
+	ih->config.bs = bs;
+	ih->config.n_bs = 100;
+	ih->config.n_cr = 100;
+	TST_CHECK(iso15765_init(ih) == N_OK);
+}
+
+/* Send a message of 'sz' bytes from 'tx' to 'rx', one frame per process call */
+static void tst_transfer(cbus_fr_format fr_fmt, uint16_t sz, uint8_t bs)
+{
+	tst_setup(&tx, tst_tx_frame, 0);
+	tst_setup(&rx, tst_rx_frame, bs);
+
+	memset(&req, 0, sizeof(req));
+	req.n_ai.n_pr = 0x06;
+	req.n_ai.n_sa = 0x01;
+	req.n_ai.n_ta = 0x02;
+	req.n_ai.n_tt = N_TA_T_PHY;
+	req.fr_fmt = fr_fmt;
+	req.msg_sz = sz;
+	for (uint16_t i = 0; i < sz; i++)
+	{
+		req.msg[i] = (uint8_t)(i * 7U + sz);
+	}
+
+	indicated = 0;
+	confirmed = 0;
+	indn_rslt = N_OK;
+	first_dl = 0;
+	cf_cnt = 0;
+
+	TST_CHECK(iso15765_send(&tx, &req) == N_OK);
+	for (uint32_t l = 0; l < TST_LOOPS && (indicated == 0 || confirmed == 0); l++)
+	{
+		iso15765_process(&tx);
+		iso15765_process(&rx);
+	}
+	TST_CHECK(indn_rslt == N_OK);
+	TST_CHECK(indicated == 1);
+	TST_CHECK(confirmed == 1);
+}
+
+/* A SF carries up to 255 bytes: SF_DL escape (0) and a one byte SF_DL */
+static void tst_single_frame(void)
+{
+	tst_transfer(CBUS_FR_FRM_XL, 1, 0);
+	TST_CHECK(first_type == N_PCI_T_SF && first_dl == 2 && cf_cnt == 0);
+
+	tst_transfer(CBUS_FR_FRM_XL, 8, 0);
+	TST_CHECK(first_type == N_PCI_T_SF && first_dl == 10 && cf_cnt == 0);
+
+	tst_transfer(CBUS_FR_FRM_XL, 255, 0);
+	TST_CHECK(first_type == N_PCI_T_SF && first_dl == 257 && cf_cnt == 0);
+
+	tst_transfer(CBUS_FR_FRM_XL, 256, 0);
+	TST_CHECK(first_type == N_PCI_T_FF);
+}
+
+/* Below a full frame the FF is as long as the message and announces its
+ * length, the rest of the message follows in one CF without padding */
+static void tst_first_frame(void)
+{
+	static const uint16_t sizes[] = { 256, 1000, 2047 };
+
+	for (uint8_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+	{
+		tst_transfer(CBUS_FR_FRM_XL, sizes[i], 0);
+		TST_CHECK(first_type == N_PCI_T_FF);
+		TST_CHECK(first_ff_dl == sizes[i]);
+		TST_CHECK(first_dl == sizes[i]);
+		TST_CHECK(cf_cnt == 1);
+		TST_CHECK(last_dl == 1U + 2U);
+	}
+
+	/* a full FF (2046 bytes of payload) and the 2 bytes left */
+	tst_transfer(CBUS_FR_FRM_XL, 2048, 0);
+	TST_CHECK(first_type == N_PCI_T_FF && first_ff_dl == 2048 && first_dl == 2048);
+	TST_CHECK(cf_cnt == 1 && last_dl == 1U + 2U);
+}
+
+/* Messages over 2048 bytes: full frames, also one CF per block, and in CAN FD
+ * frames the CFs of a 4095 bytes message wrap the SN many times */
+static void tst_large(void)
+{
+	tst_transfer(CBUS_FR_FRM_XL, 2049, 0);
+	TST_CHECK(first_dl == 2048 && cf_cnt == 1 && last_dl == 1U + 3U);
+
+	tst_transfer(CBUS_FR_FRM_XL, 4095, 0);
+	TST_CHECK(first_dl == 2048 && cf_cnt == 2);
+
+	tst_transfer(CBUS_FR_FRM_XL, 4095, 1);
+	TST_CHECK(first_dl == 2048 && cf_cnt == 2);
+
+	tst_transfer(CBUS_FR_FRM_FD, 4095, 0);
+	TST_CHECK(first_type == N_PCI_T_FF && first_ff_dl == 4095);
+	TST_CHECK(cf_cnt == (4095U - 62U + 63U - 1U) / 63U);
+
+	tst_transfer(CBUS_FR_FRM_FD, 4095, 3);
+	TST_CHECK(cf_cnt == (4095U - 62U + 63U - 1U) / 63U);
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(void)
+{
+	tst_single_frame();
+	tst_first_frame();
+	tst_large();
+
+	printf("%s\n", fails == 0 ? "OK" : "FAILED");
+	return fails == 0 ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,225 @@
+/*!
+@file   iso15765_client.c
+@brief  Client of the ISO15765-2 daemon over shared memory (POSIX)
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_client [-n shm_name] [-a addr] [-M] [-t target] [-e n_ae] [-p prio] [-f]
+	[-s size | hex bytes...] [-c count] [-r count] [-w timeout_ms]
+
+Attaches to the daemon as the node 'addr'. Sends 'count' messages to 'target'
+(the given bytes, or 'size' bytes of a counting pattern) and waits for their
+confirmations, and/or receives 'count' messages addressed to 'addr' (every
+message with -M) and prints them. The exit code is 0 if every transfer
+succeeded within the timeout.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define C_POLL_US	200	/* Polling period of the rings */
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "iso15765_shm.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_shm_t shm;
+static uint8_t msg[I15765_MSG_SIZE];
+static uint16_t msg_sz;
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint32_t c_get_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+}
+
+/*
+ * Print and release the received messages. Returns the number of messages.
+ */
+static uint32_t c_receive(void)
+{
+	const n_shm_rx_t* r;
+	uint32_t cnt = 0;
+
+	while ((r = iso15765_shm_rx_peek(&shm)) != NULL)
+	{
+		printf("rx %02X->%02X ae=%02X rslt=%u sz=%u:", r->n_ai.n_sa, r->n_ai.n_ta,
+			r->n_ai.n_ae, r->rslt, r->msg_sz);
+		for (uint16_t i = 0; i < r->msg_sz && i < 32U; i++)
+		{
+			printf(" %02X", r->msg[i]);
+		}
+		printf(r->msg_sz > 32U ? " ...\n" : "\n");
+		iso15765_shm_rx_release(&shm);
+		cnt++;
+	}
+	return cnt;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(int argc, char** argv)
+{
+	const char* name = "/iso15765";
+	uint32_t addr = 0xF1;
+	uint32_t target = 0;
+	uint32_t n_ae = 0;
+	uint32_t prio = I15765_PRIO_DEFAULT;
+	uint32_t size = 0;
+	uint32_t count = 1;
+	uint32_t rx_count = 0;
+	uint32_t timeout = 2000;
+	uint8_t any = 0;
+	uint8_t fd = 0;
+	int send = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:a:Mt:e:p:fs:c:r:w:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': name = optarg; break;
+		case 'a': addr = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'M': any = 1; break;
+		case 't': target = (uint32_t)strtoul(optarg, NULL, 0); send = 1; break;
+		case 'e': n_ae = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'p': prio = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'f': fd = 1; break;
+		case 's': size = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'c': count = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'r': rx_count = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'w': timeout = (uint32_t)strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n shm_name] [-a addr] [-M] [-t target] [-e n_ae] [-p prio] [-f]"
+				" [-s size | hex bytes...] [-c count] [-r count] [-w timeout_ms]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (size > I15765_MSG_SIZE || argc - optind > I15765_MSG_SIZE)
+	{
+		fprintf(stderr, "max. message size: %u\n", I15765_MSG_SIZE);
+		return 2;
+	}
+	for (uint32_t i = 0; i < size; i++)
+	{
+		msg[msg_sz++] = (uint8_t)i;
+	}
+	for (int i = optind; size == 0 && i < argc; i++)
+	{
+		msg[msg_sz++] = (uint8_t)strtoul(argv[i], NULL, 16);
+	}
+	if (send != 0 && msg_sz == 0)
+	{
+		fprintf(stderr, "nothing to send\n");
+		return 2;
+	}
+
+	n_rslt rslt = iso15765_shm_attach(&shm, name, (uint8_t)addr, any);
+	if (rslt != N_OK)
+	{
+		fprintf(stderr, "%s: %s\n", name, rslt == N_OVFLW ? "no free client slot"
+			: rslt == N_INV ? "incompatible daemon" : "daemon not running");
+		return 1;
+	}
+
+	uint32_t t0 = c_get_ms();
+	uint32_t sent = 0;
+	uint32_t done = 0;
+	uint32_t ok = 0;
+	uint32_t received = 0;
+	const n_req_t* inflight[I15765_SHM_TX_ELMS];
+
+	while ((send != 0 && done < count) || received < rx_count)
+	{
+		/* fill the TX ring: the payload is written in place */
+		n_req_t* req;
+		while (send != 0 && sent < count && sent - done < I15765_SHM_TX_ELMS
+			&& (req = iso15765_shm_tx_reserve(&shm)) != NULL)
+		{
+			req->n_ai.n_pr = 0x06;
+			req->n_ai.n_sa = (uint8_t)addr;
+			req->n_ai.n_ta = (uint8_t)target;
+			req->n_ai.n_ae = (uint8_t)n_ae;
+			req->n_ai.n_tt = N_TA_T_PHY;
+			req->fr_fmt = fd != 0 ? CBUS_FR_FRM_FD : CBUS_FR_FRM_STD;
+			req->msg_sz = msg_sz;
+			memmove(req->msg, msg, msg_sz);
+			iso15765_shm_tx_commit(&shm, (uint8_t)prio);
+			inflight[sent % I15765_SHM_TX_ELMS] = req;
+			sent++;
+		}
+		/* the confirmations, in the order of the requests */
+		while (done < sent)
+		{
+			n_rslt st = iso15765_shm_tx_poll(&shm, inflight[done % I15765_SHM_TX_ELMS]);
+			if (st == N_TX_BUSY)
+			{
+				break;
+			}
+			printf("conf %02X->%02X sz=%u rslt=%d\n", (uint8_t)addr, (uint8_t)target, msg_sz, (int)st);
+			ok += st == N_OK ? 1U : 0U;
+			done++;
+		}
+		received += c_receive();
+
+		if ((uint32_t)(c_get_ms() - t0) > timeout)
+		{
+			fprintf(stderr, "timeout: confirmed %u/%u, received %u/%u\n", done, count, received, rx_count);
+			break;
+		}
+		usleep(C_POLL_US);
+	}
+
+	fflush(stdout);
+	iso15765_shm_detach(&shm);
+	return (send == 0 || ok == count) && received >= rx_count ? 0 : 1;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,328 @@
+/*!
+@file   iso15765_daemon.c
+@brief  ISO15765-2 daemon serving client processes over shared memory (POSIX)
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_daemon [-n shm_name] [-i can_if] [-m mode] [-B bs] [-S stmin] [-P poll_us]
+
+The daemon owns the handler of a CAN channel and serves the client processes
+attached to its shared memory segment (see iso15765_shm.h and the client tool
+iso15765_client). With '-i' the channel is a SocketCAN interface (Linux, e.g.
+vcan0), otherwise the frames are looped back to the handler: every message
+sent by a client is received again and delivered to the clients of its
+target address, which allows testing without any CAN hardware.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define D_EVTQ_ELMS	64	/* Events of the handler */
+#define D_RX_POOL	8	/* Reception buffers lent until the delivery */
+#define D_SUBQ_ELMS	32	/* Submitted requests (power of two) */
+#define D_TXQ_ELMS	(I15765_SHM_CLIENTS * I15765_SHM_TX_ELMS)
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef __linux__
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#endif
+#include "iso15765_shm.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+static iso15765_t ih;
+static n_evtq_t evtq;
+static n_evt_t evt_buf[D_EVTQ_ELMS];
+static n_rxbuf_t rx_pool[D_RX_POOL];
+static n_subq_t subq;
+static n_subq_elm_t subq_buf[D_SUBQ_ELMS];
+static n_txq_t txq;
+static n_txq_elm_t txq_buf[D_TXQ_ELMS];
+static iso15765_shm_t shm;
+
+static int can_fd = -1;
+static volatile sig_atomic_t stop;
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static void on_signal(int sig)
+{
+	ISO_15675_UNUSED(sig);
+	stop = 1;
+}
+
+static uint32_t d_get_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+}
+
+/*
+ * Loopback channel: the frame is received by the handler itself. A full
+ * reception queue is back-pressure for the outbound stream.
+ */
+static uint8_t lo_send_frame(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	canbus_frame_t f;
+
+	memset(&f, 0, sizeof(f));
+	f.id = id;
+	f.id_type = id_type;
+	f.fr_format = fr_fmt;
+	f.dlc = dlc;
+	memmove(f.dt, dt, dlc);
+	return iso15765_enqueue(&ih, &f) == N_OK ? N_SEND_OK : N_SEND_BUSY;
+}
+
+#ifdef __linux__
+static uint8_t can_send_frame(cbus_id_type id_type, uint32_t id, cbus_fr_format fr_fmt, cbus_dl_t dlc, uint8_t* dt)
+{
+	struct canfd_frame f;
+	size_t mtu = fr_fmt == CBUS_FR_FRM_FD ? CANFD_MTU : CAN_MTU;
+
+	memset(&f, 0, sizeof(f));
+	f.can_id = id_type == CBUS_ID_T_EXTENDED ? (id & CAN_EFF_MASK) | CAN_EFF_FLAG : id & CAN_SFF_MASK;
+	f.len = dlc;
+	f.flags = fr_fmt == CBUS_FR_FRM_FD ? CANFD_BRS : 0;
+	memmove(f.data, dt, dlc);
+	if (write(can_fd, &f, mtu) == (ssize_t)mtu)
+	{
+		return N_SEND_OK;
+	}
+	return errno == EAGAIN || errno == ENOBUFS ? N_SEND_BUSY : N_SEND_ERR;
+}
+
+static int can_open(const char* ifname)
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	int on = 1;
+
+	can_fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+	if (can_fd < 0)
+	{
+		return -1;
+	}
+	memset(&ifr, 0, sizeof(ifr));
+	snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", ifname);
+	if (ioctl(can_fd, SIOCGIFINDEX, &ifr) != 0)
+	{
+		return -1;
+	}
+	/* CAN FD frames are received as well (if the interface supports them) */
+	setsockopt(can_fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &on, sizeof(on));
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	return bind(can_fd, (struct sockaddr*)&addr, sizeof(addr));
+}
+
+/*
+ * Move the frames received by the interface to the reception queue
+ */
+static void can_receive(void)
+{
+	struct canfd_frame f;
+	canbus_frame_t fr;
+	ssize_t n;
+
+	while ((n = read(can_fd, &f, sizeof(f))) == CAN_MTU || n == CANFD_MTU)
+	{
+		if ((f.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) != 0 || f.len == 0)
+		{
+			continue;
+		}
+		memset(&fr, 0, sizeof(fr));
+		fr.id_type = (f.can_id & CAN_EFF_FLAG) != 0 ? CBUS_ID_T_EXTENDED : CBUS_ID_T_STANDARD;
+		fr.id = f.can_id & ((f.can_id & CAN_EFF_FLAG) != 0 ? CAN_EFF_MASK : CAN_SFF_MASK);
+		fr.fr_format = n == CANFD_MTU ? CBUS_FR_FRM_FD : CBUS_FR_FRM_STD;
+		fr.dlc = f.len;
+		memmove(fr.dt, f.data, f.len);
+		iso15765_enqueue(&ih, &fr);
+	}
+}
+#endif
+
+static int parse_mode(const char* s, addr_md* mode)
+{
+	static const struct { const char* name; addr_md md; } modes[] = {
+		{ "normal", N_ADM_NORMAL }, { "fixed", N_ADM_FIXED }, { "mixed11", N_ADM_MIXED11 },
+		{ "extended", N_ADM_EXTENDED }, { "mixed29", N_ADM_MIXED29 } };
+
+	for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+	{
+		if (strcmp(s, modes[i].name) == 0)
+		{
+			*mode = modes[i].md;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(int argc, char** argv)
+{
+	const char* name = "/iso15765";
+	const char* ifname = NULL;
+	addr_md mode = N_ADM_FIXED;
+	uint32_t bs = 8;
+	uint32_t stmin = 0;
+	uint32_t poll_us = 200;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:i:m:B:S:P:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'n': name = optarg; break;
+		case 'i': ifname = optarg; break;
+		case 'm':
+			if (parse_mode(optarg, &mode) != 0)
+			{
+				fprintf(stderr, "unknown mode: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'B': bs = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'S': stmin = (uint32_t)strtoul(optarg, NULL, 0); break;
+		case 'P': poll_us = (uint32_t)strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr, "usage: %s [-n shm_name] [-i can_if] [-m normal|fixed|mixed11|extended|mixed29]"
+				" [-B bs] [-S stmin] [-P poll_us]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	ih.addr_md = mode;
+	ih.fr_id_type = (mode & CBUS_ID_T_EXTENDED) != 0 ? CBUS_ID_T_EXTENDED : CBUS_ID_T_STANDARD;
+	ih.config.bs = (uint8_t)bs;
+	ih.config.stmin = (uint8_t)stmin;
+	ih.config.wf = 5;
+	ih.config.n_bs = 1000;
+	ih.config.n_cr = 1000;
+	ih.clbs.get_ms = d_get_ms;
+	ih.clbs.send_frame = lo_send_frame;
+	/* the loopback refuses the frames while the reception queue is full */
+	ih.inq_policy = N_INQ_REJECT;
+	if (ifname != NULL)
+	{
+#ifdef __linux__
+		if (can_open(ifname) != 0)
+		{
+			perror(ifname);
+			return 1;
+		}
+		ih.clbs.send_frame = can_send_frame;
+		ih.inq_policy = N_INQ_DROP_NEWEST;
+#else
+		fprintf(stderr, "SocketCAN is not available\n");
+		return 1;
+#endif
+	}
+
+	iso15765_evtq_init(&evtq, evt_buf, D_EVTQ_ELMS);
+	iso15765_subq_init(&subq, subq_buf, D_SUBQ_ELMS);
+	iso15765_txq_init(&txq, txq_buf, D_TXQ_ELMS);
+	ih.evtq = &evtq;
+	ih.subq = &subq;
+	ih.txq = &txq;
+	ih.rx_pool = rx_pool;
+	ih.rx_pool_elms = D_RX_POOL;
+	if (iso15765_init(&ih) != N_OK)
+	{
+		fprintf(stderr, "handler initialization failed\n");
+		return 1;
+	}
+
+	if (iso15765_shm_create(&shm, name, mode) != N_OK)
+	{
+		perror(name);
+		return 1;
+	}
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	fprintf(stderr, "serving %s on %s\n", name, ifname != NULL ? ifname : "loopback");
+
+	while (stop == 0)
+	{
+		n_evt_t evt;
+
+#ifdef __linux__
+		if (can_fd >= 0)
+		{
+			can_receive();
+		}
+#endif
+		iso15765_shm_serve(&shm, &ih);
+		iso15765_process(&ih);
+
+		/* the lent reception buffers are copied to the clients and returned */
+		while (iso15765_evtq_pop(&evtq, &evt) == N_OK)
+		{
+			iso15765_shm_deliver(&shm, &evt);
+			if (evt.tp == N_INDN && evt.msg != NULL)
+			{
+				iso15765_rx_release(&ih, evt.msg);
+			}
+		}
+		usleep(poll_us);
+	}
+
+	iso15765_shm_destroy(&shm, name);
+	fprintf(stderr, "events lost=%u, rx queue dropped=%u rejected=%u\n",
+		evtq.lost, ih.inq_dropped, ih.inq_rejected);
+	return 0;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,486 @@
+/*!
+@file   iso15765_decode.c
+@brief  Offline ISO15765-2 decoder of candump traces (POSIX threads)
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+Usage: iso15765_decode [-m mode] [-j workers] [-t n_cr_us] [-s slots] [-o out.bin] [trace.log]
+
+The trace ('candump -l' format) is read as a stream and the frames are sharded
+by their CAN Id and addressing byte over the workers, so the frames of each
+message are decoded in order by a single worker. The messages are written in
+a binary stream (little endian):
+
+	file:	"I15765M1"
+	record:	u64 ts_first, u64 ts_last (us), u8 n_sa, u8 n_ta, u8 n_ae, u8 n_tt,
+		u8 fr_fmt, u8 reserved, u16 rslt, u16 msg_sz, u8 msg[msg_sz]
+
+The records of different addressing tuples are not sorted by time.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define DEC_BATCH	1024		/* Frames per batch handed to a worker */
+#define DEC_QUEUE	4		/* Batches queued per worker (bounds the memory) */
+#define DEC_OUT_BUF	(256 * 1024)	/* Output buffer of a worker */
+#define DEC_MAX_WORKERS	64
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "lib_iso15765_dec.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+typedef struct
+{
+	uint64_t ts;
+	canbus_frame_t frame;
+}dec_rec_t;
+
+typedef struct
+{
+	uint32_t cnt;
+	uint64_t ts[DEC_BATCH];
+	canbus_frame_t frame[DEC_BATCH];
+}dec_batch_t;
+
+typedef struct
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	dec_batch_t* queue[DEC_QUEUE];	/* Full batches, consumed by the worker */
+	uint32_t head;
+	uint32_t tail;
+	dec_batch_t* free[DEC_QUEUE];	/* Empty batches (the batches are DEC_QUEUE in total) */
+	uint32_t free_cnt;
+	uint8_t eof;
+	dec_batch_t* fill;		/* Batch being filled by the reader */
+	iso15765_dec_t dec;
+	n_dec_strm_t* strm;
+	uint8_t* out;
+	size_t out_len;
+}dec_worker_t;
+
+static dec_worker_t workers[DEC_MAX_WORKERS];
+static uint32_t worker_cnt = 1;
+static pthread_mutex_t out_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE* out_file;
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static void out_flush(dec_worker_t* w)
+{
+	if (w->out_len == 0)
+	{
+		return;
+	}
+	pthread_mutex_lock(&out_lock);
+	fwrite(w->out, 1, w->out_len, out_file);
+	pthread_mutex_unlock(&out_lock);
+	w->out_len = 0;
+}
+
+static uint8_t* put_le(uint8_t* p, uint64_t v, uint8_t sz)
+{
+	for (uint8_t i = 0; i < sz; i++)
+	{
+		*p++ = (uint8_t)(v >> (8U * i));
+	}
+	return p;
+}
+
+/*
+ * Decoder callback: append the message to the output buffer of the worker
+ */
+static void on_msg(void* ctx, const n_dec_msg_t* m)
+{
+	dec_worker_t* w = (dec_worker_t*)ctx;
+
+	if (w->out_len + 26U + m->msg_sz > DEC_OUT_BUF)
+	{
+		out_flush(w);
+	}
+
+	uint8_t* p = &w->out[w->out_len];
+	p = put_le(p, m->ts_first, 8);
+	p = put_le(p, m->ts_last, 8);
+	*p++ = m->n_ai.n_sa;
+	*p++ = m->n_ai.n_ta;
+	*p++ = m->n_ai.n_ae;
+	*p++ = (uint8_t)m->n_ai.n_tt;
+	*p++ = m->fr_fmt;
+	*p++ = 0;
+	p = put_le(p, (uint16_t)m->rslt, 2);
+	p = put_le(p, m->msg_sz, 2);
+	memcpy(p, m->msg, m->msg_sz);
+	w->out_len += 26U + m->msg_sz;
+}
+
+static void* worker_main(void* arg)
+{
+	dec_worker_t* w = (dec_worker_t*)arg;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&w->lock);
+		while (w->head == w->tail && w->eof == 0)
+		{
+			pthread_cond_wait(&w->cond, &w->lock);
+		}
+		if (w->head == w->tail)
+		{
+			pthread_mutex_unlock(&w->lock);
+			break;
+		}
+		dec_batch_t* b = w->queue[w->tail % DEC_QUEUE];
+		pthread_mutex_unlock(&w->lock);
+
+		iso15765_dec_push_batch(&w->dec, b->ts, b->frame, b->cnt);
+
+		pthread_mutex_lock(&w->lock);
+		w->tail++;
+		w->free[w->free_cnt++] = b;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+
+	iso15765_dec_flush(&w->dec);
+	out_flush(w);
+	return NULL;
+}
+
+/*
+ * Hand over the batch being filled to its worker and get an empty one
+ */
+static void worker_submit(dec_worker_t* w)
+{
+	pthread_mutex_lock(&w->lock);
+	if (w->fill != NULL && w->fill->cnt != 0)
+	{
+		w->queue[w->head % DEC_QUEUE] = w->fill;
+		w->head++;
+		w->fill = NULL;
+		pthread_cond_broadcast(&w->cond);
+	}
+	while (w->fill == NULL)
+	{
+		if (w->free_cnt != 0)
+		{
+			w->fill = w->free[--w->free_cnt];
+			w->fill->cnt = 0;
+			break;
+		}
+		pthread_cond_wait(&w->cond, &w->lock);
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+static int hex_val(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/*
+ * Parse a 'candump -l' line: "(1436509052.249713) can0 18DA10F1#0210030000000000"
+ * (CAN FD: "123##1<data>"). Returns 0 on success.
+ */
+static int parse_line(const char* ln, dec_rec_t* r)
+{
+	const char* p = strchr(ln, '(');
+	uint64_t sec = 0;
+	uint64_t us = 0;
+	uint32_t digits = 0;
+
+	if (p == NULL)
+	{
+		return -1;
+	}
+	for (p++; *p >= '0' && *p <= '9'; p++)
+	{
+		sec = sec * 10U + (uint64_t)(*p - '0');
+	}
+	if (*p == '.')
+	{
+		for (p++; *p >= '0' && *p <= '9'; p++)
+		{
+			if (digits++ < 6)
+			{
+				us = us * 10U + (uint64_t)(*p - '0');
+			}
+		}
+	}
+	for (; digits < 6; digits++)
+	{
+		us *= 10U;
+	}
+	r->ts = sec * 1000000U + us;
+
+	/* skip the interface name */
+	p = strchr(p, ')');
+	if (p == NULL)
+	{
+		return -1;
+	}
+	while (*++p == ' ');
+	while (*p != ' ' && *p != '\0') p++;
+	while (*p == ' ') p++;
+
+	uint32_t id = 0;
+	uint32_t len = 0;
+	int v;
+	while ((v = hex_val(*p)) >= 0)
+	{
+		id = (id << 4) | (uint32_t)v;
+		len++;
+		p++;
+	}
+	if (*p != '#' || len == 0)
+	{
+		return -1;
+	}
+	p++;
+
+	r->frame.id = id;
+	r->frame.id_type = len > 3 ? CBUS_ID_T_EXTENDED : CBUS_ID_T_STANDARD;
+	r->frame.fr_format = CBUS_FR_FRM_STD;
+	if (*p == '#')
+	{
+		/* CAN FD: flags nibble */
+		r->frame.fr_format = CBUS_FR_FRM_FD;
+		p += 2;
+	}
+	else if (*p == 'R')
+	{
+		return -1;
+	}
+
+	uint16_t dlc = 0;
+	int hi;
+	int lo;
+	while ((hi = hex_val(p[0])) >= 0 && (lo = hex_val(p[1])) >= 0 && dlc < sizeof(r->frame.dt))
+	{
+		r->frame.dt[dlc++] = (uint8_t)((hi << 4) | lo);
+		p += 2;
+	}
+	r->frame.dlc = dlc;
+	return dlc == 0 ? -1 : 0;
+}
+
+/*
+ * Worker of a frame: the frames of a message share the CAN Id and (extended
+ * and mixed modes) the first data byte
+ */
+static uint32_t shard_of(addr_md mode, const canbus_frame_t* f)
+{
+	uint32_t h = f->id;
+
+	if ((mode & 0x01) != 0)
+	{
+		h ^= (uint32_t)f->dt[0] << 29 | (uint32_t)f->dt[0];
+	}
+	h *= 2654435761U;
+	return (h >> 16) % worker_cnt;
+}
+
+static int parse_mode(const char* s, addr_md* mode)
+{
+	static const struct { const char* name; addr_md md; } modes[] = {
+		{ "normal", N_ADM_NORMAL }, { "fixed", N_ADM_FIXED }, { "mixed11", N_ADM_MIXED11 },
+		{ "extended", N_ADM_EXTENDED }, { "mixed29", N_ADM_MIXED29 } };
+
+	for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++)
+	{
+		if (strcmp(s, modes[i].name) == 0)
+		{
+			*mode = modes[i].md;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+int main(int argc, char** argv)
+{
+	addr_md mode = N_ADM_FIXED;
+	uint64_t n_cr = 0;
+	uint32_t slots = 256;
+	const char* out_name = NULL;
+	FILE* in = stdin;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:j:t:s:o:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			if (parse_mode(optarg, &mode) != 0)
+			{
+				fprintf(stderr, "unknown mode: %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'j':
+			worker_cnt = (uint32_t)strtoul(optarg, NULL, 0);
+			worker_cnt = worker_cnt == 0 ? 1 : worker_cnt > DEC_MAX_WORKERS ? DEC_MAX_WORKERS : worker_cnt;
+			break;
+		case 't':
+			n_cr = strtoull(optarg, NULL, 0);
+			break;
+		case 's':
+			slots = (uint32_t)strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			out_name = optarg;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-m normal|fixed|mixed11|extended|mixed29] [-j workers] "
+				"[-t n_cr_us] [-s slots] [-o out.bin] [trace.log]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind < argc && (in = fopen(argv[optind], "r")) == NULL)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	out_file = out_name != NULL ? fopen(out_name, "wb") : stdout;
+	if (out_file == NULL)
+	{
+		perror(out_name);
+		return 1;
+	}
+	fwrite("I15765M1", 1, 8, out_file);
+
+	for (uint32_t i = 0; i < worker_cnt; i++)
+	{
+		dec_worker_t* w = &workers[i];
+
+		w->strm = (n_dec_strm_t*)malloc(slots * sizeof(n_dec_strm_t));
+		w->out = (uint8_t*)malloc(DEC_OUT_BUF);
+		if (w->strm == NULL || w->out == NULL || iso15765_dec_init(&w->dec, mode, w->strm, slots) != N_OK)
+		{
+			fprintf(stderr, "invalid number of slots (power of two) or out of memory\n");
+			return 1;
+		}
+		w->dec.n_cr = n_cr;
+		w->dec.ctx = w;
+		w->dec.on_msg = on_msg;
+		for (uint32_t b = 0; b < DEC_QUEUE; b++)
+		{
+			w->free[w->free_cnt++] = (dec_batch_t*)malloc(sizeof(dec_batch_t));
+		}
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, NULL);
+		worker_submit(w);
+		pthread_create(&w->thread, NULL, worker_main, w);
+	}
+
+	char ln[512];
+	uint64_t lines = 0;
+	uint64_t skipped = 0;
+	dec_rec_t rec;
+
+	while (fgets(ln, sizeof(ln), in) != NULL)
+	{
+		lines++;
+		if (parse_line(ln, &rec) != 0)
+		{
+			skipped++;
+			continue;
+		}
+		dec_worker_t* w = &workers[shard_of(mode, &rec.frame)];
+		w->fill->ts[w->fill->cnt] = rec.ts;
+		memcpy(&w->fill->frame[w->fill->cnt++], &rec.frame, sizeof(canbus_frame_t));
+		if (w->fill->cnt == DEC_BATCH)
+		{
+			worker_submit(w);
+		}
+	}
+
+	uint64_t frames = 0;
+	uint64_t msgs = 0;
+	uint64_t errors = 0;
+	uint64_t overflow = 0;
+
+	for (uint32_t i = 0; i < worker_cnt; i++)
+	{
+		dec_worker_t* w = &workers[i];
+
+		pthread_mutex_lock(&w->lock);
+		if (w->fill->cnt != 0)
+		{
+			w->queue[w->head % DEC_QUEUE] = w->fill;
+			w->head++;
+		}
+		w->eof = 1;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+	}
+	for (uint32_t i = 0; i < worker_cnt; i++)
+	{
+		dec_worker_t* w = &workers[i];
+
+		pthread_join(w->thread, NULL);
+		frames += w->dec.frames;
+		msgs += w->dec.msgs;
+		errors += w->dec.errors;
+		overflow += w->dec.overflow;
+	}
+
+	fflush(out_file);
+	fprintf(stderr, "lines=%llu skipped=%llu frames=%llu messages=%llu errors=%llu overflow=%llu\n",
+		(unsigned long long)lines, (unsigned long long)skipped, (unsigned long long)frames,
+		(unsigned long long)msgs, (unsigned long long)errors, (unsigned long long)overflow);
+	return 0;
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
@@ -0,0 +1,472 @@
+/*!
+@file   iso15765_shm.c
+@brief  Shared-memory transport between an ISO15765-2 daemon and its clients (POSIX)
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#define SHM_CHK_MS	1000	/* Period of the check of the clients */
+
+/******************************************************************************
+* Includes
+******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "iso15765_shm.h"
+
+/******************************************************************************
+* Enumerations, structures & Variables
+******************************************************************************/
+
+/******************************************************************************
+* Declaration | Static Functions
+******************************************************************************/
+
+/******************************************************************************
+* Definition  | Static Functions
+******************************************************************************/
+
+static uint32_t shm_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000U + (uint64_t)ts.tv_nsec / 1000000U);
+}
+
+static void shm_tok_done(n_token_t* tok, n_rslt rslt)
+{
+	tok->rslt = rslt;
+	I15765_ATOMIC_STORE(&tok->sts, (uint32_t)N_TOK_DONE);
+}
+
+/*
+ * Submit the requests committed by a client. A request which cannot be
+ * submitted (invalid) is completed at once with the reason.
+ */
+static void shm_serve_tx(n_shm_cli_t* c, iso15765_t* ih)
+{
+	uint32_t t = c->tx_tail;
+
+	while (t != I15765_ATOMIC_LOAD(&c->tx_head))
+	{
+		n_shm_tx_t* r = &c->tx[t % I15765_SHM_TX_ELMS];
+		n_rslt rslt = iso15765_submit(ih, &r->req, r->prio, &r->tok);
+
+		/* the submission queue is full: retried on the next serve (an
+		* oversized request is refused with N_BUFFER_OVFLW as well) */
+		if (rslt == N_BUFFER_OVFLW && r->req.msg_sz <= I15765_MSG_SIZE)
+		{
+			break;
+		}
+		if (rslt != N_OK)
+		{
+			shm_tok_done(&r->tok, rslt);
+		}
+		t++;
+		I15765_ATOMIC_STORE(&c->tx_tail, t);
+	}
+}
+
+/*
+ * A slot can be freed when all the requests of its client are completed
+ */
+static uint8_t shm_idle(n_shm_cli_t* c)
+{
+	if (c->tx_tail != I15765_ATOMIC_LOAD(&c->tx_head))
+	{
+		return 0;
+	}
+	for (uint32_t i = 0; i < I15765_SHM_TX_ELMS; i++)
+	{
+		if (I15765_ATOMIC_LOAD(&c->tx[i].tok.sts) == N_TOK_PENDING)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/******************************************************************************
+* Definition  | Public Functions
+******************************************************************************/
+
+/*
+ * Create the segment of the daemon. A segment left by a previous daemon with
+ * the same name is replaced.
+ */
+n_rslt iso15765_shm_create(iso15765_shm_t* shm, const char* name, addr_md mode)
+{
+	if (shm == NULL || name == NULL)
+	{
+		return N_NULL;
+	}
+
+	shm_unlink(name);
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0660);
+	if (fd < 0)
+	{
+		return N_ERROR;
+	}
+	if (ftruncate(fd, (off_t)sizeof(n_shm_seg_t)) != 0)
+	{
+		close(fd);
+		shm_unlink(name);
+		return N_ERROR;
+	}
+	void* p = mmap(NULL, sizeof(n_shm_seg_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		shm_unlink(name);
+		return N_ERROR;
+	}
+
+	/* a new object is zero filled: every slot is free */
+	shm->seg = (n_shm_seg_t*)p;
+	shm->cli = NULL;
+	shm->last_chk = shm_ms();
+	shm->seg->version = I15765_SHM_VERSION;
+	shm->seg->size = (uint32_t)sizeof(n_shm_seg_t);
+	shm->seg->pid = (int32_t)getpid();
+	shm->seg->addr_md = (uint8_t)mode;
+	/* the clients attach only after the header is complete */
+	I15765_ATOMIC_STORE(&shm->seg->magic, I15765_SHM_MAGIC);
+	return N_OK;
+}
+
+/*
+ * Daemon: submit the requests of the clients to the handler (which needs a
+ * 'subq'; a 'txq' orders the requests of the clients by priority) and free
+ * the slots of the detached or terminated clients. To be called with the
+ * 'iso15765_process' of the handler, from the same thread.
+ */
+n_rslt iso15765_shm_serve(iso15765_shm_t* shm, iso15765_t* ih)
+{
+	if (shm == NULL || shm->seg == NULL || ih == NULL)
+	{
+		return N_NULL;
+	}
+
+	uint32_t now = shm_ms();
+	uint8_t chk = (uint32_t)(now - shm->last_chk) >= SHM_CHK_MS ? 1 : 0;
+
+	if (chk != 0)
+	{
+		shm->last_chk = now;
+	}
+	shm->seg->alive++;
+
+	for (uint32_t i = 0; i < I15765_SHM_CLIENTS; i++)
+	{
+		n_shm_cli_t* c = &shm->seg->cli[i];
+		uint32_t sts = I15765_ATOMIC_LOAD(&c->sts);
+
+		if (sts == N_SHM_FREE)
+		{
+			continue;
+		}
+		/* a terminated client is detached */
+		if (chk != 0 && sts != N_SHM_CLOSING
+			&& kill((pid_t)c->pid, 0) != 0 && errno == ESRCH)
+		{
+			sts = N_SHM_CLOSING;
+			I15765_ATOMIC_STORE(&c->sts, sts);
+		}
+		/* the requests committed before the detach are still sent */
+		if (sts == N_SHM_ACTIVE || sts == N_SHM_CLOSING)
+		{
+			shm_serve_tx(c, ih);
+		}
+		if (sts == N_SHM_CLOSING && shm_idle(c) != 0)
+		{
+			I15765_ATOMIC_STORE(&c->sts, (uint32_t)N_SHM_FREE);
+		}
+	}
+	return N_OK;
+}
+
+/*
+ * Daemon: deliver an indication (N_INDN event of the handler) to the RX ring
+ * of every client which serves its target address. Other events are ignored.
+ */
+n_rslt iso15765_shm_deliver(iso15765_shm_t* shm, const n_evt_t* evt)
+{
+	if (shm == NULL || shm->seg == NULL || evt == NULL)
+	{
+		return N_NULL;
+	}
+
+	if (evt->tp != N_INDN)
+	{
+		return N_IDLE;
+	}
+
+	for (uint32_t i = 0; i < I15765_SHM_CLIENTS; i++)
+	{
+		n_shm_cli_t* c = &shm->seg->cli[i];
+
+		if (I15765_ATOMIC_LOAD(&c->sts) != N_SHM_ACTIVE || (c->any == 0 && c->n_ta != evt->n_ai.n_ta))
+		{
+			continue;
+		}
+
+		uint32_t h = c->rx_head;
+		if (h - I15765_ATOMIC_LOAD(&c->rx_tail) >= I15765_SHM_RX_ELMS)
+		{
+			c->rx_lost++;
+			continue;
+		}
+
+		n_shm_rx_t* r = &c->rx[h % I15765_SHM_RX_ELMS];
+		r->fr_fmt = evt->fr_fmt;
+		r->rslt = evt->rslt;
+		memmove(&r->n_ai, &evt->n_ai, sizeof(n_ai_t));
+		r->msg_sz = evt->msg != NULL ? evt->msg_sz : 0;
+		if (r->msg_sz != 0)
+		{
+			memmove(r->msg, evt->msg, r->msg_sz);
+		}
+		/* publish the record only after it is completely written */
+		I15765_ATOMIC_STORE(&c->rx_head, h + 1U);
+	}
+	return N_OK;
+}
+
+/*
+ * Daemon: unmap and remove the segment
+ */
+void iso15765_shm_destroy(iso15765_shm_t* shm, const char* name)
+{
+	if (shm == NULL || shm->seg == NULL)
+	{
+		return;
+	}
+	munmap(shm->seg, sizeof(n_shm_seg_t));
+	shm->seg = NULL;
+	if (name != NULL)
+	{
+		shm_unlink(name);
+	}
+}
+
+/*
+ * Client: map the segment of the daemon and take a free slot. The messages
+ * to 'n_ta' (or all of them, with 'any') are delivered to the client.
+ */
+n_rslt iso15765_shm_attach(iso15765_shm_t* shm, const char* name, uint8_t n_ta, uint8_t any)
+{
+	struct stat st;
+
+	if (shm == NULL || name == NULL)
+	{
+		return N_NULL;
+	}
+
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+	{
+		return N_ERROR;
+	}
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size != sizeof(n_shm_seg_t))
+	{
+		close(fd);
+		return N_INV;
+	}
+	void* p = mmap(NULL, sizeof(n_shm_seg_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+	{
+		return N_ERROR;
+	}
+
+	n_shm_seg_t* seg = (n_shm_seg_t*)p;
+	if (I15765_ATOMIC_LOAD(&seg->magic) != I15765_SHM_MAGIC
+		|| seg->version != I15765_SHM_VERSION || seg->size != sizeof(n_shm_seg_t))
+	{
+		munmap(p, sizeof(n_shm_seg_t));
+		return N_INV;
+	}
+
+	for (uint32_t i = 0; i < I15765_SHM_CLIENTS; i++)
+	{
+		n_shm_cli_t* c = &seg->cli[i];
+		uint32_t sts = N_SHM_FREE;
+
+		if (!I15765_ATOMIC_CAS(&c->sts, &sts, (uint32_t)N_SHM_CLAIMED))
+		{
+			continue;
+		}
+		c->pid = (int32_t)getpid();
+		c->n_ta = n_ta;
+		c->any = any;
+		c->tx_head = 0;
+		c->tx_tail = 0;
+		c->rx_head = 0;
+		c->rx_tail = 0;
+		c->rx_lost = 0;
+		for (uint32_t k = 0; k < I15765_SHM_TX_ELMS; k++)
+		{
+			c->tx[k].tok.sts = N_TOK_FREE;
+		}
+		I15765_ATOMIC_STORE(&c->sts, (uint32_t)N_SHM_ACTIVE);
+		shm->seg = seg;
+		shm->cli = c;
+		return N_OK;
+	}
+
+	munmap(p, sizeof(n_shm_seg_t));
+	return N_OVFLW;
+}
+
+/*
+ * Client: release the slot (freed by the daemon once the pending requests
+ * are completed) and unmap the segment
+ */
+void iso15765_shm_detach(iso15765_shm_t* shm)
+{
+	if (shm == NULL || shm->seg == NULL || shm->cli == NULL)
+	{
+		return;
+	}
+	I15765_ATOMIC_STORE(&shm->cli->sts, (uint32_t)N_SHM_CLOSING);
+	munmap(shm->seg, sizeof(n_shm_seg_t));
+	shm->seg = NULL;
+	shm->cli = NULL;
+}
+
+/*
+ * Client: the next request of the TX ring, to be filled in place. NULL if
+ * all the requests of the client are in flight.
+ */
+n_req_t* iso15765_shm_tx_reserve(iso15765_shm_t* shm)
+{
+	if (shm == NULL || shm->cli == NULL)
+	{
+		return NULL;
+	}
+
+	n_shm_cli_t* c = shm->cli;
+	uint32_t h = c->tx_head;
+	n_shm_tx_t* r = &c->tx[h % I15765_SHM_TX_ELMS];
+
+	if (h - I15765_ATOMIC_LOAD(&c->tx_tail) >= I15765_SHM_TX_ELMS
+		|| I15765_ATOMIC_LOAD(&r->tok.sts) == N_TOK_PENDING)
+	{
+		return NULL;
+	}
+	return &r->req;
+}
+
+/*
+ * Client: hand the reserved request over to the daemon
+ */
+n_rslt iso15765_shm_tx_commit(iso15765_shm_t* shm, uint8_t prio)
+{
+	if (shm == NULL || shm->cli == NULL)
+	{
+		return N_NULL;
+	}
+
+	n_shm_cli_t* c = shm->cli;
+	uint32_t h = c->tx_head;
+	n_shm_tx_t* r = &c->tx[h % I15765_SHM_TX_ELMS];
+
+	r->prio = prio;
+	r->tok.rslt = N_OK;
+	I15765_ATOMIC_STORE(&r->tok.sts, (uint32_t)N_TOK_PENDING);
+	I15765_ATOMIC_STORE(&c->tx_head, h + 1U);
+	return N_OK;
+}
+
+/*
+ * Client: completion of a committed request. N_TX_BUSY while it is pending,
+ * else the result of the transmission.
+ */
+n_rslt iso15765_shm_tx_poll(iso15765_shm_t* shm, const n_req_t* req)
+{
+	if (shm == NULL || shm->cli == NULL || req == NULL)
+	{
+		return N_NULL;
+	}
+
+	n_shm_tx_t* r = (n_shm_tx_t*)((uintptr_t)req - offsetof(n_shm_tx_t, req));
+	if (r < &shm->cli->tx[0] || r >= &shm->cli->tx[I15765_SHM_TX_ELMS])
+	{
+		return N_INV;
+	}
+	return iso15765_token_poll(&r->tok);
+}
+
+/*
+ * Client: the oldest received message, read in place. NULL if there is none.
+ */
+const n_shm_rx_t* iso15765_shm_rx_peek(iso15765_shm_t* shm)
+{
+	if (shm == NULL || shm->cli == NULL)
+	{
+		return NULL;
+	}
+
+	n_shm_cli_t* c = shm->cli;
+	uint32_t t = c->rx_tail;
+
+	if (t == I15765_ATOMIC_LOAD(&c->rx_head))
+	{
+		return NULL;
+	}
+	return &c->rx[t % I15765_SHM_RX_ELMS];
+}
+
+/*
+ * Client: give the message returned by 'iso15765_shm_rx_peek' back to the daemon
+ */
+void iso15765_shm_rx_release(iso15765_shm_t* shm)
+{
+	if (shm == NULL || shm->cli == NULL)
+	{
+		return;
+	}
+
+	n_shm_cli_t* c = shm->cli;
+	if (c->rx_tail != I15765_ATOMIC_LOAD(&c->rx_head))
+	{
+		I15765_ATOMIC_STORE(&c->rx_tail, c->rx_tail + 1U);
+	}
+}
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
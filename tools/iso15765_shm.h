@@ -0,0 +1,176 @@
+/*!
+@file   iso15765_shm.h
+@brief  Shared-memory transport between an ISO15765-2 daemon and its clients (POSIX)
+@t.odo	-
+---------------------------------------------------------------------------
+
+GNU Affero General Public License v3.0
+
+Copyright (c) 2024 Ioannis D. (devcoons)
+
+This program is free software: you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License as published by
+the Free Software Foundation, either version 3 of the License.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+GNU Affero General Public License for more details.
+
+You should have received a copy of the GNU Affero General Public License
+along with this program. If not, see <https://www.gnu.org/licenses/>.
+
+For commercial use, including proprietary or for-profit applications,
+a separate license is required. Contact:
+
+- GitHub: [https://github.com/devcoons](https://github.com/devcoons)
+- Email: i_-_-_s@outlook.com
+
+The daemon owns the handler and a shared memory segment with a slot per
+client. A slot holds two single-producer/single-consumer rings without any
+lock: the TX ring (client -> daemon) of requests, which the client writes in
+place and the daemon submits with 'iso15765_submit' (the completion token is
+in the slot as well), and the RX ring (daemon -> client) of the received
+messages, which the client reads in place. The records contain no pointers,
+so the segment can be mapped at any address. The segment layout depends on
+the build of the library (I15765_MSG_SIZE etc.): the daemon and the clients
+must be built with the same configuration, which is checked on attach.
+*/
+/******************************************************************************
+* Preprocessor Definitions & Macros
+******************************************************************************/
+
+#ifndef DEVCOONS_ISO15765_2_SHM_H_
+#define DEVCOONS_ISO15765_2_SHM_H_
+
+#define I15765_SHM_MAGIC	0x49535450U	/* "ISTP" */
+#define I15765_SHM_VERSION	1
+
+#ifndef I15765_SHM_CLIENTS
+#define I15765_SHM_CLIENTS	8	/* Max. attached clients */
+#endif
+
+#ifndef I15765_SHM_TX_ELMS
+#define I15765_SHM_TX_ELMS	4	/* Requests in flight per client */
+#endif
+
+#ifndef I15765_SHM_RX_ELMS
+#define I15765_SHM_RX_ELMS	8	/* Received messages queued per client */
+#endif
+
+/******************************************************************************
+ * Includes
+******************************************************************************/
+
+#include "lib_iso15765.h"
+
+/* the rings and the submission queue of the daemon need the atomic operations */
+#ifndef I15765_ATOMIC_CAS
+#error "The daemon and its client require the atomic operations (I15765_NO_ATOMICS)"
+#endif
+
+/******************************************************************************
+ * Enumerations, structures & Variables
+******************************************************************************/
+
+typedef enum
+{
+	N_SHM_FREE = 0x00,	/* Not in use */
+	N_SHM_CLAIMED = 0x01,	/* Being initialized by a client */
+	N_SHM_ACTIVE = 0x02,	/* Served by the daemon */
+	N_SHM_CLOSING = 0x03	/* Detached, freed by the daemon when no request is pending */
+}n_shm_sts;
+
+/* --- TX record (written in place by the client) -------------------------- */
+
+typedef struct ALIGNMENT
+{
+	n_req_t req;			/* Request: address information, format and payload */
+	n_token_t tok;			/* Completion of the request (N_USData.confirm) */
+	uint8_t prio;			/* Priority of the request (0: highest) */
+}n_shm_tx_t;
+
+/* --- RX record (read in place by the client) ----------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint8_t fr_fmt;			/* CANBus frame format `cbus_fr_format` */
+	uint16_t rslt;			/* Result of the reception `n_rslt` */
+	n_ai_t n_ai;			/* Address information */
+	uint16_t msg_sz;		/* Size of the message */
+	uint8_t msg[I15765_MSG_SIZE];	/* Message */
+}n_shm_rx_t;
+
+/* --- Slot of a client ---------------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	volatile uint32_t sts;		/* Status of the slot `n_shm_sts` */
+	int32_t pid;			/* Process of the client */
+	uint8_t n_ta;			/* Messages to this target address are delivered */
+	uint8_t any;			/* 1: every message is delivered (monitor) */
+	volatile uint32_t tx_head;	/* Written by the client */
+	volatile uint32_t tx_tail;	/* Written by the daemon (requests submitted) */
+	volatile uint32_t rx_head;	/* Written by the daemon */
+	volatile uint32_t rx_tail;	/* Written by the client */
+	volatile uint32_t rx_lost;	/* Messages dropped because the RX ring was full */
+	n_shm_tx_t tx[I15765_SHM_TX_ELMS];
+	n_shm_rx_t rx[I15765_SHM_RX_ELMS];
+}n_shm_cli_t;
+
+/* --- Shared memory segment ----------------------------------------------- */
+
+typedef struct ALIGNMENT
+{
+	uint32_t magic;			/* I15765_SHM_MAGIC */
+	uint32_t version;		/* I15765_SHM_VERSION */
+	uint32_t size;			/* Size of the segment (layout check) */
+	int32_t pid;			/* Process of the daemon */
+	uint8_t addr_md;		/* Addressing mode of the handler `addr_md` */
+	volatile uint32_t alive;	/* Incremented by the daemon on every serve */
+	n_shm_cli_t cli[I15765_SHM_CLIENTS];
+}n_shm_seg_t;
+
+/* --- Local handle (daemon or client) ------------------------------------- */
+
+typedef struct
+{
+	n_shm_seg_t* seg;		/* Mapping of the segment */
+	n_shm_cli_t* cli;		/* Slot of the client (NULL: daemon) */
+	uint32_t last_chk;		/* Daemon: time of the last check of the clients (ms) */
+}iso15765_shm_t;
+
+/******************************************************************************
+* Declaration | Public Functions
+******************************************************************************/
+
+/* --- Daemon -------------------------------------------------------------- */
+
+n_rslt iso15765_shm_create(iso15765_shm_t* shm, const char* name, addr_md mode);
+
+n_rslt iso15765_shm_serve(iso15765_shm_t* shm, iso15765_t* ih);
+
+n_rslt iso15765_shm_deliver(iso15765_shm_t* shm, const n_evt_t* evt);
+
+void iso15765_shm_destroy(iso15765_shm_t* shm, const char* name);
+
+/* --- Client -------------------------------------------------------------- */
+
+n_rslt iso15765_shm_attach(iso15765_shm_t* shm, const char* name, uint8_t n_ta, uint8_t any);
+
+void iso15765_shm_detach(iso15765_shm_t* shm);
+
+n_req_t* iso15765_shm_tx_reserve(iso15765_shm_t* shm);
+
+n_rslt iso15765_shm_tx_commit(iso15765_shm_t* shm, uint8_t prio);
+
+n_rslt iso15765_shm_tx_poll(iso15765_shm_t* shm, const n_req_t* req);
+
+const n_shm_rx_t* iso15765_shm_rx_peek(iso15765_shm_t* shm);
+
+void iso15765_shm_rx_release(iso15765_shm_t* shm);
+
+/******************************************************************************
+* EOF - NO CODE AFTER THIS LINE
+******************************************************************************/
+#endif